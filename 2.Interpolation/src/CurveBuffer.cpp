@@ -0,0 +1,43 @@
+#include "CurveBuffer.h"
+
+int CurveBuffer::Update(const std::vector<vec3> &curve)
+{
+	size_t count = curve.empty() ? 0 : curve.size() + 2;
+	auto at = [&curve](size_t i) { return curve[std::min(std::max(i, (size_t)1), curve.size()) - 1]; };
+
+	//Everything past the old end is new, the old end itself moves when the curve grows or shrinks
+	Range changed;
+	size_t common = std::min(count, vertices.size());
+	for (size_t i = 0; i < common; ++i)
+		if (at(i) != vertices[i])
+			changed.Add(i, i + 1);
+	if (count > common)
+		changed.Add(common, count);
+	vertices.resize(count);
+	for (size_t i = changed.first; i < changed.end; ++i)
+		vertices[i] = at(i);
+
+	if (count > capacity) {
+		capacity = std::max(count, capacity * 2);
+		for (int s = 0; s < SlotCount; ++s) {
+			backend.Allocate(s, capacity);
+			dirty[s] = Range();
+			dirty[s].Add(0, capacity);
+		}
+	}
+	else if (!changed.Empty()) {
+		for (int s = 0; s < SlotCount; ++s)
+			dirty[s].Add(changed.first, changed.end);
+	}
+
+	slot = (slot + 1) % SlotCount;
+	Range &pending = dirty[slot];
+	pending.end = std::min(pending.end, count);
+	verticesUploaded = 0;
+	if (!pending.Empty()) {
+		verticesUploaded = pending.end - pending.first;
+		backend.Upload(slot, pending.first, verticesUploaded, &vertices[pending.first]);
+	}
+	pending = Range();
+	return slot;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "cinder/Vector.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace ci;
+
+//Receives the vertex writes of a CurveBuffer. Every slot is a buffer of its own, so the one written in a frame is never
+//the one the GPU may still read from the frames before. Implemented by CurveLine for OpenGL, any other implementation
+//(e.g. one that only records the calls) can drive CurveBuffer without a GL context
+class CurveUploadBackend {
+public:
+	virtual ~CurveUploadBackend() {}
+	virtual void Allocate(int slot, size_t vertexCapacity) = 0;	//The slot's previous contents are lost
+	virtual void Upload(int slot, size_t first, size_t count, const vec3 *vertices) = 0;
+};
+
+//Keeps a tessellated curve in a ring of SlotCount vertex buffers that are allocated once and grow by doubling.
+//Update() compares the curve against the last one and writes only the changed range into the next slot, together with
+//the ranges that slot missed while the other slots were in use.
+//The buffer holds the curve with its first and last point repeated, the layout GL_LINE_STRIP_ADJACENCY expects
+class CurveBuffer {
+public:
+	static const int SlotCount = 3;
+
+	CurveBuffer(CurveUploadBackend &backend) : backend(backend) {}
+	//Returns the slot that holds curve now
+	int Update(const std::vector<vec3> &curve);
+	size_t VertexCount() const { return vertices.size(); }
+	size_t Capacity() const { return capacity; }
+
+	size_t verticesUploaded = 0;	//By the last Update
+
+private:
+	struct Range {
+		size_t first = SIZE_MAX;
+		size_t end = 0;
+		void Add(size_t from, size_t to) { first = std::min(first, from); end = std::max(end, to); }
+		bool Empty() const { return first >= end; }
+	};
+
+	CurveUploadBackend &backend;
+	std::vector<vec3> vertices;		//What the newest slot holds
+	Range dirty[SlotCount];			//Changes every slot has not received yet
+	size_t capacity = 0;
+	int slot = SlotCount - 1;
+};
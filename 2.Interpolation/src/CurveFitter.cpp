@@ -0,0 +1,194 @@
+#include "CurveFitter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+	//Segments that are within this many times the tolerance are reparameterized before splitting them
+	const float ReparameterizeFactor = 4.f;
+	const int NewtonIterations = 4;
+
+	struct Bezier {
+		vec3 p[4];
+
+		vec3 Evaluate(float t) const
+		{
+			float s = 1 - t;
+			return s * s * s * p[0] + 3 * s * s * t * p[1] + 3 * s * t * t * p[2] + t * t * t * p[3];
+		}
+		vec3 Derivative(float t) const
+		{
+			float s = 1 - t;
+			return 3 * s * s * (p[1] - p[0]) + 6 * s * t * (p[2] - p[1]) + 3 * t * t * (p[3] - p[2]);
+		}
+		vec3 SecondDerivative(float t) const
+		{
+			return 6 * (1 - t) * (p[2] - 2.f * p[1] + p[0]) + 6 * t * (p[3] - 2.f * p[2] + p[1]);
+		}
+	};
+
+	struct Range {
+		size_t first, last;
+		vec3 tangentFirst;		//Both point into the segment
+		vec3 tangentLast;
+	};
+
+	vec3 Direction(vec3 from, vec3 to)
+	{
+		vec3 d = to - from;
+		float l = length(d);
+		return l > 0 ? d / l : vec3(1, 0, 0);
+	}
+
+	//The handle lengths along the fixed tangents that fit the samples best in the least squares sense
+	Bezier FitSegment(const std::vector<vec3> &samples, const Range &range, const std::vector<float> &u)
+	{
+		vec3 p0 = samples[range.first], p3 = samples[range.last];
+		double c00 = 0, c01 = 0, c11 = 0, x0 = 0, x1 = 0;
+		for (size_t i = 0; i < u.size(); ++i) {
+			float t = u[i], s = 1 - t;
+			float b0 = s * s * s, b1 = 3 * s * s * t, b2 = 3 * s * t * t, b3 = t * t * t;
+			vec3 a1 = range.tangentFirst * b1, a2 = range.tangentLast * b2;
+			vec3 rest = samples[range.first + i] - (p0 * (b0 + b1) + p3 * (b2 + b3));
+			c00 += dot(a1, a1);
+			c01 += dot(a1, a2);
+			c11 += dot(a2, a2);
+			x0 += dot(a1, rest);
+			x1 += dot(a2, rest);
+		}
+		double det = c00 * c11 - c01 * c01;
+		float alphaFirst = det != 0 ? (float)((x0 * c11 - x1 * c01) / det) : 0.f;
+		float alphaLast = det != 0 ? (float)((c00 * x1 - c01 * x0) / det) : 0.f;
+
+		//Degenerate or backwards handles, fall back to a third of the chord
+		float chord = distance(p0, p3);
+		if (alphaFirst < 1e-6f * chord || alphaLast < 1e-6f * chord)
+			alphaFirst = alphaLast = chord / 3;
+		return { { p0, p0 + range.tangentFirst * alphaFirst, p3 + range.tangentLast * alphaLast, p3 } };
+	}
+
+	//Squared distance of the worst sample and its index
+	float MaxError(const std::vector<vec3> &samples, const Range &range, const Bezier &bezier, const std::vector<float> &u, size_t &worst)
+	{
+		float maxError = 0.f;
+		worst = (range.first + range.last) / 2;
+		for (size_t i = 1; i + 1 < u.size(); ++i) {
+			vec3 d = bezier.Evaluate(u[i]) - samples[range.first + i];
+			float error = dot(d, d);
+			if (error >= maxError) {
+				maxError = error;
+				worst = range.first + i;
+			}
+		}
+		return maxError;
+	}
+
+	void Reparameterize(const std::vector<vec3> &samples, const Range &range, const Bezier &bezier, std::vector<float> &u)
+	{
+		for (size_t i = 1; i + 1 < u.size(); ++i) {
+			vec3 d = bezier.Evaluate(u[i]) - samples[range.first + i];
+			vec3 d1 = bezier.Derivative(u[i]);
+			float denominator = dot(d1, d1) + dot(d, bezier.SecondDerivative(u[i]));
+			if (denominator != 0)
+				u[i] = glm::clamp(u[i] - dot(d, d1) / denominator, 0.f, 1.f);
+		}
+	}
+}
+
+namespace CurveFitter {
+
+	std::vector<RedefinedPoint> FitBezier(const std::vector<vec3> &input, float tolerance, Stats *stats)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		//Repeated samples have no direction
+		std::vector<vec3> samples;
+		samples.reserve(input.size());
+		for (const vec3 &p : input)
+			if (samples.empty() || p != samples.back())
+				samples.push_back(p);
+
+		std::vector<Bezier> segments;
+		float maxError = 0.f;
+		if (samples.size() >= 2) {
+			//Chord length parameters, a range maps its part of the arc length to 0..1
+			std::vector<double> arcLength(samples.size(), 0.0);
+			for (size_t i = 1; i < samples.size(); ++i)
+				arcLength[i] = arcLength[i - 1] + distance(samples[i - 1], samples[i]);
+
+			float toleranceSq = tolerance * tolerance;
+			size_t last = samples.size() - 1;
+			//Ranges still to fit, the left half of a split is on top so segments come out in order
+			std::vector<Range> stack;
+			stack.push_back({ 0, last, Direction(samples[0], samples[1]), Direction(samples[last], samples[last - 1]) });
+			std::vector<float> u;
+			while (!stack.empty()) {
+				Range range = stack.back();
+				stack.pop_back();
+
+				u.resize(range.last - range.first + 1);
+				double from = arcLength[range.first], span = arcLength[range.last] - from;
+				for (size_t i = 0; i < u.size(); ++i)
+					u[i] = (float)((arcLength[range.first + i] - from) / span);
+
+				Bezier bezier = FitSegment(samples, range, u);
+				size_t worst;
+				float error = MaxError(samples, range, bezier, u, worst);
+				for (int k = 0; k < NewtonIterations && error > toleranceSq && error < toleranceSq * ReparameterizeFactor * ReparameterizeFactor; ++k) {
+					Reparameterize(samples, range, bezier, u);
+					bezier = FitSegment(samples, range, u);
+					error = MaxError(samples, range, bezier, u, worst);
+				}
+				if (error <= toleranceSq || range.last - range.first < 2) {
+					segments.push_back(bezier);
+					maxError = std::max(maxError, error);
+					continue;
+				}
+
+				vec3 center = Direction(samples[worst + 1], samples[worst - 1]);
+				stack.push_back({ worst, range.last, -center, range.tangentLast });
+				stack.push_back({ range.first, worst, range.tangentFirst, center });
+			}
+		}
+
+		std::vector<RedefinedPoint> points(segments.empty() ? samples.size() : segments.size() + 1);
+		for (size_t i = 0; i < segments.size(); ++i) {
+			points[i].pos = segments[i].p[0];
+			points[i].bezierTangentF = segments[i].p[1] - segments[i].p[0];
+			points[i].hermiteTangent = 3.f * points[i].bezierTangentF;
+			points[i + 1].pos = segments[i].p[3];
+			points[i + 1].bezierTangentB = segments[i].p[2] - segments[i].p[3];
+			points[i + 1].hermiteTangent = -3.f * points[i + 1].bezierTangentB;
+		}
+		if (segments.empty() && !samples.empty())
+			points[0].pos = samples[0];
+
+		if (stats) {
+			stats->samples = input.size();
+			stats->points = points.size();
+			stats->maxError = std::sqrt(maxError);
+			stats->ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		return points;
+	}
+
+	std::vector<vec3> SamplePath(size_t sampleCount)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> jitter(-0.001f, 0.001f);
+		std::vector<vec3> samples(sampleCount);
+		for (size_t i = 0; i < sampleCount; ++i) {
+			float t = 2 * (float)M_PI * i / std::max<size_t>(sampleCount - 1, 1);
+			vec3 p(4 * std::sin(3 * t) + 0.5f * std::sin(17 * t), 3 * std::cos(2 * t), 2 * std::sin(5 * t));
+			samples[i] = p + vec3(jitter(rng), jitter(rng), jitter(rng));
+		}
+		return samples;
+	}
+
+	Stats Benchmark(size_t sampleCount, float tolerance)
+	{
+		Stats stats;
+		FitBezier(SamplePath(sampleCount), tolerance, &stats);
+		return stats;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "RedefinedPoint.h"
+#include <vector>
+
+//Compresses dense sample paths into a few bezier control points for PointInterp.
+//The fit is Schneider's least squares cubic fitting (Graphics Gems I): a segment between two samples gets the handle
+//lengths that minimize the squared distance to the samples in between, with Newton steps on the sample parameters.
+//Where the error stays above the tolerance the segment is split at the worst sample. Both halves share the tangent
+//direction at the split, so the curve stays smooth across the joint
+namespace CurveFitter {
+
+	struct Stats {
+		size_t samples;
+		size_t points;
+		float maxError;			//Largest distance of a sample from the fitted curve
+		double ms;
+	};
+
+	//Control points with bezierTangentF / bezierTangentB set, every sample lies within tolerance of the curve.
+	//hermiteTangent is set from the forward handle, so hermite mode draws a close approximation
+	std::vector<RedefinedPoint> FitBezier(const std::vector<vec3> &samples, float tolerance, Stats *stats = nullptr);
+
+	//A smooth closed knot with a little jitter, like a recorded motion path
+	std::vector<vec3> SamplePath(size_t sampleCount);
+	Stats Benchmark(size_t sampleCount = 1000000, float tolerance = 0.01f);
+}
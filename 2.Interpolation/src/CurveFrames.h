@@ -0,0 +1,31 @@
+#pragma once
+#include "cinder/Vector.h"
+#include <cstdint>
+#include <vector>
+
+using namespace ci;
+
+//Orientation along a curve, tangent x normal = binormal
+struct CurveFrame {
+	vec3 tangent;
+	vec3 normal;
+	vec3 binormal;
+};
+
+//Rotation minimizing frames by double reflection (Wang et al., "Computation of Rotation Minimizing Frames", 2008).
+//Every frame is the one before it reflected twice, first onto the next point and then onto the next tangent, which
+//keeps the twist around the tangent minimal without the flips of Frenet frames at inflections and straight parts.
+//The points must not repeat consecutively
+namespace CurveFrames {
+
+	//Unit tangents for points [begin, end), central differences inside, one sided at the ends
+	void Tangents(const std::vector<vec3> &points, std::vector<vec3> &tangents, size_t begin = 0, size_t end = SIZE_MAX);
+
+	//Recomputes frames from begin on, frames before begin are kept. Once past settleFrom a frame that comes out (nearly)
+	//unchanged ends the propagation, as all later ones would too. Returns the end of the frames that were rewritten
+	size_t RotationMinimizing(const std::vector<vec3> &points, const std::vector<vec3> &tangents, std::vector<CurveFrame> &frames,
+							  size_t begin = 0, size_t settleFrom = SIZE_MAX);
+
+	//Copies curve without consecutive repeats, like the joints of the tessellated segments
+	void RemoveRepeats(const std::vector<vec3> &curve, std::vector<vec3> &points);
+}
@@ -0,0 +1,89 @@
+#include "CurveLine.h"
+
+void CurveLine::Allocate(int slot, size_t vertexCapacity)
+{
+	static gl::GlslProgRef progRef = gl::GlslProg::create(gl::GlslProg::Format()
+		.vertex(CI_GLSL(150,
+			uniform mat4	ciModelViewProjection;
+			in vec4			ciPosition;
+
+			void main(void) {
+				gl_Position = ciModelViewProjection * ciPosition;
+			}
+		))
+		.geometry(CI_GLSL(150,
+			layout(lines_adjacency) in;
+			layout(triangle_strip, max_vertices = 4) out;
+			uniform vec2	uViewport;
+			uniform float	uThickness;
+
+			vec2 toScreen(vec4 p) { return p.xy / p.w * uViewport * 0.5; }
+
+			//Direction of b - a, fallback when both are the same point (the repeated first and last vertex)
+			vec2 direction(vec2 a, vec2 b, vec2 fallback) {
+				vec2 d = b - a;
+				return dot(d, d) > 1e-8 ? normalize(d) : fallback;
+			}
+
+			//Offsets the end of the segment along the miter of the joint, in clip space
+			void emitCorner(vec4 p, vec2 miter, float side) {
+				gl_Position = p + vec4(miter * side / uViewport * 2.0 * p.w, 0, 0);
+				EmitVertex();
+			}
+
+			void main(void) {
+				vec4 p1 = gl_in[1].gl_Position;
+				vec4 p2 = gl_in[2].gl_Position;
+				vec2 s0 = toScreen(gl_in[0].gl_Position);
+				vec2 s1 = toScreen(p1);
+				vec2 s2 = toScreen(p2);
+				vec2 s3 = toScreen(gl_in[3].gl_Position);
+
+				vec2 dir = direction(s1, s2, vec2(1, 0));
+				vec2 normal = vec2(-dir.y, dir.x);
+				vec2 tangent1 = normalize(direction(s0, s1, dir) + dir);
+				vec2 tangent2 = normalize(dir + direction(s2, s3, dir));
+				vec2 miter1 = vec2(-tangent1.y, tangent1.x);
+				vec2 miter2 = vec2(-tangent2.y, tangent2.x);
+				//Sharp joints would make the miter arbitrarily long, it is limited to four times the width
+				float width1 = uThickness * 0.5 / max(dot(miter1, normal), 0.25);
+				float width2 = uThickness * 0.5 / max(dot(miter2, normal), 0.25);
+
+				emitCorner(p1, miter1, width1);
+				emitCorner(p1, miter1, -width1);
+				emitCorner(p2, miter2, width2);
+				emitCorner(p2, miter2, -width2);
+				EndPrimitive();
+			}
+		))
+		.fragment(CI_GLSL(150,
+			uniform vec4	uColor;
+			out vec4		oColor;
+
+			void main(void) {
+				oColor = uColor;
+			}
+		)));
+
+	vboRefs[slot] = gl::Vbo::create(GL_ARRAY_BUFFER, vertexCapacity * sizeof(vec3), nullptr, GL_DYNAMIC_DRAW);
+	geom::BufferLayout layout;
+	layout.append(geom::Attrib::POSITION, 3, 0, 0);
+	auto mesh = gl::VboMesh::create((uint32_t)vertexCapacity, GL_LINE_STRIP_ADJACENCY, { { layout, vboRefs[slot] } });
+	batchRefs[slot] = gl::Batch::create(mesh, progRef);
+}
+
+void CurveLine::Upload(int slot, size_t first, size_t count, const vec3 *vertices)
+{
+	vboRefs[slot]->bufferSubData(first * sizeof(vec3), count * sizeof(vec3), vertices);
+}
+
+void CurveLine::draw(float thickness, Color color)
+{
+	if (buffer.VertexCount() < 4)
+		return;
+	auto &batchRef = batchRefs[slot];
+	batchRef->getGlslProg()->uniform("uViewport", vec2(gl::getViewport().second));
+	batchRef->getGlslProg()->uniform("uThickness", thickness);
+	batchRef->getGlslProg()->uniform("uColor", ColorA(color, 1.f));
+	batchRef->draw(0, (GLsizei)buffer.VertexCount());
+}
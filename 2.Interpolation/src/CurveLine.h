@@ -0,0 +1,24 @@
+#pragma once
+#include "cinder/gl/gl.h"
+#include "CurveBuffer.h"
+
+using namespace ci;
+
+//Draws a curve as a line of constant width in pixels with one draw call.
+//A geometry shader turns every segment into a quad and miters the joints with the neighbouring segments
+class CurveLine : public CurveUploadBackend {
+public:
+	CurveLine() : buffer(*this) {}
+	void Update(const std::vector<vec3> &curve) { slot = buffer.Update(curve); }
+	void draw(float thickness, Color color);
+	size_t VerticesUploaded() const { return buffer.verticesUploaded; }
+
+	void Allocate(int slot, size_t vertexCapacity) override;
+	void Upload(int slot, size_t first, size_t count, const vec3 *vertices) override;
+
+private:
+	CurveBuffer buffer;
+	int slot = 0;
+	gl::VboRef vboRefs[CurveBuffer::SlotCount];
+	gl::BatchRef batchRefs[CurveBuffer::SlotCount];
+};
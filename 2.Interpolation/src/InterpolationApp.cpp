@@ -3,6 +3,8 @@
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
 #include "splines.h"
+#include "CurveFitter.h"
+#include <algorithm>
 #include <functional>
 
 using namespace ci;
@@ -16,6 +18,7 @@ public:
 	void mouseDown(MouseEvent event) override;
 	void mouseUp(MouseEvent event) override;
 	void mouseDrag(MouseEvent event) override;
+	void mouseMove(MouseEvent event) override;
 	void mouseWheel(MouseEvent event) override;
 	void resize() override;
 	void update() override;
@@ -25,6 +28,10 @@ public:
 private:
 	void runSplineTest(); //Called when "Run Spline Test is clicked"
 	void splineTestUpdate(); //Called each frame
+	void BenchmarkTessellation();
+	void FitSamplePath();
+	void BenchmarkCurveFitting();
+	void BenchmarkTubeExtrusion();
     double getDistance(vec3 point1, vec3 point2);
 
 	params::InterfaceGlRef interfaceRef;
@@ -46,7 +53,7 @@ private:
     float velocity = 0.5f;
     float interval = 0.1f;
 
-	std::vector<string> modeStrings = {"line", "hermite", "parabol","bezier"}; 
+	std::vector<string> modeStrings = {"line", "hermite", "parabol","bezier", "C2 cubic", "Kochanek-Bartels", "B-spline", "NURBS"}; 
 	int modeSelected = 0;
 };
 
@@ -57,8 +64,29 @@ void InterpolationApp::setup()
 	interfaceRef = params::InterfaceGl::create(getWindow(), "Interpolation", toPixels(ivec2(200, 200)));
 	interfaceRef->addButton("Add Point", std::bind(&PointInterp::InsertPoint, spline), "");
 	interfaceRef->addButton("Start Spline Test", std::bind(&InterpolationApp::runSplineTest, this), "");
+	interfaceRef->addButton("Benchmark tessellation", std::bind(&InterpolationApp::BenchmarkTessellation, this), "");
+	interfaceRef->addButton("Fit sample path", std::bind(&InterpolationApp::FitSamplePath, this), "");
+	interfaceRef->addButton("Benchmark curve fitting", std::bind(&InterpolationApp::BenchmarkCurveFitting, this), "");
+	interfaceRef->addButton("Benchmark tube extrusion", std::bind(&InterpolationApp::BenchmarkTubeExtrusion, this), "");
 	interfaceRef->addSeparator();
 	interfaceRef->addParam("Mode", modeStrings, &modeSelected).updateFn([this] {spline->ChangeMode(modeSelected); });
+	interfaceRef->addParam("Clamped ends", &spline->clampedEnds);
+	interfaceRef->addParam("KB tension", &spline->kbTension).min(-1.f).max(1.f).step(0.05f);
+	interfaceRef->addParam("KB continuity", &spline->kbContinuity).min(-1.f).max(1.f).step(0.05f);
+	interfaceRef->addParam("KB bias", &spline->kbBias).min(-1.f).max(1.f).step(0.05f);
+	interfaceRef->addParam("Spline degree", &spline->splineDegree).min(1).max(NurbsCurve::MaxDegree);
+	//Weight of the selected point in NURBS mode
+	interfaceRef->addParam<float>("Point weight", [this](float weight) {
+		if (spline->activePoint < 0 || spline->activePoint >= (int)spline->points.size())
+			return;
+		spline->points[spline->activePoint].weight = std::max(weight, 0.01f);
+		spline->PointChanged(spline->activePoint);
+	}, [this] {
+		bool selected = spline->activePoint >= 0 && spline->activePoint < (int)spline->points.size();
+		return selected ? spline->points[spline->activePoint].weight : 1.f;
+	}).min(0.01f).max(100.f).step(0.1f);
+	interfaceRef->addParam("Curve thickness", &spline->curveThickness).min(1.f).max(20.f).step(0.5f);
+	interfaceRef->addParam("Show tube", &spline->showTube);
 
 	//Setting up the Skybox. Feel free to change the background
 	auto skyBoxGlsl = gl::GlslProg::create(loadAsset("sky_box.vert"), loadAsset("sky_box.frag"));
@@ -140,6 +168,11 @@ void InterpolationApp::mouseDrag(MouseEvent event)
 	}
 }
 
+void InterpolationApp::mouseMove(MouseEvent event)
+{
+	spline->MouseMove(event, cam);
+}
+
 void InterpolationApp::mouseWheel(MouseEvent event)
 {
 	cam.setEyePoint(cam.getEyePoint() + normalize(cam.getViewDirection()) * event.getWheelIncrement() * 0.3f);
@@ -213,6 +246,48 @@ void InterpolationApp::splineTestUpdate()
 	//todo TASK5 - end
 }
 
+//Tessellates a million bezier segments with 1 to all hardware threads and prints the timings
+void InterpolationApp::BenchmarkTessellation()
+{
+	auto results = PointInterp::BenchmarkTessellation(1000000);
+	cout << "Tessellation, " << results[0].segmentCount << " segments, " << results[0].vertexCount << " vertices" << endl;
+	for (auto &result : results)
+		cout << result.threads << " threads: " << result.ms << " ms, speedup " << results[0].ms / result.ms
+			 << (result.matchesSingleThread ? "" : ", OUTPUT DIFFERS") << endl;
+	cout << endl;
+}
+
+//Replaces the control points with a bezier fit of a dense synthetic path
+void InterpolationApp::FitSamplePath()
+{
+	CurveFitter::Stats stats;
+	spline->points = CurveFitter::FitBezier(CurveFitter::SamplePath(100000), 0.01f, &stats);
+	spline->activePoint = -1;
+	modeSelected = PointInterp::bezier;
+	spline->ChangeMode(modeSelected);
+	cout << "Fitted " << stats.samples << " samples with " << stats.points << " points in " << stats.ms << " ms, max error " << stats.maxError << endl << endl;
+}
+
+//Fits a million samples and prints the reduction
+void InterpolationApp::BenchmarkCurveFitting()
+{
+	auto stats = CurveFitter::Benchmark(1000000, 0.01f);
+	cout << "Curve fitting, " << stats.samples << " samples, tolerance 0.01" << endl
+		 << "points:    " << stats.points << " (" << (double)stats.samples / stats.points << " : 1)" << endl
+		 << "max error: " << stats.maxError << endl
+		 << "time:      " << stats.ms << " ms" << endl << endl;
+}
+
+//Extrudes a tube along 100k samples and edits it, prints the timings
+void InterpolationApp::BenchmarkTubeExtrusion()
+{
+	auto result = TubeMesh::Benchmark(100000);
+	cout << "Tube extrusion, " << result.samples << " samples" << endl
+		 << "frames + extrusion: " << result.fullMs << " ms (" << result.samples / result.fullMs << " samples/ms)" << endl
+		 << "local edit:         " << result.editMs << " ms, " << result.editRings << " rings" << endl
+		 << "bend near start:    " << result.bendMs << " ms, " << result.bendRings << " rings" << endl << endl;
+}
+
 void InterpolationApp::resize()
 {
 	cam.setAspectRatio(getWindowAspectRatio());
@@ -0,0 +1,140 @@
+#include "Nurbs.h"
+#include <algorithm>
+
+void NurbsCurve::SetUniform(size_t controlCount, int newDegree)
+{
+	degree = std::max(1, std::min(newDegree, MaxDegree));
+	knots.assign(controlCount + degree + 1, 0.f);
+	if (controlCount <= (size_t)degree)
+		return;
+	size_t spans = controlCount - degree;
+	for (size_t i = 0; i < knots.size(); ++i) {
+		size_t k = i < (size_t)degree ? 0 : std::min(i - degree, spans);
+		knots[i] = (float)k;
+	}
+}
+
+void NurbsCurve::SetKnots(const std::vector<float> &newKnots, int newDegree)
+{
+	degree = std::max(1, std::min(newDegree, MaxDegree));
+	knots = newKnots;
+}
+
+size_t NurbsCurve::FindSpan(float u) const
+{
+	size_t spans = SpanCount();
+	if (spans == 0)
+		return 0;
+	//The first knot above u, the span ends there
+	auto begin = knots.begin() + degree + 1, end = knots.begin() + degree + spans;
+	size_t span = std::upper_bound(begin, end, u) - begin;
+	return std::min(span, spans - 1);
+}
+
+void NurbsCurve::SpansOf(size_t i, size_t &first, size_t &end) const
+{
+	size_t spans = SpanCount();
+	first = i > (size_t)degree ? i - degree : 0;
+	end = std::min(i + 1, spans);
+	first = std::min(first, end);
+}
+
+void NurbsCurve::EvaluateSpan(size_t span, const float *t, size_t count, const vec4 *controls, vec3 *out) const
+{
+	//Knot index of the span as in the usual formulation, its control points are k - degree .. k
+	size_t k = span + degree;
+	const vec4 *p = controls + span;
+	float start = knots[k], length = knots[k + 1] - knots[k];
+	//One plane per coordinate, the lanes of a plane are contiguous
+	float d[4][MaxDegree + 1][Lanes];
+	float u[Lanes];
+	float alpha[Lanes];
+
+	for (size_t block = 0; block < count; block += Lanes) {
+		size_t n = std::min((size_t)Lanes, count - block);
+		for (size_t l = 0; l < Lanes; ++l)
+			u[l] = start + length * t[block + std::min(l, n - 1)];
+		for (int c = 0; c < 4; ++c)
+			for (int j = 0; j <= degree; ++j)
+				for (size_t l = 0; l < Lanes; ++l)
+					d[c][j][l] = p[j][c];
+		for (int r = 1; r <= degree; ++r) {
+			for (int j = degree; j >= r; --j) {
+				float left = knots[j + k - degree];
+				float right = knots[j + 1 + k - r];
+				float scale = right > left ? 1.f / (right - left) : 0.f;
+				for (size_t l = 0; l < Lanes; ++l)
+					alpha[l] = (u[l] - left) * scale;
+				for (int c = 0; c < 4; ++c)
+					for (size_t l = 0; l < Lanes; ++l)
+						d[c][j][l] = d[c][j - 1][l] + alpha[l] * (d[c][j][l] - d[c][j - 1][l]);
+			}
+		}
+		for (size_t l = 0; l < n; ++l)
+			out[block + l] = vec3(d[0][degree][l], d[1][degree][l], d[2][degree][l]) / d[3][degree][l];
+	}
+}
+
+vec3 NurbsCurve::Evaluate(float u, const vec4 *controls) const
+{
+	size_t span = FindSpan(u);
+	float length = SpanEnd(span) - SpanStart(span);
+	float t = length > 0 ? (u - SpanStart(span)) / length : 0.f;
+	vec3 out;
+	EvaluateSpan(span, &t, 1, controls, &out);
+	return out;
+}
+
+void NurbsTessellation::SetControls(const std::vector<vec4> &newControls, int degree)
+{
+	controls = newControls;
+	curve.SetUniform(controls.size(), degree);
+	samples.clear();
+	dirtyBegin = SIZE_MAX;
+	dirtyEnd = 0;
+}
+
+void NurbsTessellation::MoveControl(size_t i, vec4 control)
+{
+	if (i >= controls.size())
+		return;
+	controls[i] = control;
+	size_t first, end;
+	curve.SpansOf(i, first, end);
+	dirtyBegin = std::min(dirtyBegin, first);
+	dirtyEnd = std::max(dirtyEnd, end);
+}
+
+//The spans write into disjoint ranges of the samples, so the threads need no locking
+void NurbsTessellation::Tessellate(const std::vector<float> &newParameters, ThreadPool &pool, size_t grain)
+{
+	parameters = newParameters;
+	size_t stride = parameters.size() + 1;
+	samples.resize(curve.SpanCount() * stride);
+	pool.ParallelFor(curve.SpanCount(), grain, [&](size_t begin, size_t end) {
+		for (size_t span = begin; span < end; ++span)
+			EvaluateSpan(span, &samples[span * stride]);
+	});
+	dirtyBegin = SIZE_MAX;
+	dirtyEnd = 0;
+}
+
+size_t NurbsTessellation::Retessellate()
+{
+	size_t stride = parameters.size() + 1;
+	size_t end = std::min(dirtyEnd, samples.size() / stride);
+	size_t count = 0;
+	for (size_t span = dirtyBegin; span < end; ++span, ++count)
+		EvaluateSpan(span, &samples[span * stride]);
+	dirtyBegin = SIZE_MAX;
+	dirtyEnd = 0;
+	return count;
+}
+
+//The samples of a span followed by its end point, like the segments of the other modes of PointInterp
+void NurbsTessellation::EvaluateSpan(size_t span, vec3 *out) const
+{
+	curve.EvaluateSpan(span, parameters.data(), parameters.size(), controls.data(), out);
+	float end = 1.f;
+	curve.EvaluateSpan(span, &end, 1, controls.data(), out + parameters.size());
+}
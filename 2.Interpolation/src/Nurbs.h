@@ -0,0 +1,70 @@
+#pragma once
+#include "cinder/Vector.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+using namespace ci;
+
+//A B-spline curve over a knot vector, rational when the control points carry weights (NURBS).
+//Control points are homogeneous, (w x, w y, w z, w). A point of the curve only depends on the degree + 1 control points
+//of its knot span, so moving one control point changes degree + 1 spans and nothing else
+class NurbsCurve {
+public:
+	static const int MaxDegree = 7;
+	static const int Lanes = 8;		//Samples evaluated together
+
+	//Clamped knots with uniform spacing inside, the curve starts at the first and ends at the last control point
+	void SetUniform(size_t controlCount, int degree);
+	//knots must not decrease and hold controlCount + degree + 1 values
+	void SetKnots(const std::vector<float> &knots, int degree);
+
+	int Degree() const { return degree; }
+	size_t ControlCount() const { return knots.size() > (size_t)degree ? knots.size() - degree - 1 : 0; }
+	//Spans are counted from the first one the curve uses, span s lies between knots[s + degree] and knots[s + degree + 1]
+	size_t SpanCount() const { return ControlCount() > (size_t)degree ? ControlCount() - degree : 0; }
+	float SpanStart(size_t span) const { return knots[span + degree]; }
+	float SpanEnd(size_t span) const { return knots[span + degree + 1]; }
+	const std::vector<float>& Knots() const { return knots; }
+
+	//The span that contains u by binary search over the knots, the last one for the end of the curve
+	size_t FindSpan(float u) const;
+	//The spans [first, end) that control point i contributes to
+	void SpansOf(size_t i, size_t &first, size_t &end) const;
+
+	//Evaluates count parameters t of one span, 0 at its start and 1 at its end. De Boor's triangle is built one level at a
+	//time for Lanes samples, they share the control points and knots, so the innermost loops run over the samples
+	void EvaluateSpan(size_t span, const float *t, size_t count, const vec4 *controls, vec3 *out) const;
+	vec3 Evaluate(float u, const vec4 *controls) const;
+
+private:
+	std::vector<float> knots;
+	int degree = 3;
+};
+
+//A NurbsCurve with its controls and a tessellation that is kept between edits. Every span owns parameters + 1 samples,
+//its samples followed by its end point. Moving a control only marks the spans it shapes, Retessellate() evaluates
+//those again and leaves the rest of the samples as they are
+class NurbsTessellation {
+public:
+	//Clamped uniform knots for the controls, the samples are invalid until the next Tessellate
+	void SetControls(const std::vector<vec4> &controls, int degree);
+	void MoveControl(size_t i, vec4 control);
+	//All spans at the parameters 0 <= t < 1, grain spans at a time are handed to the threads of pool
+	void Tessellate(const std::vector<float> &parameters, ThreadPool &pool, size_t grain);
+	//Only the spans of the controls moved since the last tessellation, returns how many
+	size_t Retessellate();
+
+	const NurbsCurve& Curve() const { return curve; }
+	const std::vector<vec4>& Controls() const { return controls; }
+	const std::vector<vec3>& Samples() const { return samples; }
+
+private:
+	void EvaluateSpan(size_t span, vec3 *out) const;
+
+	NurbsCurve curve;
+	std::vector<vec4> controls;
+	std::vector<float> parameters;
+	std::vector<vec3> samples;
+	size_t dirtyBegin = SIZE_MAX, dirtyEnd = 0;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include "cinder/Vector.h"
+
+using namespace ci;
+
+//A control point of PointInterp with the handles of every interpolation mode
+class RedefinedPoint {
+public:
+	RedefinedPoint() {
+		hermiteTangent = vec3(0, 1.5, 0);
+		bezierTangentF = vec3(0, 1, 1);
+		bezierTangentB = vec3(0, -1, -1);
+		weight = 1.f;
+	};
+
+public:
+	vec3 pos;				//Position of the Control Point
+	vec3 hermiteTangent;	//Relative position of the hermite tangent
+	vec3 bezierTangentF;	//Relative position of the bezier tangent pointing forward
+	vec3 bezierTangentB;	//Relative position of the bezier tangent pointing backward
+	float weight;			//Pull of the point on the NURBS curve, above 0
+};
@@ -0,0 +1,443 @@
+#include "SegmentBVH.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	const int ClosestSamples = 8;
+	const int NewtonIterations = 8;	//Steps that leave the bracket bisect it, 8 halvings still end below 1e-3
+	const int SpanSamples = 8;			//Per refinement of a span, one block of NurbsCurve::Lanes
+	const int SpanStartSamples = 32;	//Over the whole span, enough to separate the minima of a span that wiggles
+	const int SpanRefinements = 8;		//Each narrows the parameter interval to 2 / (SpanSamples - 1) of its width
+
+	vec3 Derivative(const SegmentBVH::Bezier &b, float t)
+	{
+		float s = 1 - t;
+		return 3 * s * s * (b[1] - b[0]) + 6 * s * t * (b[2] - b[1]) + 3 * t * t * (b[3] - b[2]);
+	}
+
+	vec3 SecondDerivative(const SegmentBVH::Bezier &b, float t)
+	{
+		return 6 * (1 - t) * (b[2] - 2.f * b[1] + b[0]) + 6 * t * (b[3] - 2.f * b[2] + b[1]);
+	}
+
+	//Entry parameter of the ray into the box, FLT_MAX if it misses
+	float RayBox(vec3 origin, vec3 direction, vec3 min, vec3 max, float tMax)
+	{
+		float tEnter = 0, tExit = tMax;
+		for (int a = 0; a < 3; ++a) {
+			if (direction[a] == 0) {
+				if (origin[a] < min[a] || origin[a] > max[a])
+					return FLT_MAX;
+				continue;
+			}
+			float t0 = (min[a] - origin[a]) / direction[a], t1 = (max[a] - origin[a]) / direction[a];
+			tEnter = std::max(tEnter, std::min(t0, t1));
+			tExit = std::min(tExit, std::max(t0, t1));
+		}
+		return tEnter <= tExit ? tEnter : FLT_MAX;
+	}
+
+	float BoxDistanceSq(vec3 p, vec3 min, vec3 max)
+	{
+		float d = 0;
+		for (int a = 0; a < 3; ++a) {
+			float outside = std::max(std::max(min[a] - p[a], p[a] - max[a]), 0.f);
+			d += outside * outside;
+		}
+		return d;
+	}
+}
+
+vec3 SegmentBVH::Evaluate(const Bezier &b, float t)
+{
+	float s = 1 - t;
+	return s * s * s * b[0] + 3 * s * s * t * b[1] + 3 * s * t * t * b[2] + t * t * t * b[3];
+}
+
+void SegmentBVH::Build(const std::vector<Bezier> &newSegments)
+{
+	segments = newSegments;
+	span = nullptr;
+	boxes.resize(segments.size());
+	for (size_t i = 0; i < segments.size(); ++i) {
+		boxes[i] = Box();
+		for (const vec3 &p : segments[i])
+			boxes[i].Add(p);
+	}
+	BuildTree();
+}
+
+void SegmentBVH::Build(const std::vector<Box> &hulls, const SpanFn &newSpan)
+{
+	segments.clear();
+	span = newSpan;
+	boxes = hulls;
+	BuildTree();
+}
+
+void SegmentBVH::BuildTree()
+{
+	size_t count = boxes.size();
+	nodes.clear();
+	order.resize(count);
+	leafOf.assign(count, -1);
+	centers.resize(count);
+	for (int i = 0; i < (int)count; ++i) {
+		order[i] = i;
+		vec3 min, max;
+		Bounds(i, min, max);
+		centers[i] = (min + max) * 0.5f;
+	}
+	if (count > 0) {
+		nodes.reserve(4 * count / LeafSize + 1);
+		nodes.resize(1);
+		nodes[0].parent = -1;
+		BuildNode(0, 0, (int)count);
+	}
+	centers.clear();
+}
+
+//Fills the node that is already allocated, its children are allocated as a pair so the right one is always left + 1
+void SegmentBVH::BuildNode(int node, int begin, int end)
+{
+	if (end - begin <= LeafSize) {
+		nodes[node].first = begin;
+		nodes[node].count = end - begin;
+		for (int i = begin; i < end; ++i)
+			leafOf[order[i]] = node;
+		FitNode(node);
+		return;
+	}
+
+	vec3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = begin; i < end; ++i) {
+		lo = glm::min(lo, centers[order[i]]);
+		hi = glm::max(hi, centers[order[i]]);
+	}
+	vec3 extent = hi - lo;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	int mid = (begin + end) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+					 [this, axis](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+	int left = (int)nodes.size();
+	nodes.resize(nodes.size() + 2);
+	nodes[node].first = left;
+	nodes[node].count = 0;
+	nodes[left].parent = nodes[left + 1].parent = node;
+	BuildNode(left, begin, mid);
+	BuildNode(left + 1, mid, end);
+	FitNode(node);
+}
+
+void SegmentBVH::Bounds(int segment, vec3 &min, vec3 &max) const
+{
+	min = boxes[segment].min;
+	max = boxes[segment].max;
+}
+
+void SegmentBVH::FitNode(int node)
+{
+	Node &n = nodes[node];
+	n.min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	n.max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	if (n.count == 0) {
+		for (int c = n.first; c <= n.first + 1; ++c) {
+			n.min = glm::min(n.min, nodes[c].min);
+			n.max = glm::max(n.max, nodes[c].max);
+		}
+		return;
+	}
+	for (int i = n.first; i < n.first + n.count; ++i) {
+		vec3 min, max;
+		Bounds(order[i], min, max);
+		n.min = glm::min(n.min, min);
+		n.max = glm::max(n.max, max);
+	}
+}
+
+void SegmentBVH::Update(int segment, const Bezier &bezier)
+{
+	segments[segment] = bezier;
+	boxes[segment] = Box();
+	for (const vec3 &p : bezier)
+		boxes[segment].Add(p);
+	Refit(segment);
+}
+
+void SegmentBVH::Update(int segment, const Box &hull)
+{
+	boxes[segment] = hull;
+	Refit(segment);
+}
+
+void SegmentBVH::Refit(int segment)
+{
+	for (int node = leafOf[segment]; node != -1; node = nodes[node].parent) {
+		vec3 oldMin = nodes[node].min, oldMax = nodes[node].max;
+		FitNode(node);
+		//Ancestors only change if this box did
+		if (nodes[node].min == oldMin && nodes[node].max == oldMax)
+			break;
+	}
+}
+
+//Squared distance from p to the segment, t receives the parameter of the closest point.
+//Every sample that is nearer than its neighbours brackets a local minimum, each is refined and the best one wins
+float SegmentBVH::ClosestOnSegment(const Bezier &b, vec3 p, float &t)
+{
+	float distances[ClosestSamples + 1];
+	for (int k = 0; k <= ClosestSamples; ++k) {
+		vec3 d = Evaluate(b, k / (float)ClosestSamples) - p;
+		distances[k] = dot(d, d);
+	}
+	float best = FLT_MAX;
+	for (int k = 0; k <= ClosestSamples; ++k) {
+		if ((k > 0 && distances[k - 1] < distances[k]) || (k < ClosestSamples && distances[k + 1] < distances[k]))
+			continue;
+		float u = k / (float)ClosestSamples;
+		float distance = RefineOnSegment(b, p, std::max(k - 1, 0) / (float)ClosestSamples,
+										 std::min(k + 1, ClosestSamples) / (float)ClosestSamples, u);
+		if (std::min(distance, distances[k]) < best) {
+			best = std::min(distance, distances[k]);
+			t = distance < distances[k] ? u : k / (float)ClosestSamples;
+		}
+	}
+	return best;
+}
+
+//Newton on g(u) = (B(u) - p) . B'(u) = 0 from u, kept inside [lo, hi]. The sign of g narrows the interval, a step that
+//would leave it or that the curvature turns uphill bisects instead
+float SegmentBVH::RefineOnSegment(const Bezier &b, vec3 p, float lo, float hi, float &u)
+{
+	for (int k = 0; k < NewtonIterations; ++k) {
+		vec3 w = Evaluate(b, u) - p;
+		vec3 d1 = Derivative(b, u);
+		float g = dot(w, d1);
+		if (g < 0)
+			lo = u;
+		else
+			hi = u;
+		float denominator = dot(d1, d1) + dot(w, SecondDerivative(b, u));
+		float next = denominator > 0 ? u - g / denominator : -1.f;
+		u = next >= lo && next <= hi ? next : (lo + hi) * 0.5f;
+	}
+	vec3 d = Evaluate(b, u) - p;
+	return dot(d, d);
+}
+
+//Spans have no closed form derivatives here. Like on a segment every sample nearer than its neighbours is refined, by
+//sampling the interval around the best point again until it is small
+float SegmentBVH::ClosestOnSpan(int segment, vec3 p, vec3 direction, float &t) const
+{
+	float samples[SpanStartSamples];
+	float distances[SpanStartSamples];
+	SampleSpan(segment, p, direction, 0.f, 1.f, SpanStartSamples, samples, distances);
+	float step = 1.f / (SpanStartSamples - 1);
+	float best = FLT_MAX;
+	for (int k = 0; k < SpanStartSamples; ++k) {
+		if ((k > 0 && distances[k - 1] < distances[k]) || (k < SpanStartSamples - 1 && distances[k + 1] < distances[k]))
+			continue;
+		float u = samples[k];
+		float distance = RefineOnSpan(segment, p, direction, distances[k], u, step);
+		if (distance < best) {
+			best = distance;
+			t = u;
+		}
+	}
+	return best;
+}
+
+//Squared distances from p at count parameters spread over [lo, hi], measured perpendicular to direction if it is not zero
+void SegmentBVH::SampleSpan(int segment, vec3 p, vec3 direction, float lo, float hi, int count, float *samples,
+							float *distances) const
+{
+	float dd = dot(direction, direction);
+	vec3 points[SpanStartSamples];
+	for (int k = 0; k < count; ++k)
+		samples[k] = lo + (hi - lo) * k / (count - 1);
+	span(segment, samples, count, points);
+	for (int k = 0; k < count; ++k) {
+		vec3 w = points[k] - p;
+		if (dd > 0)
+			w -= direction * (dot(w, direction) / dd);
+		distances[k] = dot(w, w);
+	}
+}
+
+//Narrows the interval of width 2 step around u, best is the distance at u
+float SegmentBVH::RefineOnSpan(int segment, vec3 p, vec3 direction, float best, float &u, float step) const
+{
+	float samples[SpanSamples];
+	float distances[SpanSamples];
+	for (int r = 0; r < SpanRefinements; ++r) {
+		float lo = std::max(u - step, 0.f), hi = std::min(u + step, 1.f);
+		SampleSpan(segment, p, direction, lo, hi, SpanSamples, samples, distances);
+		for (int k = 0; k < SpanSamples; ++k)
+			if (distances[k] < best) {
+				best = distances[k];
+				u = samples[k];
+			}
+		step = (hi - lo) / (SpanSamples - 1);
+	}
+	return best;
+}
+
+float SegmentBVH::ClosestOn(int segment, vec3 p, float &t) const
+{
+	if (span)
+		return ClosestOnSpan(segment, p, vec3(0, 0, 0), t);
+	return ClosestOnSegment(segments[segment], p, t);
+}
+
+vec3 SegmentBVH::PointOn(int segment, float t) const
+{
+	if (!span)
+		return Evaluate(segments[segment], t);
+	vec3 point;
+	span(segment, &t, 1, &point);
+	return point;
+}
+
+bool SegmentBVH::RayNearest(const Ray &ray, float radius, Hit &hit) const
+{
+	segmentsTested = 0;
+	hit = Hit();
+	if (nodes.empty())
+		return false;
+	vec3 o = ray.getOrigin(), d = ray.getDirection();
+	float dd = dot(d, d);
+	vec3 r(radius, radius, radius);
+
+	std::vector<std::pair<int, float>> stack;
+	stack.push_back({ 0, RayBox(o, d, nodes[0].min - r, nodes[0].max + r, FLT_MAX) });
+	while (!stack.empty()) {
+		auto entry = stack.back();
+		stack.pop_back();
+		if (entry.second == FLT_MAX || entry.second > hit.rayT)
+			continue;
+		const Node &n = nodes[entry.first];
+		if (n.count == 0) {
+			float tLeft = RayBox(o, d, nodes[n.first].min - r, nodes[n.first].max + r, hit.rayT);
+			float tRight = RayBox(o, d, nodes[n.first + 1].min - r, nodes[n.first + 1].max + r, hit.rayT);
+			//The nearer child goes on top
+			if (tLeft < tRight) {
+				stack.push_back({ n.first + 1, tRight });
+				stack.push_back({ n.first, tLeft });
+			}
+			else {
+				stack.push_back({ n.first, tLeft });
+				stack.push_back({ n.first + 1, tRight });
+			}
+			continue;
+		}
+		for (int i = n.first; i < n.first + n.count; ++i) {
+			++segmentsTested;
+			//Projected along the ray the segment is still a bezier curve, its closest point to the projected origin
+			//is the point closest to the ray
+			float t, distanceSq;
+			if (span)
+				distanceSq = ClosestOnSpan(order[i], o, d, t);
+			else {
+				const Bezier &b = segments[order[i]];
+				Bezier projected;
+				for (int c = 0; c < 4; ++c) {
+					vec3 w = b[c] - o;
+					projected[c] = w - d * (dot(w, d) / dd);
+				}
+				distanceSq = ClosestOnSegment(projected, vec3(0, 0, 0), t);
+			}
+			if (distanceSq > radius * radius)
+				continue;
+			vec3 point = PointOn(order[i], t);
+			float rayT = dot(point - o, d) / dd;
+			if (rayT >= 0 && rayT < hit.rayT) {
+				hit.segment = order[i];
+				hit.t = t;
+				hit.point = point;
+				hit.distance = std::sqrt(distanceSq);
+				hit.rayT = rayT;
+			}
+		}
+	}
+	return hit.segment != -1;
+}
+
+bool SegmentBVH::Closest(vec3 p, Hit &hit, float maxDistance) const
+{
+	segmentsTested = 0;
+	hit = Hit();
+	if (nodes.empty())
+		return false;
+	float bestSq = maxDistance == FLT_MAX ? FLT_MAX : maxDistance * maxDistance;
+
+	std::vector<std::pair<int, float>> stack;
+	stack.push_back({ 0, BoxDistanceSq(p, nodes[0].min, nodes[0].max) });
+	while (!stack.empty()) {
+		auto entry = stack.back();
+		stack.pop_back();
+		if (entry.second >= bestSq)
+			continue;
+		const Node &n = nodes[entry.first];
+		if (n.count == 0) {
+			float dLeft = BoxDistanceSq(p, nodes[n.first].min, nodes[n.first].max);
+			float dRight = BoxDistanceSq(p, nodes[n.first + 1].min, nodes[n.first + 1].max);
+			if (dLeft < dRight) {
+				stack.push_back({ n.first + 1, dRight });
+				stack.push_back({ n.first, dLeft });
+			}
+			else {
+				stack.push_back({ n.first, dLeft });
+				stack.push_back({ n.first + 1, dRight });
+			}
+			continue;
+		}
+		for (int i = n.first; i < n.first + n.count; ++i) {
+			++segmentsTested;
+			float t;
+			float distanceSq = ClosestOn(order[i], p, t);
+			if (distanceSq < bestSq) {
+				bestSq = distanceSq;
+				hit.segment = order[i];
+				hit.t = t;
+			}
+		}
+	}
+	if (hit.segment == -1)
+		return false;
+	hit.point = PointOn(hit.segment, hit.t);
+	hit.distance = std::sqrt(bestSq);
+	return true;
+}
+
+void SegmentBVH::WithinRadius(vec3 p, float radius, std::vector<Hit> &hits) const
+{
+	segmentsTested = 0;
+	hits.clear();
+	if (nodes.empty())
+		return;
+	float radiusSq = radius * radius;
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		const Node &n = nodes[stack.back()];
+		stack.pop_back();
+		if (BoxDistanceSq(p, n.min, n.max) > radiusSq)
+			continue;
+		if (n.count == 0) {
+			stack.push_back(n.first);
+			stack.push_back(n.first + 1);
+			continue;
+		}
+		for (int i = n.first; i < n.first + n.count; ++i) {
+			++segmentsTested;
+			Hit hit;
+			float distanceSq = ClosestOn(order[i], p, hit.t);
+			if (distanceSq > radiusSq)
+				continue;
+			hit.segment = order[i];
+			hit.point = PointOn(hit.segment, hit.t);
+			hit.distance = std::sqrt(distanceSq);
+			hits.push_back(hit);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "cinder/Ray.h"
+#include "cinder/Vector.h"
+#include <array>
+#include <cfloat>
+#include <functional>
+#include <vector>
+
+using namespace ci;
+
+//Nearest point queries against a curve made of cubic bezier segments, or of spans of any degree given by their hull.
+//A segment lies inside the convex hull of its control points, so the box around them bounds it and the boxes are
+//arranged in a binary tree (median split along the longest axis). Queries descend nearest child first and skip every box
+//that cannot beat the best hit so far, a segment itself is solved from a few samples and Newton steps on the parameter.
+//Moving a control point only refits the boxes of its segments and their ancestors
+class SegmentBVH {
+public:
+	typedef std::array<vec3, 4> Bezier;
+	//Fills out with the points of a span at count parameters t in 0..1
+	typedef std::function<void(int segment, const float *t, size_t count, vec3 *out)> SpanFn;
+
+	struct Box {
+		vec3 min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		vec3 max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		void Add(vec3 p) { min = glm::min(min, p); max = glm::max(max, p); }
+	};
+
+	struct Hit {
+		int segment = -1;
+		float t = 0.f;				//Curve parameter within the segment
+		vec3 point;
+		float distance = FLT_MAX;	//From the query point or the ray
+		float rayT = FLT_MAX;		//Ray parameter of the point on the ray closest to the curve
+	};
+
+	void Build(const std::vector<Bezier> &segments);
+	void Update(int segment, const Bezier &bezier);
+	//Spans that are not cubic beziers, like those of a B-spline or NURBS curve. hulls holds the box around the control
+	//points of every span, span is kept to evaluate them and must stay valid while the tree is queried
+	void Build(const std::vector<Box> &hulls, const SpanFn &span);
+	void Update(int segment, const Box &hull);
+	size_t SegmentCount() const { return boxes.size(); }
+
+	//Of the segments that pass within radius of the ray, the one whose closest approach comes first along it
+	bool RayNearest(const Ray &ray, float radius, Hit &hit) const;
+	//The curve point nearest to p, if it is closer than maxDistance
+	bool Closest(vec3 p, Hit &hit, float maxDistance = FLT_MAX) const;
+	//The closest point of every segment that comes within radius of p
+	void WithinRadius(vec3 p, float radius, std::vector<Hit> &hits) const;
+
+	mutable int segmentsTested = 0;	//By the last query
+
+	static vec3 Evaluate(const Bezier &b, float t);
+
+private:
+	static const int LeafSize = 4;
+
+	struct Node {
+		vec3 min, max;
+		int first;		//Inner nodes: the left child, the right one follows it. Leaves: the first entry of order
+		int count;		//Segments of a leaf, 0 for inner nodes
+		int parent;
+	};
+
+	void BuildTree();
+	void BuildNode(int node, int begin, int end);
+	void Bounds(int segment, vec3 &min, vec3 &max) const;
+	void FitNode(int node);
+	void Refit(int segment);
+	static float ClosestOnSegment(const Bezier &b, vec3 p, float &t);
+	static float RefineOnSegment(const Bezier &b, vec3 p, float lo, float hi, float &u);
+	//Squared distance from p to a span, measured perpendicular to direction if it is not zero
+	float ClosestOnSpan(int segment, vec3 p, vec3 direction, float &t) const;
+	void SampleSpan(int segment, vec3 p, vec3 direction, float lo, float hi, int count, float *samples,
+					float *distances) const;
+	float RefineOnSpan(int segment, vec3 p, vec3 direction, float best, float &u, float step) const;
+	float ClosestOn(int segment, vec3 p, float &t) const;
+	vec3 PointOn(int segment, float t) const;
+
+	std::vector<Bezier> segments;	//Empty for spans
+	std::vector<Box> boxes;
+	SpanFn span;
+	std::vector<Node> nodes;
+	std::vector<int> order;			//Segment indices, every leaf owns a contiguous run
+	std::vector<int> leafOf;
+	std::vector<vec3> centers;		//Only used while building
+};
@@ -0,0 +1,108 @@
+#include "SplineTangents.h"
+#include <algorithm>
+
+namespace {
+	//Solves the rows [a, b] of the C2 system. Tangents just outside the range are taken as known
+	void SolveRange(const std::vector<vec3> &points, std::vector<vec3> &tangents, bool clamped, vec3 startTangent, vec3 endTangent,
+					size_t a, size_t b)
+	{
+		size_t n = points.size();
+		size_t count = b - a + 1;
+		//Thomas algorithm: forward elimination keeps the modified super diagonal and right side, back substitution solves
+		std::vector<float> super(count);
+		std::vector<vec3> rhs(count);
+		float previousSuper = 0.f;
+		for (size_t k = 0; k < count; ++k) {
+			size_t i = a + k;
+			float sub, diag, sup;
+			vec3 r;
+			if (i == 0) {
+				if (clamped) {
+					sub = 0; diag = 1; sup = 0; r = startTangent;
+				}
+				else {
+					sub = 0; diag = 2; sup = 1; r = 3.f * (points[1] - points[0]);
+				}
+			}
+			else if (i == n - 1) {
+				if (clamped) {
+					sub = 0; diag = 1; sup = 0; r = endTangent;
+				}
+				else {
+					sub = 1; diag = 2; sup = 0; r = 3.f * (points[n - 1] - points[n - 2]);
+				}
+			}
+			else {
+				sub = 1; diag = 4; sup = 1; r = 3.f * (points[i + 1] - points[i - 1]);
+			}
+			if (k == 0 && sub != 0) {
+				r -= sub * tangents[i - 1];
+				sub = 0;
+			}
+			if (k == count - 1 && sup != 0) {
+				r -= sup * tangents[i + 1];
+				sup = 0;
+			}
+
+			float m = diag - sub * previousSuper;
+			super[k] = sup / m;
+			rhs[k] = (r - sub * (k > 0 ? rhs[k - 1] : vec3(0, 0, 0))) / m;
+			previousSuper = super[k];
+		}
+		tangents[b] = rhs[count - 1];
+		for (size_t k = count - 1; k-- > 0;) {
+			rhs[k] -= super[k] * rhs[k + 1];
+			tangents[a + k] = rhs[k];
+		}
+	}
+}
+
+namespace SplineTangents {
+
+	void SolveC2(const std::vector<vec3> &points, std::vector<vec3> &tangents, bool clamped, vec3 startTangent, vec3 endTangent)
+	{
+		tangents.resize(points.size());
+		if (points.size() < 2) {
+			std::fill(tangents.begin(), tangents.end(), vec3(0, 0, 0));
+			return;
+		}
+		SolveRange(points, tangents, clamped, startTangent, endTangent, 0, points.size() - 1);
+	}
+
+	void ResolveC2(const std::vector<vec3> &points, std::vector<vec3> &tangents, bool clamped, vec3 startTangent, vec3 endTangent,
+				   size_t point, size_t &first, size_t &end)
+	{
+		size_t n = points.size();
+		if (tangents.size() != n || n < 2) {
+			SolveC2(points, tangents, clamped, startTangent, endTangent);
+			first = 0;
+			end = n;
+			return;
+		}
+		first = point > (size_t)ResolveRadius ? point - ResolveRadius : 0;
+		end = std::min(point + ResolveRadius + 1, n);
+		SolveRange(points, tangents, clamped, startTangent, endTangent, first, end - 1);
+	}
+
+	void KochanekBartels(const std::vector<vec3> &points, std::vector<vec3> &incoming, std::vector<vec3> &outgoing,
+						 float tension, float continuity, float bias, size_t begin, size_t end)
+	{
+		size_t n = points.size();
+		incoming.resize(n);
+		outgoing.resize(n);
+		end = std::min(end, n);
+		if (n < 2) {
+			std::fill(incoming.begin(), incoming.end(), vec3(0, 0, 0));
+			std::fill(outgoing.begin(), outgoing.end(), vec3(0, 0, 0));
+			return;
+		}
+		float s = (1 - tension) * 0.5f;
+		for (size_t i = begin; i < end; ++i) {
+			//The ends repeat their only neighbour difference
+			vec3 before = i > 0 ? points[i] - points[i - 1] : points[1] - points[0];
+			vec3 after = i + 1 < n ? points[i + 1] - points[i] : points[n - 1] - points[n - 2];
+			outgoing[i] = s * ((1 + bias) * (1 + continuity) * before + (1 - bias) * (1 - continuity) * after);
+			incoming[i] = s * ((1 + bias) * (1 - continuity) * before + (1 - bias) * (1 + continuity) * after);
+		}
+	}
+}
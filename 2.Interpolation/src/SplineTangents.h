@@ -0,0 +1,26 @@
+#pragma once
+#include "cinder/Vector.h"
+#include <cstdint>
+#include <vector>
+
+using namespace ci;
+
+//Automatic tangents for hermite segments with one unit of parameter per segment.
+//The C2 spline solves D[i-1] + 4 D[i] + D[i+1] = 3 (P[i+1] - P[i-1]) for all derivatives at once with the Thomas
+//algorithm. Moving one point changes the solution around it by a factor of 2 - sqrt(3) ~ 0.27 less per point, so after
+//an edit only a window of ResolveRadius points on each side is solved again with the tangents outside it held fixed
+namespace SplineTangents {
+
+	const int ResolveRadius = 12;	//0.27^12 ~ 1.5e-7, below float precision relative to the change
+
+	//Natural ends have no curvature, clamped ones take startTangent and endTangent as their derivatives
+	void SolveC2(const std::vector<vec3> &points, std::vector<vec3> &tangents, bool clamped, vec3 startTangent, vec3 endTangent);
+	//Re-solves the window around point after it moved. [first, end) receives the tangents that were rewritten
+	void ResolveC2(const std::vector<vec3> &points, std::vector<vec3> &tangents, bool clamped, vec3 startTangent, vec3 endTangent,
+				   size_t point, size_t &first, size_t &end);
+
+	//Kochanek-Bartels tangents for points [begin, end). A segment leaves point i along outgoing[i] and arrives along
+	//incoming[i], they only differ when continuity is not 0. All zero gives Catmull-Rom
+	void KochanekBartels(const std::vector<vec3> &points, std::vector<vec3> &incoming, std::vector<vec3> &outgoing,
+						 float tension, float continuity, float bias, size_t begin = 0, size_t end = SIZE_MAX);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of worker threads that split index ranges between them.
+//The calling thread works on the range as well, so ThreadPool(1) runs everything inline.
+class ThreadPool {
+public:
+	ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	unsigned Size() const;
+
+	//Calls fn(begin, end) for chunks of at most grain indices out of 0..count and returns once all are done.
+	//Calls from different threads are serialized, fn must not call ParallelFor itself
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+	static ThreadPool& Shared();
+
+private:
+	void Work();
+	void RunChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex submitMutex;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(size_t, size_t)> *job = nullptr;
+	size_t jobCount = 0;
+	size_t jobGrain = 1;
+	std::atomic<size_t> nextChunk;
+	size_t busyWorkers = 0;
+	unsigned generation = 0;
+	bool quit = false;
+};
@@ -0,0 +1,111 @@
+#include "TubeMesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void TubeMesh::Update(const std::vector<vec3> &curve)
+{
+	CurveFrames::RemoveRepeats(curve, nextPoints);
+	if (nextPoints.size() != points.size()) {
+		points.swap(nextPoints);
+		Rebuild();
+		return;
+	}
+
+	size_t n = points.size();
+	size_t first = 0;
+	while (first < n && nextPoints[first] == points[first])
+		++first;
+	ringsRebuilt = 0;
+	if (first == n)
+		return;
+	size_t last = n - 1;
+	while (nextPoints[last] == points[last])
+		--last;
+	std::copy(nextPoints.begin() + first, nextPoints.begin() + last + 1, points.begin() + first);
+
+	//A moved point turns the tangents of its neighbours, the frames follow from the first of them
+	size_t begin = first > 0 ? first - 1 : 0;
+	size_t settleFrom = std::min(last + 2, n);
+	CurveFrames::Tangents(points, tangents, begin, settleFrom);
+	size_t end = CurveFrames::RotationMinimizing(points, tangents, frames, begin, settleFrom);
+	for (size_t i = begin; i < end; ++i)
+		WriteRing(i);
+	ringsRebuilt = end - begin;
+	dirtyBegin = std::min(dirtyBegin, begin * RingSize());
+	dirtyEnd = std::max(dirtyEnd, end * RingSize());
+}
+
+void TubeMesh::Rebuild()
+{
+	size_t n = points.size();
+	CurveFrames::Tangents(points, tangents);
+	CurveFrames::RotationMinimizing(points, tangents, frames);
+	vertices.resize(n * RingSize());
+	for (size_t i = 0; i < n; ++i)
+		WriteRing(i);
+
+	indices.clear();
+	int ringSize = RingSize();
+	for (size_t i = 0; i + 1 < n; ++i) {
+		uint32_t ring = (uint32_t)(i * ringSize), next = ring + ringSize;
+		for (int s = 0; s + 1 < ringSize; ++s) {
+			uint32_t quad[6] = { ring + s, next + s, ring + s + 1, ring + s + 1, next + s, next + s + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	ringsRebuilt = n;
+	dirtyBegin = 0;
+	dirtyEnd = vertices.size();
+	topologyChanged = true;
+}
+
+void TubeMesh::WriteRing(size_t i)
+{
+	const CurveFrame &frame = frames[i];
+	Vertex *ring = &vertices[i * RingSize()];
+	//The texture runs along the samples, not the arc length, so an edit does not shift it on the rest of the curve
+	float v = i * 0.1f;
+	if (shape == Ribbon) {
+		ring[0] = { points[i] - frame.binormal * radius, frame.normal, vec2(0, v) };
+		ring[1] = { points[i] + frame.binormal * radius, frame.normal, vec2(1, v) };
+		return;
+	}
+	for (int s = 0; s <= sides; ++s) {
+		float angle = 2 * (float)M_PI * s / sides;
+		vec3 normal = std::cos(angle) * frame.normal + std::sin(angle) * frame.binormal;
+		ring[s] = { points[i] + normal * radius, normal, vec2(s / (float)sides, v) };
+	}
+}
+
+//A long helix, once extruded in full and then edited in two ways
+TubeMesh::BenchmarkResult TubeMesh::Benchmark(size_t sampleCount)
+{
+	std::vector<vec3> curve(sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i) {
+		float t = i * 0.01f;
+		curve[i] = vec3(std::cos(t), std::sin(t), t * 0.05f);
+	}
+
+	typedef std::chrono::high_resolution_clock clock;
+	BenchmarkResult result;
+	result.samples = sampleCount;
+	TubeMesh tube;
+	auto start = clock::now();
+	tube.Update(curve);
+	result.fullMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	//Sliding a sample along the helix axis barely turns the tangents around it, the frames settle right after it
+	curve[sampleCount / 2] += vec3(0, 0, 1e-4f);
+	start = clock::now();
+	tube.Update(curve);
+	result.editMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	result.editRings = tube.ringsRebuilt;
+
+	curve[sampleCount / 10] += vec3(0.5f, 0, 0);
+	start = clock::now();
+	tube.Update(curve);
+	result.bendMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	result.bendRings = tube.ringsRebuilt;
+	return result;
+}
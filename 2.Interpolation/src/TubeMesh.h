@@ -0,0 +1,65 @@
+#pragma once
+#include "cinder/gl/gl.h"
+#include "CurveFrames.h"
+#include <vector>
+
+using namespace ci;
+
+//Extrudes a tube or a flat ribbon along a curve, oriented by rotation minimizing frames.
+//The vertices are kept interleaved in the layout the VBO uses. Update() compares the curve with the last one and rewrites
+//only the rings of the samples that moved and of the frames that changed with them, draw() uploads just that range.
+//A bend still turns the frames of everything after it, but an edit that leaves the frames alone stays local
+class TubeMesh {
+public:
+	enum Shape { Tube, Ribbon };
+
+	struct Vertex {
+		vec3 position;
+		vec3 normal;
+		vec2 texCoord;
+	};
+
+	struct BenchmarkResult {
+		size_t samples;
+		double fullMs;			//Frames and extrusion of the whole curve
+		double editMs;			//After moving one sample, the frames there stay the same
+		size_t editRings;
+		double bendMs;			//After bending the curve near its start
+		size_t bendRings;
+	};
+
+	TubeMesh(Shape shape = Tube, int sides = 8, float radius = 0.05f) : shape(shape), sides(sides), radius(radius) {}
+
+	void Update(const std::vector<vec3> &curve);
+	void draw();
+
+	const std::vector<Vertex>& Vertices() const { return vertices; }
+	const std::vector<uint32_t>& Indices() const { return indices; }
+	const std::vector<CurveFrame>& Frames() const { return frames; }
+	size_t ringsRebuilt = 0;		//By the last Update
+
+	static BenchmarkResult Benchmark(size_t sampleCount = 100000);
+
+private:
+	int RingSize() const { return shape == Tube ? sides + 1 : 2; }
+	void WriteRing(size_t i);
+	void Rebuild();
+
+	Shape shape;
+	int sides;
+	float radius;
+
+	std::vector<vec3> points;			//The curve without repeats
+	std::vector<vec3> nextPoints;
+	std::vector<vec3> tangents;
+	std::vector<CurveFrame> frames;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	size_t dirtyBegin = 0;				//Vertices not uploaded yet
+	size_t dirtyEnd = 0;
+	bool topologyChanged = true;
+
+	gl::VboRef vertexVboRef;
+	gl::VboRef indexVboRef;
+	gl::BatchRef batchRef;
+};
@@ -0,0 +1,26 @@
+#include "TubeMesh.h"
+#include <cstddef>
+
+void TubeMesh::draw()
+{
+	if (indices.empty())
+		return;
+	if (topologyChanged) {
+		vertexVboRef = gl::Vbo::create(GL_ARRAY_BUFFER, vertices, GL_DYNAMIC_DRAW);
+		indexVboRef = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, indices, GL_STATIC_DRAW);
+		geom::BufferLayout layout;
+		layout.append(geom::Attrib::POSITION, 3, sizeof(Vertex), offsetof(Vertex, position));
+		layout.append(geom::Attrib::NORMAL, 3, sizeof(Vertex), offsetof(Vertex, normal));
+		layout.append(geom::Attrib::TEX_COORD_0, 2, sizeof(Vertex), offsetof(Vertex, texCoord));
+		auto mesh = gl::VboMesh::create((uint32_t)vertices.size(), GL_TRIANGLES, { { layout, vertexVboRef } },
+										(uint32_t)indices.size(), GL_UNSIGNED_INT, indexVboRef);
+		batchRef = gl::Batch::create(mesh, gl::getStockShader(gl::ShaderDef().lambert().color()));
+		topologyChanged = false;
+	}
+	else if (dirtyBegin < dirtyEnd) {
+		vertexVboRef->bufferSubData(dirtyBegin * sizeof(Vertex), (dirtyEnd - dirtyBegin) * sizeof(Vertex), &vertices[dirtyBegin]);
+	}
+	dirtyBegin = SIZE_MAX;
+	dirtyEnd = 0;
+	batchRef->draw();
+}
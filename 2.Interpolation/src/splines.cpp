@@ -1,27 +1,26 @@
 #include "splines.h"
 #include "cinder/PolyLine.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstddef>
+#include <random>
 
 
 std::vector<vec3> PointInterp::GetInterpolatedLine(float interval)
 {
 	// This function receives an interval at which the function should be sampled.
-	std::vector<vec3> interpList; //The vector with the interpolated positions
-    
-    for (int i = 0; i < points.size() - 1; i++){
-        RedefinedPoint P0 = points.at(i);
-        RedefinedPoint P1 = points.at(i + 1);
-                
-        for (float u = 0; u < 1; u = u + interval) {
-            vec3 interpolatedPos = (1 - u) * P0.pos + u * P1.pos;
-            interpList.push_back(interpolatedPos);
-        }
-        
-        interpList.push_back(P1.pos);
-        
-    }
+	return Tessellate(interval, false, [this](size_t i, const std::vector<float> &parameters, vec3 *out) {
+		const RedefinedPoint &P0 = points[i];
+		const RedefinedPoint &P1 = points[i + 1];
 
-    
-	return interpList; //A copy of the vector is returned
+		for (float u : parameters) {
+			vec3 interpolatedPos = (1 - u) * P0.pos + u * P1.pos;
+			*out++ = interpolatedPos;
+		}
+
+		*out = P1.pos;
+	});
 }
 
 std::vector<vec3> PointInterp::GetHermiteSpline(float interval)
@@ -32,34 +31,28 @@ std::vector<vec3> PointInterp::GetHermiteSpline(float interval)
 	The hermite spline needs a tangent which is already part of the "Point" class (see the Point class in splines.h) as the member variable hermiteTangent.
 	This problem can be solved with around 15 lines of (compact) code.
 	*/
-	std::vector<vec3> interpList;  //The vector you should fill with the interpolated positions
-								   // Your code
-    
-    for (int i = 0; i < points.size() - 1; i++){
-        RedefinedPoint P0 = points.at(i);
-        RedefinedPoint P1 = points.at(i + 1);
-    
-        for (float u = 0; u <= 1; u = u + interval) {
-            float u3 = u * u * u;
-            float u2 = u * u;
-            
-            float eq1 = 2 * u3 - 3 * u2 + 1;
-            float eq2 = -2 * u3 + 3 * u2;
-            float eq3 = u3 - 2 * u2 + u;
-            float eq4 = u3 - u2;
-            
-            float x = eq1 * P0.pos.x + eq2 * P1.pos.x + eq3 * P0.hermiteTangent.x + eq4 * P1.hermiteTangent.x ;
-            float y = eq1 * P0.pos.y + eq2 * P1.pos.y + eq3 * P0.hermiteTangent.y + eq4 * P1.hermiteTangent.y ;
-            float z = eq1 * P0.pos.z + eq2 * P1.pos.z + eq3 * P0.hermiteTangent.z + eq4 * P1.hermiteTangent.z ;
-            
-            interpList.push_back(vec3(x, y, z));
-        }
-        
-        interpList.push_back(P1.pos);
-    }
-    
-    
-	return interpList; //Returns a copy of the vector
+	return Tessellate(interval, true, [this](size_t i, const std::vector<float> &parameters, vec3 *out) {
+		const RedefinedPoint &P0 = points[i];
+		const RedefinedPoint &P1 = points[i + 1];
+
+		for (float u : parameters) {
+			float u3 = u * u * u;
+			float u2 = u * u;
+
+			float eq1 = 2 * u3 - 3 * u2 + 1;
+			float eq2 = -2 * u3 + 3 * u2;
+			float eq3 = u3 - 2 * u2 + u;
+			float eq4 = u3 - u2;
+
+			float x = eq1 * P0.pos.x + eq2 * P1.pos.x + eq3 * P0.hermiteTangent.x + eq4 * P1.hermiteTangent.x ;
+			float y = eq1 * P0.pos.y + eq2 * P1.pos.y + eq3 * P0.hermiteTangent.y + eq4 * P1.hermiteTangent.y ;
+			float z = eq1 * P0.pos.z + eq2 * P1.pos.z + eq3 * P0.hermiteTangent.z + eq4 * P1.hermiteTangent.z ;
+
+			*out++ = vec3(x, y, z);
+		}
+
+		*out = P1.pos;
+	});
 }
 
 std::vector<vec3> PointInterp::GetParabolaInterpSpline(float interval)
@@ -68,50 +61,31 @@ std::vector<vec3> PointInterp::GetParabolaInterpSpline(float interval)
 	//todo TASK3 - begin
 	/* As in the previous Task, except you should implement Parabola interpolation. See the Book on how to implement this.
 	*/
-	std::vector<vec3> list;
-    
-    for (int i = 0; i < points.size() - 1; i++){
-        RedefinedPoint P0;
-        RedefinedPoint P1 = points.at(i);
-        RedefinedPoint P2 = points.at(i + 1);
-        RedefinedPoint P3;
-        
-        if (i == 0)
-            P0 = points.at(i);
-        else
-            P0 = points.at(i - 1);
-        
-        if (i == points.size() - 2)
-            P3 = points.at(i + 1);
-        else
-            P3 = points.at(i + 2);
-        
-    
-       
-        for (float u = 0; u <= 1; u = u + interval) {
-            float u3 = u * u * u;
-            float u2 = u * u;
-
-            float eq1 = 0.5 * (-1 * u3 + 2 * u2 - u);
-            float eq2 = 0.5 * (3 * u3 - 5 * u2 + 2);
-            float eq3 = 0.5 * (-3 * u3 + 4 * u2 + u);
-            float eq4 = 0.5 * (u3 - u2);
-
-            float x = eq1 * P0.pos.x + eq2 * P1.pos.x + eq3 * P2.pos.x + eq4 * P3.pos.x ;
-            float y = eq1 * P0.pos.y + eq2 * P1.pos.y + eq3 * P2.pos.y + eq4 * P3.pos.y ;
-            float z = eq1 * P0.pos.z + eq2 * P1.pos.z + eq3 * P2.pos.z + eq4 * P3.pos.z ;
-
-            list.push_back(vec3(x, y, z));
-            
-        }
-           
-        list.push_back(P2.pos);
-            
-    }
-        
-	// Your code
-	return list; //Returns a copy of the vector
-				 //todo TASK3 - end
+	return Tessellate(interval, true, [this](size_t i, const std::vector<float> &parameters, vec3 *out) {
+		const RedefinedPoint &P0 = points[i == 0 ? i : i - 1];
+		const RedefinedPoint &P1 = points[i];
+		const RedefinedPoint &P2 = points[i + 1];
+		const RedefinedPoint &P3 = points[i == points.size() - 2 ? i + 1 : i + 2];
+
+		for (float u : parameters) {
+			float u3 = u * u * u;
+			float u2 = u * u;
+
+			float eq1 = 0.5 * (-1 * u3 + 2 * u2 - u);
+			float eq2 = 0.5 * (3 * u3 - 5 * u2 + 2);
+			float eq3 = 0.5 * (-3 * u3 + 4 * u2 + u);
+			float eq4 = 0.5 * (u3 - u2);
+
+			float x = eq1 * P0.pos.x + eq2 * P1.pos.x + eq3 * P2.pos.x + eq4 * P3.pos.x ;
+			float y = eq1 * P0.pos.y + eq2 * P1.pos.y + eq3 * P2.pos.y + eq4 * P3.pos.y ;
+			float z = eq1 * P0.pos.z + eq2 * P1.pos.z + eq3 * P2.pos.z + eq4 * P3.pos.z ;
+
+			*out++ = vec3(x, y, z);
+		}
+
+		*out = P2.pos;
+	});
+	//todo TASK3 - end
 }
 
 std::vector<vec3> PointInterp::GetBezierInterpSpline(float interval)
@@ -120,39 +94,222 @@ std::vector<vec3> PointInterp::GetBezierInterpSpline(float interval)
 	TASK4 - begin
 	Finally implement Bezier interpolation. The "Point" class has member variables bezierTangentF and bezierTangentB
 	*/
-	std::vector<vec3> interpList; //The std::vector holding the interpolated positions
-								  // Your code
-    
-    for (int i = 0; i < points.size() - 1; i++){
-        vec3 P0 = points.at(i).pos;
-        vec3 P1 = points.at(i).pos + points.at(i).bezierTangentF;
-        vec3 P2 = points.at(i + 1).pos + points.at(i + 1).bezierTangentB;
-        vec3 P3 = points.at(i + 1).pos;
-       
-        for (float u = 0; u <= 1; u = u + interval) {
-            float u3 = u * u * u;
-            float u2 = u * u;
-
-            float eq1 = -u3 + 3 * u2 - 3 * u + 1;
-            float eq2 = 3 * u3 - 6 * u2 + 3 * u;
-            float eq3 = -3 * u3 + 3 * u2;
-            float eq4 = u3;
-
-            float x = eq1 * P0.x + eq2 * P1.x + eq3 * P2.x + eq4 * P3.x ;
-            float y = eq1 * P0.y + eq2 * P1.y + eq3 * P2.y + eq4 * P3.y ;
-            float z = eq1 * P0.z + eq2 * P1.z + eq3 * P2.z + eq4 * P3.z ;
-
-            interpList.push_back(vec3(x, y, z));
-            
-        }
-           
-        interpList.push_back(P3);
-            
-    }
-    
+	return Tessellate(interval, true, [this](size_t i, const std::vector<float> &parameters, vec3 *out) {
+		vec3 P0 = points[i].pos;
+		vec3 P1 = points[i].pos + points[i].bezierTangentF;
+		vec3 P2 = points[i + 1].pos + points[i + 1].bezierTangentB;
+		vec3 P3 = points[i + 1].pos;
+
+		for (float u : parameters) {
+			float u3 = u * u * u;
+			float u2 = u * u;
+
+			float eq1 = -u3 + 3 * u2 - 3 * u + 1;
+			float eq2 = 3 * u3 - 6 * u2 + 3 * u;
+			float eq3 = -3 * u3 + 3 * u2;
+			float eq4 = u3;
+
+			float x = eq1 * P0.x + eq2 * P1.x + eq3 * P2.x + eq4 * P3.x ;
+			float y = eq1 * P0.y + eq2 * P1.y + eq3 * P2.y + eq4 * P3.y ;
+			float z = eq1 * P0.z + eq2 * P1.z + eq3 * P2.z + eq4 * P3.z ;
+
+			*out++ = vec3(x, y, z);
+		}
+
+		*out = P3;
+	});
+}
+
+std::vector<vec3> PointInterp::GetAutoTangentSpline(float interval)
+{
+	UpdateAutoTangents();
+	return Tessellate(interval, true, [this](size_t i, const std::vector<float> &parameters, vec3 *out) {
+		vec3 P0 = points[i].pos;
+		vec3 P1 = points[i + 1].pos;
+		vec3 T0 = outgoingTangents[i];
+		vec3 T1 = incomingTangents[i + 1];
+
+		for (float u : parameters) {
+			float u3 = u * u * u;
+			float u2 = u * u;
+
+			float eq1 = 2 * u3 - 3 * u2 + 1;
+			float eq2 = -2 * u3 + 3 * u2;
+			float eq3 = u3 - 2 * u2 + u;
+			float eq4 = u3 - u2;
+
+			*out++ = eq1 * P0 + eq2 * P1 + eq3 * T0 + eq4 * T1;
+		}
+
+		*out = P1;
+	});
+}
+
+//Solves all tangents when the points or settings changed, otherwise only around the points that moved
+void PointInterp::UpdateAutoTangents()
+{
+	if (currentInterpMode != cubic && currentInterpMode != kochanek) {
+		//Edits in other modes are not tracked, switching back solves everything
+		tangentState.mode = currentInterpMode;
+		tangentChanges.clear();
+		return;
+	}
+	vec3 startTangent = points.empty() ? vec3(0, 0, 0) : points.front().hermiteTangent;
+	vec3 endTangent = points.empty() ? vec3(0, 0, 0) : points.back().hermiteTangent;
+
+	TangentState state = { points.size(), currentInterpMode, clampedEnds, startTangent, endTangent, kbTension, kbContinuity, kbBias };
+	if (state != tangentState) {
+		positions.resize(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+			positions[i] = points[i].pos;
+		if (currentInterpMode == cubic) {
+			SplineTangents::SolveC2(positions, outgoingTangents, clampedEnds, startTangent, endTangent);
+			incomingTangents = outgoingTangents;
+		}
+		else
+			SplineTangents::KochanekBartels(positions, incomingTangents, outgoingTangents, kbTension, kbContinuity, kbBias);
+		tangentState = state;
+		++curveGeneration;
+		tangentChanges.clear();
+		return;
+	}
+
+	for (int point : tangentChanges) {
+		if (point < 0 || point >= (int)points.size())
+			continue;
+		positions[point] = points[point].pos;
+		size_t first, end;
+		if (currentInterpMode == cubic) {
+			SplineTangents::ResolveC2(positions, outgoingTangents, clampedEnds, startTangent, endTangent, point, first, end);
+			std::copy(outgoingTangents.begin() + first, outgoingTangents.begin() + end, incomingTangents.begin() + first);
+		}
+		else
+			SplineTangents::KochanekBartels(positions, incomingTangents, outgoingTangents, kbTension, kbContinuity, kbBias,
+											point > 0 ? point - 1 : 0, point + 2);
+	}
+	tangentChanges.clear();
+}
+
+//B-spline and NURBS modes: the curve is kept between calls and an edit only evaluates the spans of the moved points again
+std::vector<vec3> PointInterp::GetNurbsSpline(float interval)
+{
+	UpdateNurbsControls();
+	if (nurbsSamplesGeneration != curveGeneration || nurbsSamplesInterval != interval) {
+		nurbsTessellation.Tessellate(SampleParameters(interval, false), tessellationPool ? *tessellationPool : ThreadPool::Shared(),
+						 TessellationGrain);
+		nurbsSamplesGeneration = curveGeneration;
+		nurbsSamplesInterval = interval;
+		spansRetessellated = nurbsTessellation.Curve().SpanCount();
+	}
+	else
+		spansRetessellated = nurbsTessellation.Retessellate();
+	return nurbsTessellation.Samples();
+}
+
+vec4 PointInterp::NurbsControl(size_t i) const
+{
+	float weight = currentInterpMode == nurbs ? points[i].weight : 1.f;
+	return vec4(points[i].pos * weight, weight);
+}
+
+//Rebuilds knots and controls when the points, mode or degree changed, otherwise only the controls of the points that moved
+void PointInterp::UpdateNurbsControls()
+{
+	if (currentInterpMode != bspline && currentInterpMode != nurbs) {
+		//Edits in other modes are not tracked, switching back rebuilds everything
+		nurbsState.mode = currentInterpMode;
+		nurbsChanges.clear();
+		return;
+	}
+	int degree = std::max(1, std::min({ splineDegree, (int)points.size() - 1, NurbsCurve::MaxDegree }));
+	NurbsState state = { points.size(), currentInterpMode, degree };
+	if (state != nurbsState) {
+		std::vector<vec4> controls(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+			controls[i] = NurbsControl(i);
+		nurbsTessellation.SetControls(controls, degree);
+		nurbsState = state;
+		++curveGeneration;
+		nurbsChanges.clear();
+		return;
+	}
+
+	for (int point : nurbsChanges)
+		if (point >= 0 && point < (int)points.size())
+			nurbsTessellation.MoveControl(point, NurbsControl(point));
+	nurbsChanges.clear();
+}
+
+//The same float accumulation as a single loop over u, so the samples do not depend on the thread count
+std::vector<float> PointInterp::SampleParameters(float interval, bool includeOne)
+{
+	std::vector<float> parameters;
+	for (float u = 0; includeOne ? u <= 1 : u < 1; u = u + interval)
+		parameters.push_back(u);
+	return parameters;
+}
+
+//Every segment writes its samples followed by its end point. The samples are the same for all segments, so the offset of a
+//segment is the prefix sum of the counts before it and the threads write into the one output vector without locking
+std::vector<vec3> PointInterp::Tessellate(float interval, bool includeOne, const SegmentFn &segment, size_t segmentCount)
+{
+	if (points.size() < 2)
+		return std::vector<vec3>();
+
+	std::vector<float> parameters = SampleParameters(interval, includeOne);
+	if (segmentCount == SIZE_MAX)
+		segmentCount = points.size() - 1;
+	std::vector<size_t> offsets(segmentCount + 1, 0);
+	for (size_t i = 0; i < segmentCount; ++i)
+		offsets[i + 1] = offsets[i] + parameters.size() + 1;
+
+	std::vector<vec3> interpList(offsets.back());
+	ThreadPool &pool = tessellationPool ? *tessellationPool : ThreadPool::Shared();
+	pool.ParallelFor(segmentCount, TessellationGrain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			segment(i, parameters, &interpList[offsets[i]]);
+	});
 	return interpList;
 }
 
+//Tessellates a bezier curve through segmentCount random segments with 1 up to all hardware threads
+std::vector<PointInterp::BenchmarkResult> PointInterp::BenchmarkTessellation(size_t segmentCount, float interval)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> box(-10.f, 10.f);
+	PointInterp spline;
+	spline.points.resize(segmentCount + 1);
+	for (auto &point : spline.points)
+		point.pos = vec3(box(rng), box(rng), box(rng));
+	spline.currentInterpMode = bezier;
+
+	typedef std::chrono::high_resolution_clock clock;
+	std::vector<BenchmarkResult> results;
+	std::vector<vec3> reference;
+	unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+		ThreadPool pool(threads);
+		spline.tessellationPool = &pool;
+		BenchmarkResult result;
+		result.threads = threads;
+		result.segmentCount = segmentCount;
+		result.ms = DBL_MAX;
+		std::vector<vec3> curve;
+		//Best of three, the first run also pays for faulting in the output
+		for (int run = 0; run < 3; ++run) {
+			auto start = clock::now();
+			curve = spline.GetActiveSpline(interval);
+			result.ms = std::min(result.ms, std::chrono::duration<double, std::milli>(clock::now() - start).count());
+		}
+		result.vertexCount = curve.size();
+		if (threads == 1)
+			reference.swap(curve);
+		result.matchesSingleThread = threads == 1 || curve == reference;
+		results.push_back(result);
+	}
+	return results;
+}
+
 glm::mat4 PointInterp::ConstructHermiteB(Point p1, Point p2)
 {
 	//todo TASK2 Optional, you may or may not create and use this function
@@ -178,61 +335,169 @@ void PointInterp::draw()
 {
 	if (points.size() <= 0) return;
 
-	gl::pushModelMatrix();
-
-	auto deltaPositions = getDeltaPositions();
-
-	for (size_t i = 0; i < points.size(); ++i) {
-		gl::translate(deltaPositions[i]);
-		if (i == activePoint)
-			DrawHandles();
-		else
-			gl::color(Color(1, 0, 0));
-		points[i].batchRef->draw();
+	markers.Update(points, activePoint);
+	markers.draw();
+	handleLines.Clear();
+	if (activePoint >= 0 && activePoint < points.size())
+		DrawHandles();
+	handleLines.draw();
+	std::vector<vec3> curve = GetActiveSpline(0.1f);
+	curveLine.Update(curve);
+	curveLine.draw(curveThickness, Color(1, 1, 1));
+	if (showTube) {
+		tube.Update(curve);
+		gl::color(Color(0.8f, 0.8f, 0.8f));
+		tube.draw();
+	}
+	if (curveHovered) {
+		gl::color(Color(1, 1, 0));
+		gl::drawSphere(curveHoverPos, 0.05f);
 	}
-	gl::popModelMatrix();
-	gl::color(Color(1, 1, 1));
-	std::vector<vec3> interpList = GetActiveSpline(0.1f);
-	gl::draw(interpList);
 	
 }
 
+//Adds the gizmos of the active point to handleLines, they are drawn together afterwards
 void PointInterp::DrawHandles()
 {
-	gl::color(Color(1, 0, 0));
-	gl::drawVector(vec3(0, 0, 0), vec3(1, 0, 0));
-	gl::color(Color(0, 1, 0));
-	gl::drawVector(vec3(0, 0, 0), vec3(0, 1, 0));
-	gl::color(Color(0, 0, 1));
-	gl::drawVector(vec3(0, 0, 0), vec3(0, 0, 1));
+	vec3 origin = points[activePoint].pos;
+	handleLines.Arrow(origin, origin + vec3(1, 0, 0), Color(1, 0, 0));
+	handleLines.Arrow(origin, origin + vec3(0, 1, 0), Color(0, 1, 0));
+	handleLines.Arrow(origin, origin + vec3(0, 0, 1), Color(0, 0, 1));
 	//Draw the Handles for certain Modes
 	if (currentInterpMode == hermite)
 	{
-		gl::drawLine(vec3(0,0,0),points[activePoint].hermiteTangent);
-		gl::pushModelMatrix();
-		gl::translate(points[activePoint].hermiteTangent);
-		gl::drawStrokedCube(ci::AxisAlignedBox(vec3(-0.1, -0.1, -0.1), vec3(0.1, 0.1, 0.1)));
-		gl::popModelMatrix();
+		vec3 tangent = origin + points[activePoint].hermiteTangent;
+		handleLines.Line(origin, tangent, Color(0, 0, 1));
+		handleLines.StrokedCube(tangent, 0.1f, Color(0, 0, 1));
 	}
 	else if (currentInterpMode == bezier)
 	{
 		if (activePoint != points.size() - 1) {
-			gl::color(Color(1, 0, 0));
-			gl::drawLine(vec3(0, 0, 0), points[activePoint].bezierTangentF);
-			gl::pushModelMatrix();
-			gl::translate(points[activePoint].bezierTangentF);
-			gl::drawStrokedCube(ci::AxisAlignedBox(vec3(-0.1, -0.1, -0.1), vec3(0.1, 0.1, 0.1)));
-			gl::popModelMatrix();
+			vec3 forward = origin + points[activePoint].bezierTangentF;
+			handleLines.Line(origin, forward, Color(1, 0, 0));
+			handleLines.StrokedCube(forward, 0.1f, Color(1, 0, 0));
 		}
 		if (activePoint != 0) {
-			gl::color(Color(0, 1, 0));
-			gl::drawLine(vec3(0, 0, 0), points[activePoint].bezierTangentB);
-			gl::pushModelMatrix();
-			gl::translate(points[activePoint].bezierTangentB);
-			gl::drawStrokedCube(ci::AxisAlignedBox(vec3(-0.1, -0.1, -0.1), vec3(0.1, 0.1, 0.1)));
-			gl::popModelMatrix();
+			vec3 backward = origin + points[activePoint].bezierTangentB;
+			handleLines.Line(origin, backward, Color(0, 1, 0));
+			handleLines.StrokedCube(backward, 0.1f, Color(0, 1, 0));
+		}
+	}
+}
+
+void PointMarkers::Update(const std::vector<RedefinedPoint> &points, int activePoint)
+{
+	if (points.size() > instances.size())
+		Allocate(std::max(points.size(), instances.size() * 2));
+	count = points.size();
+
+	size_t first = SIZE_MAX, last = 0;
+	for (size_t i = 0; i < count; ++i) {
+		Instance instance = { points[i].pos, (int)i == activePoint ? vec3(0, 0, 1) : vec3(1, 0, 0) };
+		if (instance != instances[i]) {
+			instances[i] = instance;
+			first = std::min(first, i);
+			last = i;
+		}
+	}
+	instancesUploaded = 0;
+	if (first != SIZE_MAX) {
+		instancesUploaded = (int)(last - first + 1);
+		instanceVboRef->bufferSubData(first * sizeof(Instance), instancesUploaded * sizeof(Instance), &instances[first]);
+	}
+}
+
+void PointMarkers::draw()
+{
+	if (count > 0)
+		batchRef->drawInstanced((GLsizei)count);
+}
+
+//A new buffer of capacity instances, everything is uploaded again by the next Update
+void PointMarkers::Allocate(size_t capacity)
+{
+	static gl::GlslProgRef progRef = gl::GlslProg::create(CI_GLSL(150,
+		uniform mat4	ciModelViewProjection;
+		in vec4			ciPosition;
+		in vec3			instancePosition;
+		in vec3			instanceColor;
+		out vec3		color;
+
+		void main(void) {
+			color = instanceColor;
+			gl_Position = ciModelViewProjection * (ciPosition + vec4(instancePosition, 0));
 		}
+	), CI_GLSL(150,
+		in vec3			color;
+		out vec4		oColor;
+
+		void main(void) {
+			oColor = vec4(color, 1);
+		}
+	));
+
+	instances.assign(capacity, { vec3(FLT_MAX, FLT_MAX, FLT_MAX), vec3(0, 0, 0) });
+	instanceVboRef = gl::Vbo::create(GL_ARRAY_BUFFER, capacity * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+	geom::BufferLayout layout;
+	layout.append(geom::Attrib::CUSTOM_0, 3, sizeof(Instance), offsetof(Instance, pos), 1);
+	layout.append(geom::Attrib::CUSTOM_1, 3, sizeof(Instance), offsetof(Instance, color), 1);
+	auto sphere = gl::VboMesh::create(geom::Sphere().subdivisions(10).radius(0.1f));
+	sphere->appendVbo(layout, instanceVboRef);
+	batchRef = gl::Batch::create(sphere, progRef, { { geom::Attrib::CUSTOM_0, "instancePosition" }, { geom::Attrib::CUSTOM_1, "instanceColor" } });
+}
+
+void HandleLines::Line(vec3 a, vec3 b, Color color)
+{
+	vertices.push_back({ a, color });
+	vertices.push_back({ b, color });
+}
+
+//A line with four strokes for the head, stands in for gl::drawVector
+void HandleLines::Arrow(vec3 from, vec3 to, Color color)
+{
+	Line(from, to, color);
+	vec3 dir = normalize(to - from);
+	vec3 side = normalize(cross(dir, std::abs(dir.y) < 0.9f ? vec3(0, 1, 0) : vec3(1, 0, 0))) * 0.05f;
+	vec3 up = cross(dir, side);
+	vec3 base = to - dir * 0.15f;
+	Line(to, base + side, color);
+	Line(to, base - side, color);
+	Line(to, base + up, color);
+	Line(to, base - up, color);
+}
+
+void HandleLines::StrokedCube(vec3 center, float halfSize, Color color)
+{
+	vec3 corner[8];
+	for (int c = 0; c < 8; ++c)
+		corner[c] = center + halfSize * vec3(c & 1 ? 1 : -1, c & 2 ? 1 : -1, c & 4 ? 1 : -1);
+	//Corners that differ in exactly one bit share an edge
+	for (int c = 0; c < 8; ++c)
+		for (int bit = 1; bit < 8; bit <<= 1)
+			if (!(c & bit))
+				Line(corner[c], corner[c | bit], color);
+}
+
+void HandleLines::draw()
+{
+	if (vertices.empty())
+		return;
+	if (vertices.size() > capacity) {
+		capacity = std::max(vertices.size(), capacity * 2);
+		vboRef = gl::Vbo::create(GL_ARRAY_BUFFER, capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+		geom::BufferLayout layout;
+		layout.append(geom::Attrib::POSITION, 3, sizeof(Vertex), offsetof(Vertex, pos));
+		layout.append(geom::Attrib::COLOR, 3, sizeof(Vertex), offsetof(Vertex, color));
+		auto mesh = gl::VboMesh::create((uint32_t)capacity, GL_LINES, { { layout, vboRef } });
+		batchRef = gl::Batch::create(mesh, gl::getStockShader(gl::ShaderDef().color()));
+		uploaded.clear();
+	}
+	if (vertices.size() != uploaded.size() || !std::equal(vertices.begin(), vertices.end(), uploaded.begin(),
+														   [](const Vertex &a, const Vertex &b) { return !(a != b); })) {
+		vboRef->bufferSubData(0, vertices.size() * sizeof(Vertex), vertices.data());
+		uploaded = vertices;
 	}
+	batchRef->draw(0, (GLsizei)vertices.size());
 }
 
 void PointInterp::MouseDown(MouseEvent event, CameraPersp cam)
@@ -317,21 +582,153 @@ void PointInterp::MouseDrag(MouseEvent event,CameraPersp cam)
 
 	if (activeXYZHandle != -1) {
 		UpdatePoint(camRay);
+		PointChanged(activePoint);
 	}
 	if (activeTangentHandle != -1)
 	{
 		UpdateTangent(camRay, cam);
+		PointChanged(activePoint);
+	}
+}
+
+//Marks the point of the curve under the cursor
+void PointInterp::MouseMove(MouseEvent event, CameraPersp cam)
+{
+	vec2 mousePos = event.getPos();
+	float u = mousePos.x / (float)getWindowWidth();
+	float v = mousePos.y / (float)getWindowHeight();
+	Ray camRay = cam.generateRay(u, 1.f - v, cam.getAspectRatio());
+
+	SegmentBVH::Hit hit;
+	curveHovered = PickCurve(camRay, 0.1f, hit);
+	curveHoverPos = hit.point;
+}
+
+size_t PointInterp::SegmentCount() const
+{
+	if (currentInterpMode == bspline || currentInterpMode == nurbs)
+		return nurbsTessellation.Curve().SpanCount();
+	return points.size() < 2 ? 0 : points.size() - 1;
+}
+
+SegmentBVH::Bezier PointInterp::SegmentBezier(size_t i) const
+{
+	vec3 p0 = points[i].pos, p3 = points[i + 1].pos;
+	switch (currentInterpMode)
+	{
+	case(hermite):
+		return { { p0, p0 + points[i].hermiteTangent / 3.f, p3 - points[i + 1].hermiteTangent / 3.f, p3 } };
+	case(parabol):
+	{
+		//Catmull-Rom, the tangents are half the difference of the neighbours
+		vec3 before = points[i == 0 ? i : i - 1].pos;
+		vec3 after = points[i == points.size() - 2 ? i + 1 : i + 2].pos;
+		return { { p0, p0 + (p3 - before) / 6.f, p3 - (after - p0) / 6.f, p3 } };
+	}
+	case(bezier):
+		return { { p0, p0 + points[i].bezierTangentF, p3 + points[i + 1].bezierTangentB, p3 } };
+	case(cubic):
+	case(kochanek):
+		return { { p0, p0 + outgoingTangents[i] / 3.f, p3 - incomingTangents[i + 1] / 3.f, p3 } };
+	default:
+		return { { p0, p0 + (p3 - p0) / 3.f, p0 + (p3 - p0) * (2.f / 3.f), p3 } };
+	}
+}
+
+//The weights are kept positive, so a rational span stays inside the hull of its projected control points as well
+SegmentBVH::Box PointInterp::SpanHull(size_t span) const
+{
+	SegmentBVH::Box hull;
+	for (int j = 0; j <= nurbsTessellation.Curve().Degree(); ++j) {
+		const vec4 &control = nurbsTessellation.Controls()[span + j];
+		hull.Add(vec3(control) / control.w);
+	}
+	return hull;
+}
+
+void PointInterp::UpdateCurveBVH()
+{
+	UpdateAutoTangents();
+	UpdateNurbsControls();
+	size_t segmentCount = SegmentCount();
+	bool spans = currentInterpMode == bspline || currentInterpMode == nurbs;
+	if (curveBVH.SegmentCount() != segmentCount || curveBVHMode != currentInterpMode || curveBVHGeneration != curveGeneration) {
+		if (spans) {
+			std::vector<SegmentBVH::Box> hulls(segmentCount);
+			for (size_t i = 0; i < segmentCount; ++i)
+				hulls[i] = SpanHull(i);
+			curveBVH.Build(hulls, [this](int span, const float *t, size_t count, vec3 *out) {
+				nurbsTessellation.Curve().EvaluateSpan(span, t, count, nurbsTessellation.Controls().data(), out);
+			});
+		}
+		else {
+			std::vector<SegmentBVH::Bezier> segments(segmentCount);
+			for (size_t i = 0; i < segmentCount; ++i)
+				segments[i] = SegmentBezier(i);
+			curveBVH.Build(segments);
+		}
+		curveBVHMode = currentInterpMode;
+		curveBVHGeneration = curveGeneration;
+		changedPoints.clear();
+		return;
 	}
+	//A point shapes the segments on both sides, in parabol and kochanek mode also the next ones through the tangents
+	//and in cubic mode all segments of the window that was solved again. B-spline points shape degree + 1 spans
+	if (spans) {
+		for (int point : changedPoints) {
+			if (point < 0 || point >= (int)points.size())
+				continue;
+			size_t first, end;
+			nurbsTessellation.Curve().SpansOf(point, first, end);
+			for (size_t i = first; i < end; ++i)
+				curveBVH.Update(i, SpanHull(i));
+		}
+		changedPoints.clear();
+		return;
+	}
+	int reach = currentInterpMode == parabol || currentInterpMode == kochanek ? 2 : 1;
+	if (currentInterpMode == cubic)
+		reach = SplineTangents::ResolveRadius + 1;
+	for (int point : changedPoints)
+		for (int i = point - reach; i < point + reach; ++i)
+			if (i >= 0 && i < (int)segmentCount)
+				curveBVH.Update(i, SegmentBezier(i));
+	changedPoints.clear();
+}
+
+bool PointInterp::PickCurve(const Ray &ray, float radius, SegmentBVH::Hit &hit)
+{
+	UpdateCurveBVH();
+	return curveBVH.RayNearest(ray, radius, hit);
 }
 
+bool PointInterp::ClosestOnCurve(vec3 p, SegmentBVH::Hit &hit, float maxDistance)
+{
+	UpdateCurveBVH();
+	return curveBVH.Closest(p, hit, maxDistance);
+}
 
+void PointInterp::CurveWithin(vec3 p, float radius, std::vector<SegmentBVH::Hit> &hits)
+{
+	UpdateCurveBVH();
+	curveBVH.WithinRadius(p, radius, hits);
+}
+
+
+//The nearest control point the ray hits, not the first in index order
 int PointInterp::Intersect(Ray ray)
 {
+	int nearest = -1;
+	float nearestT = FLT_MAX;
 	for (size_t i = 0; i < points.size(); ++i) {
 		Sphere boundingSphere = Sphere(points[i].pos, 0.1f);
-		if (boundingSphere.intersects(ray)) return i;
+		float t;
+		if (boundingSphere.intersect(ray, &t) && t < nearestT) {
+			nearestT = t;
+			nearest = i;
+		}
 	}
-	return -1;
+	return nearest;
 }
 
 int PointInterp::HandleIntersect(Ray ray)
@@ -381,20 +778,6 @@ vec3 PointInterp::GetPlaneIntersect(Ray ray)
 }
 
 
-std::vector<vec3> PointInterp::getDeltaPositions()
-{
-	std::vector<vec3> deltaPositions;
-
-	deltaPositions.resize(points.size());
-	deltaPositions[0] = points[0].pos;
-	for (size_t i = 1; i < points.size(); ++i) {
-		deltaPositions[i] = points[i].pos - points[i - 1].pos;
-	}
-	return deltaPositions;
-}
-
-
-
 void PointInterp::InsertPoint()
 {
 	points.push_back(RedefinedPoint());
@@ -430,6 +813,18 @@ std::vector<vec3> PointInterp::GetActiveSpline(float interval)
 		return GetBezierInterpSpline(interval);
 		break;
 	}
+	case(cubic):
+	case(kochanek):
+	{
+		return GetAutoTangentSpline(interval);
+		break;
+	}
+	case(bspline):
+	case(nurbs):
+	{
+		return GetNurbsSpline(interval);
+		break;
+	}
 	default:
 	{
 		return std::vector<vec3>();
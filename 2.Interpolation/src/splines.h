@@ -3,34 +3,76 @@
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
+#include "CurveLine.h"
+#include "Nurbs.h"
+#include "RedefinedPoint.h"
+#include "SegmentBVH.h"
+#include "SplineTangents.h"
+#include "TubeMesh.h"
+#include "ThreadPool.h"
 
 using namespace ci;
 using namespace ci::app;
 using namespace std;
 
-class RedefinedPoint {
+//Draws the spheres of all control points with one instanced draw call.
+//Position and color of every sphere are stored per instance, Update() uploads only the range that changed
+class PointMarkers {
 public:
-	RedefinedPoint() {
-		auto sphere = geom::Sphere().subdivisions(10).radius(0.1f);
-		auto colorShader = gl::ShaderDef().color();
-		auto colorShaderRef = gl::getStockShader(colorShader);
-		batchRef = gl::Batch::create(sphere, colorShaderRef);
-		hermiteTangent = vec3(0, 1.5, 0);
-		bezierTangentF = vec3(0, 1, 1);
-		bezierTangentB = vec3(0, -1, -1);
+	void Update(const std::vector<RedefinedPoint> &points, int activePoint);
+	void draw();
+
+	int instancesUploaded = 0;	//By the last Update
+
+private:
+	struct Instance {
+		vec3 pos;
+		vec3 color;
+		bool operator!=(const Instance &o) const { return pos != o.pos || color != o.color; }
 	};
+	void Allocate(size_t capacity);
+
+	std::vector<Instance> instances;	//What the instance buffer holds
+	size_t count = 0;
+	gl::VboRef instanceVboRef;
+	gl::BatchRef batchRef;
+};
 
+//Collects the lines of the handle gizmos and draws them with one call.
+//The buffer grows when needed and is only re-uploaded when the lines differ from the last frame
+class HandleLines {
 public:
-	vec3 pos;				//Position of the Control Point
-	vec3 hermiteTangent;	//Relative position of the hermite tangent
-	vec3 bezierTangentF;	//Relative position of the bezier tangent pointing forward
-	vec3 bezierTangentB;	//Relative position of the bezier tangent pointing backward
+	void Clear() { vertices.clear(); }
+	void Line(vec3 a, vec3 b, Color color);
+	void Arrow(vec3 from, vec3 to, Color color);
+	void StrokedCube(vec3 center, float halfSize, Color color);
+	void draw();
+
+private:
+	struct Vertex {
+		vec3 pos;
+		Color color;
+		bool operator!=(const Vertex &o) const { return pos != o.pos || color != o.color; }
+	};
+
+	std::vector<Vertex> vertices;
+	std::vector<Vertex> uploaded;
+	gl::VboRef vboRef;
 	gl::BatchRef batchRef;
+	size_t capacity = 0;
 };
 
 class PointInterp {
 public:
-	enum interpolationMode {line, hermite, parabol, bezier};
+	enum interpolationMode {line, hermite, parabol, bezier, cubic, kochanek, bspline, nurbs};
+
+	struct BenchmarkResult {
+		unsigned threads;
+		size_t segmentCount;
+		size_t vertexCount;
+		double ms;
+		bool matchesSingleThread;
+	};
 
 	std::vector<RedefinedPoint> points;
 	void InsertPoint();
@@ -40,6 +82,10 @@ public:
 	std::vector<vec3> GetHermiteSpline(float interval);
 	std::vector<vec3> GetParabolaInterpSpline(float interval);
 	std::vector<vec3> GetBezierInterpSpline(float interval);
+	//Hermite segments with the tangents of the cubic or kochanek mode
+	std::vector<vec3> GetAutoTangentSpline(float interval);
+	//Clamped uniform B-spline of splineDegree through the points as controls, rational with their weights in nurbs mode
+	std::vector<vec3> GetNurbsSpline(float interval);
 
 	glm::mat4 ConstructHermiteB(Point p1, Point p2);
 	glm::mat4 ConstructParabolaB(Point p1, Point p2, Point p3, Point p4);
@@ -53,16 +99,97 @@ public:
 	void UpdatePoint(Ray ray);
 	void UpdateTangent(Ray ray, CameraPersp cam);
 	void MouseDrag(MouseEvent event, CameraPersp cam);
+	void MouseMove(MouseEvent event, CameraPersp cam);
 	int Intersect(Ray ray);
 	int HandleIntersect(Ray ray);
 	int TangentIntersect(Ray ray);
 	vec3 GetPlaneIntersect(Ray ray);
-	std::vector<vec3> getDeltaPositions();
 	void draw();
 	int activePoint = -1;
 	int activeXYZHandle = -1;
 	int activeTangentHandle = -1;
-	
+	float curveThickness = 3.f;	//In pixels
+	bool showTube = false;			//Extrudes a tube along the curve
+	ThreadPool *tessellationPool = nullptr;	//The segments are evaluated on this pool, the shared one if null
+
+	static std::vector<BenchmarkResult> BenchmarkTessellation(size_t segmentCount = 1000000, float interval = 0.1f);
+
+	//Segments of the active mode, one per pair of points or one per knot span in the B-spline modes
+	size_t SegmentCount() const;
+	//Segment i of the active mode as a cubic bezier. Every mode but the B-spline ones is one
+	SegmentBVH::Bezier SegmentBezier(size_t i) const;
+	//Box around the degree + 1 control points of span i in the B-spline modes, the BVH evaluates the span itself
+	SegmentBVH::Box SpanHull(size_t span) const;
+	//Queries on the drawn curve, the BVH is rebuilt or refitted first if points changed
+	bool PickCurve(const Ray &ray, float radius, SegmentBVH::Hit &hit);
+	bool ClosestOnCurve(vec3 p, SegmentBVH::Hit &hit, float maxDistance = FLT_MAX);
+	void CurveWithin(vec3 p, float radius, std::vector<SegmentBVH::Hit> &hits);
+	//Call after moving a point or its tangents from outside, the segments around it are refitted on the next query
+	void PointChanged(int point) { changedPoints.push_back(point); tangentChanges.push_back(point); nurbsChanges.push_back(point); }
+
+	bool clampedEnds = false;		//Cubic mode: the first and last hermiteTangent are the end derivatives, otherwise natural ends
+	float kbTension = 0.f;			//Kochanek-Bartels parameters, each in -1..1
+	float kbContinuity = 0.f;
+	float kbBias = 0.f;
+	int splineDegree = 3;			//B-spline and NURBS modes, lowered to the point count - 1 for few points
+	size_t spansRetessellated = 0;	//By the last GetNurbsSpline
+
+	bool curveHovered = false;
+	vec3 curveHoverPos;
+
+private:
+	//Segments handed to one thread at a time, a segment is only a few dozen samples
+	static const size_t TessellationGrain = 1024;
+	typedef std::function<void(size_t, const std::vector<float>&, vec3*)> SegmentFn;
+	static std::vector<float> SampleParameters(float interval, bool includeOne);
+	//segmentCount defaults to one segment per pair of points
+	std::vector<vec3> Tessellate(float interval, bool includeOne, const SegmentFn &segment, size_t segmentCount = SIZE_MAX);
+
+	PointMarkers markers;
+	HandleLines handleLines;
+	CurveLine curveLine;
+	TubeMesh tube;
+
+	//What the automatic tangents were solved for, any difference solves them all again
+	struct TangentState {
+		size_t pointCount;
+		interpolationMode mode;
+		bool clampedEnds;
+		vec3 startTangent, endTangent;
+		float tension, continuity, bias;
+		bool operator!=(const TangentState &o) const {
+			return pointCount != o.pointCount || mode != o.mode || clampedEnds != o.clampedEnds || startTangent != o.startTangent
+				|| endTangent != o.endTangent || tension != o.tension || continuity != o.continuity || bias != o.bias;
+		}
+	};
+	void UpdateAutoTangents();
+	TangentState tangentState = {};
+	std::vector<vec3> positions;	//Of the points, as the tangents were last solved for
+	std::vector<vec3> incomingTangents;
+	std::vector<vec3> outgoingTangents;
+	std::vector<int> tangentChanges;
+	int curveGeneration = 0;		//Counts full solves of the tangents and rebuilds of the NURBS controls
+
+	//What the NURBS controls were built for, edits after that only change the controls and spans of the moved points
+	struct NurbsState {
+		size_t pointCount;
+		interpolationMode mode;
+		int degree;
+		bool operator!=(const NurbsState &o) const { return pointCount != o.pointCount || mode != o.mode || degree != o.degree; }
+	};
+	void UpdateNurbsControls();
+	vec4 NurbsControl(size_t i) const;
+	NurbsTessellation nurbsTessellation;
+	NurbsState nurbsState = {};
+	std::vector<int> nurbsChanges;
+	int nurbsSamplesGeneration = -1;
+	float nurbsSamplesInterval = 0.f;
+
+	void UpdateCurveBVH();
+	SegmentBVH curveBVH;
+	interpolationMode curveBVHMode = line;
+	int curveBVHGeneration = 0;
+	std::vector<int> changedPoints;
 };
 
 
@@ -0,0 +1,177 @@
+#include "CurveBuffer.h"
+#include <cstdio>
+#include <cstdlib>
+
+//Drives CurveBuffer with a backend that records every call and keeps a copy of each slot, so a slot can be compared
+//against the curve it is supposed to hold after the upload
+namespace {
+	int failures = 0;
+
+	#define CHECK(condition) do { if (!(condition)) { std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); ++failures; } } while (0)
+
+	struct Call {
+		bool allocate;
+		int slot;
+		size_t first, count;	//count is the capacity for Allocate
+	};
+
+	class RecordingBackend : public CurveUploadBackend {
+	public:
+		std::vector<Call> calls;
+		std::vector<vec3> slots[CurveBuffer::SlotCount];
+
+		void Allocate(int slot, size_t vertexCapacity) override
+		{
+			calls.push_back({ true, slot, 0, vertexCapacity });
+			slots[slot].assign(vertexCapacity, vec3(NAN, NAN, NAN));
+		}
+		void Upload(int slot, size_t first, size_t count, const vec3 *vertices) override
+		{
+			calls.push_back({ false, slot, first, count });
+			CHECK(first + count <= slots[slot].size());
+			std::copy(vertices, vertices + count, slots[slot].begin() + first);
+		}
+	};
+
+	std::vector<vec3> Curve(size_t count, float offset = 0.f)
+	{
+		std::vector<vec3> curve(count);
+		for (size_t i = 0; i < count; ++i)
+			curve[i] = vec3(i, offset, 0);
+		return curve;
+	}
+
+	//The slot holds the curve with its first and last point repeated
+	bool Holds(const RecordingBackend &backend, int slot, const std::vector<vec3> &curve)
+	{
+		const std::vector<vec3> &vertices = backend.slots[slot];
+		if (vertices.size() < curve.size() + 2)
+			return false;
+		for (size_t i = 0; i < curve.size() + 2; ++i)
+			if (vertices[i] != curve[std::min(std::max(i, (size_t)1), curve.size()) - 1])
+				return false;
+		return true;
+	}
+
+	void GrowthReallocatesEverySlot()
+	{
+		RecordingBackend backend;
+		CurveBuffer buffer(backend);
+		std::vector<vec3> curve = Curve(10);
+		int slot = buffer.Update(curve);
+		CHECK(backend.calls.size() == CurveBuffer::SlotCount + 1);
+		for (int s = 0; s < CurveBuffer::SlotCount; ++s)
+			CHECK(backend.calls[s].allocate && backend.calls[s].slot == s && backend.calls[s].count == 12);
+		CHECK(Holds(backend, slot, curve));
+
+		backend.calls.clear();
+		curve = Curve(11);
+		slot = buffer.Update(curve);
+		int allocations = 0;
+		for (const Call &call : backend.calls)
+			allocations += call.allocate;
+		CHECK(allocations == CurveBuffer::SlotCount);
+		CHECK(buffer.Capacity() == 24);
+		CHECK(buffer.verticesUploaded == 13);
+		CHECK(Holds(backend, slot, curve));
+	}
+
+	void OnlyTheChangedRangeIsUploaded()
+	{
+		RecordingBackend backend;
+		CurveBuffer buffer(backend);
+		std::vector<vec3> curve = Curve(20);
+		for (int s = 0; s < CurveBuffer::SlotCount; ++s)
+			buffer.Update(curve);
+
+		backend.calls.clear();
+		curve[5].y = 1;
+		curve[7].y = 1;
+		int slot = buffer.Update(curve);
+		CHECK(backend.calls.size() == 1);
+		//Vertex i + 1 holds curve point i
+		CHECK(!backend.calls[0].allocate && backend.calls[0].slot == slot);
+		CHECK(backend.calls[0].first == 6 && backend.calls[0].count == 3);
+		CHECK(Holds(backend, slot, curve));
+
+		//Nothing changed, nothing for a slot that is up to date
+		backend.calls.clear();
+		for (int s = 0; s < CurveBuffer::SlotCount - 1; ++s)
+			buffer.Update(curve);
+		backend.calls.clear();
+		slot = buffer.Update(curve);
+		CHECK(backend.calls.empty());
+		CHECK(Holds(backend, slot, curve));
+	}
+
+	void SkippedSlotCatchesUp()
+	{
+		RecordingBackend backend;
+		CurveBuffer buffer(backend);
+		std::vector<vec3> curve = Curve(30);
+		for (int s = 0; s < CurveBuffer::SlotCount; ++s)
+			buffer.Update(curve);
+
+		//Every frame changes one point. The slot written again gets the points 20, 10 and 11 of the frames it was skipped in,
+		//vertex i + 1 holds point i
+		curve[2].y = 1;
+		int first = buffer.Update(curve);
+		curve[20].y = 1;
+		buffer.Update(curve);
+		curve[10].y = 1;
+		buffer.Update(curve);
+		backend.calls.clear();
+		curve[11].y = 1;
+		int slot = buffer.Update(curve);
+		CHECK(slot == first);
+		CHECK(backend.calls.size() == 1);
+		CHECK(backend.calls[0].first == 11 && backend.calls[0].count == 11);
+		CHECK(Holds(backend, slot, curve));
+		for (int s = 0; s < CurveBuffer::SlotCount - 1; ++s)
+			CHECK(Holds(backend, buffer.Update(curve), curve));
+	}
+
+	void ShrinkThenGrow()
+	{
+		RecordingBackend backend;
+		CurveBuffer buffer(backend);
+		std::vector<vec3> curve = Curve(20);
+		for (int s = 0; s < CurveBuffer::SlotCount; ++s)
+			buffer.Update(curve);
+
+		//The new last point is repeated after it, both vertices change
+		backend.calls.clear();
+		curve.resize(12);
+		int slot = buffer.Update(curve);
+		CHECK(backend.calls.size() == 1);
+		CHECK(backend.calls[0].first == 13 && backend.calls[0].count == 1);
+		CHECK(Holds(backend, slot, curve));
+
+		//Growing within the capacity uploads the points past the old end and the old repeated one
+		backend.calls.clear();
+		curve = Curve(16);
+		slot = buffer.Update(curve);
+		CHECK(buffer.Capacity() == 22);
+		CHECK(backend.calls.size() == 1 && !backend.calls[0].allocate);
+		CHECK(backend.calls[0].first == 13 && backend.calls[0].count == 5);
+		CHECK(Holds(backend, slot, curve));
+
+		//The slot after it missed the shrink as well
+		backend.calls.clear();
+		slot = buffer.Update(curve);
+		CHECK(backend.calls.size() == 1);
+		CHECK(backend.calls[0].first == 13 && backend.calls[0].count == 5);
+		CHECK(Holds(backend, slot, curve));
+		CHECK(Holds(backend, buffer.Update(curve), curve));
+	}
+}
+
+int main()
+{
+	GrowthReallocatesEverySlot();
+	OnlyTheChangedRangeIsUploaded();
+	SkippedSlotCatchesUp();
+	ShrinkThenGrow();
+	std::printf(failures ? "CurveBufferTest: %d failed\n" : "CurveBufferTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include "CurveFitter.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+//Every sample has to lie within the tolerance of the fitted bezier curve, measured independently of the parameters the
+//fitter settled on, and the handles of a joint have to be parallel. Inputs without any direction must not break it
+namespace {
+	const float Tolerance = 0.01f;
+	const int DenseSamples = 1000;	//Per segment, the polyline through them is within 1e-5 of the curve
+	int failures = 0;
+
+	void Report(const char *name, bool passed)
+	{
+		failures += !passed;
+		std::printf("%-56s %s\n", name, passed ? "passed" : "FAILED");
+	}
+
+	void Report(const char *name, bool passed, float value)
+	{
+		failures += !passed;
+		std::printf("%-56s %.3g %s\n", name, value, passed ? "" : "FAILED");
+	}
+
+	vec3 Evaluate(const RedefinedPoint &a, const RedefinedPoint &b, float t)
+	{
+		float s = 1 - t;
+		return s * s * s * a.pos + 3 * s * s * t * (a.pos + a.bezierTangentF) + 3 * s * t * t * (b.pos + b.bezierTangentB) +
+			   t * t * t * b.pos;
+	}
+
+	float DistanceToLine(vec3 p, vec3 a, vec3 b)
+	{
+		vec3 ab = b - a;
+		float ll = dot(ab, ab);
+		float t = ll > 0 ? glm::clamp(dot(p - a, ab) / ll, 0.f, 1.f) : 0.f;
+		return length(p - (a + ab * t));
+	}
+
+	//The samples of segment k run from the one at points[k] to the one at points[k + 1], every fitted point is a sample
+	float MaxDistance(const std::vector<vec3> &samples, const std::vector<RedefinedPoint> &points)
+	{
+		float worst = 0.f;
+		size_t segment = 0;
+		std::vector<vec3> dense(DenseSamples + 1);
+		auto densify = [&]() {
+			for (int k = 0; k <= DenseSamples; ++k)
+				dense[k] = Evaluate(points[segment], points[segment + 1], k / (float)DenseSamples);
+		};
+		densify();
+		for (const vec3 &p : samples) {
+			float distance = FLT_MAX;
+			for (int k = 0; k < DenseSamples; ++k)
+				distance = std::min(distance, DistanceToLine(p, dense[k], dense[k + 1]));
+			worst = std::max(worst, distance);
+			if (p == points[segment + 1].pos && segment + 2 < points.size()) {
+				++segment;
+				densify();
+			}
+		}
+		return worst;
+	}
+
+	void CheckFit(const char *name, const std::vector<vec3> &samples)
+	{
+		CurveFitter::Stats stats;
+		std::vector<RedefinedPoint> points = CurveFitter::FitBezier(samples, Tolerance, &stats);
+		char line[96];
+		std::snprintf(line, sizeof(line), "%s: %zu samples, %zu points", name, samples.size(), points.size());
+		Report(line, points.size() >= 2 && points.size() < samples.size() / 10 && stats.points == points.size() &&
+					 points.front().pos == samples.front() && points.back().pos == samples.back());
+		if (points.size() < 2)
+			return;
+
+		std::snprintf(line, sizeof(line), "%s: Stats maxError", name);
+		Report(line, stats.maxError <= Tolerance, stats.maxError);
+		std::snprintf(line, sizeof(line), "%s: distance of every sample", name);
+		float distance = MaxDistance(samples, points);
+		Report(line, distance <= Tolerance + 1e-4f, distance);
+
+		//F and -B of an interior point point the same way
+		float worstAngle = 0.f;
+		bool handles = true;
+		for (size_t i = 0; i < points.size(); ++i) {
+			const RedefinedPoint &p = points[i];
+			handles = handles && p.hermiteTangent == (i + 1 < points.size() ? 3.f * p.bezierTangentF : -3.f * p.bezierTangentB);
+			if (i == 0 || i + 1 == points.size())
+				continue;
+			vec3 f = normalize(p.bezierTangentF), b = normalize(-p.bezierTangentB);
+			worstAngle = std::max(worstAngle, std::atan2(length(cross(f, b)), dot(f, b)));
+		}
+		std::snprintf(line, sizeof(line), "%s: G1 joints, largest angle", name);
+		Report(line, handles && worstAngle <= 1e-3f, worstAngle);
+	}
+
+	void CheckDegenerate(const char *name, const std::vector<vec3> &samples, size_t expectedPoints)
+	{
+		CurveFitter::Stats stats;
+		std::vector<RedefinedPoint> points = CurveFitter::FitBezier(samples, Tolerance, &stats);
+		bool passed = points.size() == expectedPoints && stats.points == expectedPoints &&
+					  stats.samples == samples.size() && stats.maxError == 0.f;
+		for (const RedefinedPoint &p : points)
+			passed = passed && std::isfinite(p.pos.x) && p.pos == samples.front();
+		Report(name, passed);
+	}
+}
+
+int main()
+{
+	std::vector<vec3> path = CurveFitter::SamplePath(5000);
+	CheckFit("SamplePath", path);
+
+	//Every sample twice, the repeats have no direction
+	std::vector<vec3> doubled;
+	for (const vec3 &p : CurveFitter::SamplePath(2000)) {
+		doubled.push_back(p);
+		doubled.push_back(p);
+	}
+	CheckFit("SamplePath, repeated samples", doubled);
+
+	CheckDegenerate("No samples", {}, 0);
+	CheckDegenerate("One sample", { vec3(1, 2, 3) }, 1);
+	CheckDegenerate("One sample repeated", std::vector<vec3>(100, vec3(1, 2, 3)), 1);
+
+	//Two samples give the straight segment between them
+	CurveFitter::Stats stats;
+	std::vector<RedefinedPoint> line = CurveFitter::FitBezier({ vec3(0, 0, 0), vec3(0, 0, 0), vec3(3, 0, 0) }, Tolerance, &stats);
+	Report("Two distinct samples, a straight segment", line.size() == 2 && line[0].bezierTangentF == vec3(1, 0, 0) &&
+											  line[1].bezierTangentB == vec3(-1, 0, 0) && stats.maxError == 0.f);
+
+	std::printf(failures ? "CurveFitterTest: %d failed\n" : "CurveFitterTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,219 @@
+#include "Nurbs.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//Checks the blocked de Boor evaluation against the Cox-de Boor recursion, the span locality the incremental
+//tessellation relies on and the tessellation itself against a full rebuild
+namespace {
+	const float Tolerance = 1e-3f;	//The controls lie in -10..10
+	int failures = 0;
+
+	void Report(const char *name, bool passed)
+	{
+		failures += !passed;
+		std::printf("%-44s %s\n", name, passed ? "passed" : "FAILED");
+	}
+
+	void Report(const char *name, bool passed, float error)
+	{
+		failures += !passed;
+		std::printf("%-44s max error %.2e %s\n", name, error, passed ? "" : "FAILED");
+	}
+
+	float Difference(vec3 a, vec3 b)
+	{
+		vec3 d = a - b;
+		return std::max(std::max(std::abs(d.x), std::abs(d.y)), std::abs(d.z));
+	}
+
+	//N_i,p(u) by its definition, with 0 / 0 taken as 0
+	double Basis(const std::vector<float> &knots, size_t i, int p, double u)
+	{
+		if (p == 0)
+			return knots[i] <= u && u < knots[i + 1] ? 1.0 : 0.0;
+		double value = 0.0;
+		double left = knots[i + p] - knots[i];
+		double right = knots[i + p + 1] - knots[i + 1];
+		if (left > 0)
+			value += (u - knots[i]) / left * Basis(knots, i, p - 1, u);
+		if (right > 0)
+			value += (knots[i + p + 1] - u) / right * Basis(knots, i + 1, p - 1, u);
+		return value;
+	}
+
+	vec3 CoxDeBoor(const std::vector<float> &knots, int degree, const std::vector<vec4> &controls, double u)
+	{
+		double sum[4] = {};
+		for (size_t i = 0; i < controls.size(); ++i) {
+			double n = Basis(knots, i, degree, u);
+			for (int c = 0; c < 4; ++c)
+				sum[c] += n * controls[i][c];
+		}
+		return vec3((float)(sum[0] / sum[3]), (float)(sum[1] / sum[3]), (float)(sum[2] / sum[3]));
+	}
+
+	std::vector<vec4> RandomControls(size_t count, std::mt19937 &rng)
+	{
+		std::uniform_real_distribution<float> box(-10.f, 10.f);
+		std::uniform_real_distribution<float> weight(0.5f, 2.f);
+		std::vector<vec4> controls(count);
+		for (vec4 &c : controls) {
+			float w = weight(rng);
+			c = vec4(vec3(box(rng), box(rng), box(rng)) * w, w);
+		}
+		return controls;
+	}
+
+	//Clamped, with random spacing and the second interior knot doubled
+	std::vector<float> RandomKnots(size_t controlCount, int degree, std::mt19937 &rng)
+	{
+		std::uniform_real_distribution<float> step(0.2f, 2.f);
+		std::vector<float> knots(controlCount + degree + 1, 0.f);
+		for (size_t i = degree + 1; i < controlCount; ++i)
+			knots[i] = knots[i - 1] + (i == (size_t)degree + 2 ? 0.f : step(rng));
+		float end = knots[controlCount - 1] + step(rng);
+		for (size_t i = controlCount; i < knots.size(); ++i)
+			knots[i] = end;
+		return knots;
+	}
+
+	void CheckCoxDeBoor(std::mt19937 &rng)
+	{
+		for (int degree = 1; degree <= NurbsCurve::MaxDegree; ++degree) {
+			size_t controlCount = degree + 6;
+			std::vector<vec4> controls = RandomControls(controlCount, rng);
+			std::vector<float> knots = RandomKnots(controlCount, degree, rng);
+			NurbsCurve curve;
+			curve.SetKnots(knots, degree);
+
+			float worst = 0.f;
+			float start = knots[degree], end = knots[controlCount];
+			for (int s = 0; s < 200; ++s) {
+				float u = start + (end - start) * s / 200;
+				worst = std::max(worst, Difference(curve.Evaluate(u, controls.data()), CoxDeBoor(knots, degree, controls, u)));
+			}
+			//All spans in blocks of 13 samples, so the last block of every span is partial
+			const size_t Samples = 13;
+			float t[Samples];
+			vec3 out[Samples];
+			for (size_t i = 0; i < Samples; ++i)
+				t[i] = (float)i / Samples;
+			for (size_t span = 0; span < curve.SpanCount(); ++span) {
+				if (curve.SpanEnd(span) <= curve.SpanStart(span))
+					continue;
+				curve.EvaluateSpan(span, t, Samples, controls.data(), out);
+				for (size_t i = 0; i < Samples; ++i) {
+					double u = curve.SpanStart(span) + (curve.SpanEnd(span) - curve.SpanStart(span)) * (double)t[i];
+					worst = std::max(worst, Difference(out[i], CoxDeBoor(knots, degree, controls, u)));
+				}
+			}
+			//The clamped curve ends in its last control point, where the half open basis functions are all 0
+			vec3 last = vec3(controls.back()) / controls.back().w;
+			worst = std::max(worst, Difference(curve.Evaluate(end, controls.data()), last));
+
+			char name[64];
+			std::snprintf(name, sizeof(name), "de Boor = Cox-de Boor, degree %d", degree);
+			Report(name, worst <= Tolerance, worst);
+		}
+	}
+
+	//Moving control i must change exactly the spans SpansOf reports
+	void CheckSpansOf(std::mt19937 &rng)
+	{
+		const float T[] = { 0.f, 0.3f, 0.7f, 1.f };
+		bool passed = true;
+		for (int degree = 1; degree <= NurbsCurve::MaxDegree; ++degree) {
+			size_t controlCount = degree + 8;
+			std::vector<vec4> controls = RandomControls(controlCount, rng);
+			NurbsCurve curve;
+			curve.SetUniform(controlCount, degree);
+			for (size_t i = 0; i < controlCount; ++i) {
+				std::vector<vec4> moved = controls;
+				moved[i] += vec4(1, 2, 3, 0);
+				size_t first, end;
+				curve.SpansOf(i, first, end);
+				for (size_t span = 0; span < curve.SpanCount(); ++span) {
+					vec3 a[4], b[4];
+					curve.EvaluateSpan(span, T, 4, controls.data(), a);
+					curve.EvaluateSpan(span, T, 4, moved.data(), b);
+					bool changed = false;
+					for (int s = 0; s < 4; ++s)
+						changed = changed || Difference(a[s], b[s]) > 0.f;
+					passed = passed && changed == (span >= first && span < end);
+				}
+			}
+		}
+		Report("SpansOf covers exactly the changed spans", passed);
+	}
+
+	void CheckRetessellate(std::mt19937 &rng)
+	{
+		const size_t ControlCount = 60;
+		const int Degree = 3;
+		std::vector<float> parameters;
+		for (int i = 0; i < 10; ++i)
+			parameters.push_back(i / 10.f);
+		ThreadPool pool(4);
+		std::vector<vec4> controls = RandomControls(ControlCount, rng);
+		NurbsTessellation incremental;
+		incremental.SetControls(controls, Degree);
+		incremental.Tessellate(parameters, pool, 8);
+
+		std::uniform_int_distribution<size_t> pick(0, ControlCount - 1);
+		std::uniform_real_distribution<float> nudge(-1.f, 1.f);
+		bool counts = true;
+		for (int edit = 0; edit < 100; ++edit) {
+			size_t i = pick(rng);
+			controls[i] += vec4(nudge(rng), nudge(rng), nudge(rng), 0);
+			incremental.MoveControl(i, controls[i]);
+			size_t first, end;
+			incremental.Curve().SpansOf(i, first, end);
+			counts = counts && incremental.Retessellate() == end - first;
+		}
+		NurbsTessellation full;
+		full.SetControls(controls, Degree);
+		full.Tessellate(parameters, pool, 8);
+
+		float worst = 0.f;
+		bool sizes = incremental.Samples().size() == full.Samples().size() &&
+					 full.Samples().size() == (ControlCount - Degree) * (parameters.size() + 1);
+		for (size_t i = 0; sizes && i < full.Samples().size(); ++i)
+			worst = std::max(worst, Difference(incremental.Samples()[i], full.Samples()[i]));
+		Report("Retessellate = full tessellation", sizes && worst == 0.f, worst);
+		Report("Retessellate evaluates the moved spans", counts);
+		Report("Nothing moved, nothing evaluated", incremental.Retessellate() == 0);
+	}
+
+	void CheckFindSpan()
+	{
+		//0 0 0 0 1 2 3 4 5 5 5 5: five spans of length 1
+		NurbsCurve uniform;
+		uniform.SetUniform(8, 3);
+		bool passed = uniform.FindSpan(0.f) == 0 && uniform.FindSpan(-1.f) == 0 && uniform.FindSpan(0.999f) == 0 &&
+					  uniform.FindSpan(1.f) == 1 && uniform.FindSpan(4.f) == 4 && uniform.FindSpan(5.f) == 4 &&
+					  uniform.FindSpan(6.f) == 4;
+		Report("FindSpan at uniform knots and the ends", passed);
+
+		//Span 2 is empty, 2 belongs to the span that starts there
+		NurbsCurve repeated;
+		repeated.SetKnots({ 0, 0, 0, 0, 1, 2, 2, 3, 3, 3, 3 }, 3);
+		passed = repeated.SpanCount() == 4 && repeated.FindSpan(1.999f) == 1 && repeated.FindSpan(2.f) == 3 &&
+				 repeated.FindSpan(3.f) == 3;
+		Report("FindSpan at a repeated knot", passed);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(17);
+	CheckCoxDeBoor(rng);
+	CheckSpansOf(rng);
+	CheckRetessellate(rng);
+	CheckFindSpan();
+
+	std::printf(failures ? "NurbsTest: %d failed\n" : "NurbsTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#include "Nurbs.h"
+#include "SegmentBVH.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//Compares the queries of the tree with testing every segment from dense samples, for a chain of bezier segments and for
+//the spans of a B-spline, once after Build and once more after moving points and refitting the boxes with Update
+namespace {
+	const int DenseSamples = 2000;	//Per segment, the distances of the brute force are good to about 1e-4
+	const float Tolerance = 1e-3f;
+	//The distance to a ray is flat around the closest approach, where the curve runs almost along the ray a tiny change
+	//of distance moves the ray parameter much further
+	const float RayTolerance = 5e-2f;
+	const int Queries = 200;
+	int failures = 0;
+
+	typedef std::function<vec3(int segment, float t)> CurveFn;
+
+	//Of every segment the densely sampled point closest to p, measured perpendicular to direction if it is not zero
+	void BruteForce(const CurveFn &curve, size_t segmentCount, vec3 p, vec3 direction, std::vector<SegmentBVH::Hit> &hits)
+	{
+		float dd = dot(direction, direction);
+		hits.assign(segmentCount, SegmentBVH::Hit());
+		for (size_t s = 0; s < segmentCount; ++s) {
+			SegmentBVH::Hit &hit = hits[s];
+			hit.segment = (int)s;
+			for (int k = 0; k <= DenseSamples; ++k) {
+				float t = k / (float)DenseSamples;
+				vec3 point = curve((int)s, t);
+				vec3 w = point - p;
+				if (dd > 0)
+					w -= direction * (dot(w, direction) / dd);
+				float distance = length(w);
+				if (distance < hit.distance) {
+					hit.distance = distance;
+					hit.t = t;
+					hit.point = point;
+					hit.rayT = dd > 0 ? dot(point - p, direction) / dd : 0.f;
+				}
+			}
+		}
+	}
+
+	void Check(const char *name, const SegmentBVH &bvh, const CurveFn &curve, size_t segmentCount, std::mt19937 &rng)
+	{
+		std::uniform_real_distribution<float> box(-12.f, 12.f);
+		std::vector<SegmentBVH::Hit> reference, hits;
+		float closestError = 0.f, rayError = 0.f;
+		bool radiusHits = true, rayHits = true;
+		const float Radius = 1.5f;
+		for (int q = 0; q < Queries; ++q) {
+			vec3 p(box(rng), box(rng), box(rng));
+			BruteForce(curve, segmentCount, p, vec3(0, 0, 0), reference);
+			float nearest = FLT_MAX;
+			for (const SegmentBVH::Hit &r : reference)
+				nearest = std::min(nearest, r.distance);
+
+			SegmentBVH::Hit hit;
+			if (bvh.Closest(p, hit))
+				closestError = std::max(closestError, std::abs(hit.distance - nearest));
+			else
+				closestError = INFINITY;
+
+			//Every segment clearly inside the radius is found, and nothing outside it
+			bvh.WithinRadius(p, Radius, hits);
+			for (const SegmentBVH::Hit &r : reference) {
+				bool found = false;
+				for (const SegmentBVH::Hit &h : hits)
+					found = found || h.segment == r.segment;
+				if (r.distance < Radius - Tolerance && !found)
+					radiusHits = false;
+				if (r.distance > Radius + Tolerance && found)
+					radiusHits = false;
+			}
+
+			//A ray from the query point towards a random target, the first segment along it that passes within the radius
+			vec3 direction = normalize(vec3(box(rng), box(rng), box(rng)) - p);
+			BruteForce(curve, segmentCount, p, direction, reference);
+			const SegmentBVH::Hit *first = nullptr;
+			bool ambiguous = false;
+			for (const SegmentBVH::Hit &r : reference) {
+				if (r.rayT < 0)
+					continue;
+				ambiguous = ambiguous || std::abs(r.distance - Radius) < Tolerance;
+				if (r.distance <= Radius && (!first || r.rayT < first->rayT))
+					first = &r;
+			}
+			if (ambiguous)
+				continue;
+			bool found = bvh.RayNearest(Ray(p, direction), Radius, hit);
+			if (found != (first != nullptr))
+				rayHits = false;
+			else if (found)
+				rayError = std::max(rayError, std::abs(hit.rayT - first->rayT));
+		}
+		bool passed = closestError <= Tolerance && radiusHits && rayHits && rayError <= RayTolerance;
+		failures += !passed;
+		std::printf("%-32s Closest error %.2e  RayNearest error %.2e  %s%s%s\n", name, closestError, rayError,
+					radiusHits ? "" : "WithinRadius ", rayHits ? "" : "RayNearest ", passed ? "" : "FAILED");
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(29);
+	std::uniform_real_distribution<float> box(-10.f, 10.f);
+	std::uniform_real_distribution<float> nudge(-3.f, 3.f);
+	const size_t PointCount = 40;
+	std::vector<vec3> points(PointCount);
+	for (vec3 &p : points)
+		p = vec3(box(rng), box(rng), box(rng));
+
+	//Bezier segments through the points with Catmull-Rom handles
+	auto bezier = [&](size_t i) {
+		vec3 before = points[i > 0 ? i - 1 : i], after = points[i + 2 < PointCount ? i + 2 : i + 1];
+		return SegmentBVH::Bezier{ { points[i], points[i] + (points[i + 1] - before) / 6.f,
+									 points[i + 1] - (after - points[i]) / 6.f, points[i + 1] } };
+	};
+	std::vector<SegmentBVH::Bezier> segments(PointCount - 1);
+	for (size_t i = 0; i < segments.size(); ++i)
+		segments[i] = bezier(i);
+	SegmentBVH bezierBVH;
+	bezierBVH.Build(segments);
+	auto bezierCurve = [&](int s, float t) { return SegmentBVH::Evaluate(segments[s], t); };
+	Check("Bezier segments", bezierBVH, bezierCurve, segments.size(), rng);
+	for (int edit = 0; edit < 20; ++edit) {
+		size_t i = std::uniform_int_distribution<size_t>(0, PointCount - 1)(rng);
+		points[i] += vec3(nudge(rng), nudge(rng), nudge(rng));
+		//The handles reach two points, so the segments from i - 2 to i + 1 change
+		for (size_t s = i > 2 ? i - 2 : 0; s < std::min(i + 2, segments.size()); ++s) {
+			segments[s] = bezier(s);
+			bezierBVH.Update((int)s, segments[s]);
+		}
+	}
+	Check("Bezier segments, refitted", bezierBVH, bezierCurve, segments.size(), rng);
+
+	//A cubic B-spline with the points as controls, boxed by the hulls of the span controls
+	std::vector<vec4> controls(PointCount);
+	for (size_t i = 0; i < PointCount; ++i)
+		controls[i] = vec4(points[i], 1);
+	NurbsCurve nurbs;
+	nurbs.SetUniform(PointCount, 3);
+	auto hull = [&](size_t span) {
+		SegmentBVH::Box box;
+		for (int j = 0; j <= nurbs.Degree(); ++j)
+			box.Add(vec3(controls[span + j]));
+		return box;
+	};
+	std::vector<SegmentBVH::Box> hulls(nurbs.SpanCount());
+	for (size_t i = 0; i < hulls.size(); ++i)
+		hulls[i] = hull(i);
+	SegmentBVH spanBVH;
+	spanBVH.Build(hulls, [&](int span, const float *t, size_t count, vec3 *out) {
+		nurbs.EvaluateSpan(span, t, count, controls.data(), out);
+	});
+	auto spanCurve = [&](int s, float t) {
+		vec3 point;
+		nurbs.EvaluateSpan(s, &t, 1, controls.data(), &point);
+		return point;
+	};
+	Check("B-spline spans", spanBVH, spanCurve, hulls.size(), rng);
+	for (int edit = 0; edit < 20; ++edit) {
+		size_t i = std::uniform_int_distribution<size_t>(0, PointCount - 1)(rng);
+		controls[i] += vec4(nudge(rng), nudge(rng), nudge(rng), 0);
+		size_t first, end;
+		nurbs.SpansOf(i, first, end);
+		for (size_t s = first; s < end; ++s)
+			spanBVH.Update((int)s, hull(s));
+	}
+	Check("B-spline spans, refitted", spanBVH, spanCurve, hulls.size(), rng);
+
+	std::printf(failures ? "SegmentBVHTest: %d failed\n" : "SegmentBVHTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
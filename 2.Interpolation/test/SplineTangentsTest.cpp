@@ -0,0 +1,103 @@
+#include "SplineTangents.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//Checks that the solved tangents satisfy the C2 system, that local re-solves after edits stay at the full solution
+//and that Kochanek-Bartels without parameters is Catmull-Rom
+namespace {
+	const float Tolerance = 1e-3f;	//The points lie in -10..10, the right sides reach 60
+	const size_t PointCount = 200;
+	int failures = 0;
+
+	void Report(const char *name, bool passed, float error)
+	{
+		failures += !passed;
+		std::printf("%-40s max error %.2e %s\n", name, error, passed ? "" : "FAILED");
+	}
+
+	float Difference(vec3 a, vec3 b)
+	{
+		vec3 d = a - b;
+		return std::max(std::max(std::abs(d.x), std::abs(d.y)), std::abs(d.z));
+	}
+
+	std::vector<vec3> RandomPoints(size_t count, std::mt19937 &rng)
+	{
+		std::uniform_real_distribution<float> box(-10.f, 10.f);
+		std::vector<vec3> points(count);
+		for (vec3 &p : points)
+			p = vec3(box(rng), box(rng), box(rng));
+		return points;
+	}
+
+	//The largest difference between the two sides of the rows of the system
+	float Residual(const std::vector<vec3> &P, const std::vector<vec3> &D, bool clamped, vec3 startTangent, vec3 endTangent)
+	{
+		size_t n = P.size();
+		float worst = clamped ? std::max(Difference(D[0], startTangent), Difference(D[n - 1], endTangent))
+							  : std::max(Difference(2.f * D[0] + D[1], 3.f * (P[1] - P[0])),
+										 Difference(D[n - 2] + 2.f * D[n - 1], 3.f * (P[n - 1] - P[n - 2])));
+		for (size_t i = 1; i + 1 < n; ++i)
+			worst = std::max(worst, Difference(D[i - 1] + 4.f * D[i] + D[i + 1], 3.f * (P[i + 1] - P[i - 1])));
+		return worst;
+	}
+
+	float MaxDifference(const std::vector<vec3> &a, const std::vector<vec3> &b)
+	{
+		float worst = a.size() == b.size() ? 0.f : INFINITY;
+		for (size_t i = 0; i < std::min(a.size(), b.size()); ++i)
+			worst = std::max(worst, Difference(a[i], b[i]));
+		return worst;
+	}
+}
+
+int main()
+{
+	using namespace SplineTangents;
+	std::mt19937 rng(23);
+	vec3 startTangent(1, -2, 3), endTangent(-4, 0, 2);
+
+	for (bool clamped : { false, true }) {
+		std::vector<vec3> points = RandomPoints(PointCount, rng);
+		std::vector<vec3> tangents;
+		SolveC2(points, tangents, clamped, startTangent, endTangent);
+		float residual = Residual(points, tangents, clamped, startTangent, endTangent);
+		Report(clamped ? "SolveC2 residual, clamped" : "SolveC2 residual, natural", residual <= Tolerance, residual);
+
+		//Every edit re-solves its window only, the tangents outside drift from the full solution by less than float
+		//precision each time
+		std::uniform_int_distribution<size_t> pick(0, PointCount - 1);
+		std::uniform_real_distribution<float> nudge(-2.f, 2.f);
+		bool windows = true;
+		for (int edit = 0; edit < 100; ++edit) {
+			size_t point = pick(rng);
+			points[point] += vec3(nudge(rng), nudge(rng), nudge(rng));
+			size_t first, end;
+			ResolveC2(points, tangents, clamped, startTangent, endTangent, point, first, end);
+			windows = windows && first <= point && point < end && end - first <= 2 * (size_t)ResolveRadius + 1;
+		}
+		std::vector<vec3> full;
+		SolveC2(points, full, clamped, startTangent, endTangent);
+		float error = MaxDifference(tangents, full);
+		Report(clamped ? "100 ResolveC2 = SolveC2, clamped" : "100 ResolveC2 = SolveC2, natural", windows && error <= Tolerance, error);
+	}
+
+	//Catmull-Rom takes half the difference of the neighbours, the ends their only neighbour difference
+	std::vector<vec3> points = RandomPoints(PointCount, rng);
+	std::vector<vec3> incoming, outgoing;
+	KochanekBartels(points, incoming, outgoing, 0.f, 0.f, 0.f);
+	float error = std::max(Difference(outgoing.front(), points[1] - points[0]),
+						   Difference(outgoing.back(), points[PointCount - 1] - points[PointCount - 2]));
+	for (size_t i = 0; i < PointCount; ++i) {
+		if (i > 0 && i + 1 < PointCount)
+			error = std::max(error, Difference(outgoing[i], 0.5f * (points[i + 1] - points[i - 1])));
+		error = std::max(error, Difference(incoming[i], outgoing[i]));
+	}
+	Report("KochanekBartels(0, 0, 0) = Catmull-Rom", error <= 1e-5f, error);
+
+	std::printf(failures ? "SplineTangentsTest: %d failed\n" : "SplineTangentsTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
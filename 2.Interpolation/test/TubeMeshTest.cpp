@@ -0,0 +1,142 @@
+#include "TubeMesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//After any sequence of edits the incremental Update has to leave the mesh a fresh TubeMesh builds from the final curve.
+//The frames stop propagating where they come out within CurveFrames' settle tolerance of 1e-5, so the two may differ
+//by that much per edit. A local edit has to rewrite a few rings, a bend everything after it
+namespace {
+	const size_t SampleCount = 2000;
+	const int Edits = 20;
+	const float Tolerance = Edits * 1e-5f + 1e-5f;
+	int failures = 0;
+
+	void Report(const char *name, bool passed)
+	{
+		failures += !passed;
+		std::printf("%-40s %s\n", name, passed ? "passed" : "FAILED");
+	}
+
+	void Report(const char *name, bool passed, float value)
+	{
+		failures += !passed;
+		std::printf("%-40s %.3g %s\n", name, value, passed ? "" : "FAILED");
+	}
+
+	void Report(const char *name, bool passed, size_t count)
+	{
+		failures += !passed;
+		std::printf("%-40s %zu %s\n", name, count, passed ? "" : "FAILED");
+	}
+
+	float Difference(vec3 a, vec3 b)
+	{
+		vec3 d = a - b;
+		return std::max(std::max(std::abs(d.x), std::abs(d.y)), std::abs(d.z));
+	}
+
+	//Like TubeMesh::Benchmark: a helix, where sliding a sample along the axis barely turns the tangents
+	std::vector<vec3> Helix()
+	{
+		std::vector<vec3> curve(SampleCount);
+		for (size_t i = 0; i < SampleCount; ++i) {
+			float t = i * 0.01f;
+			curve[i] = vec3(std::cos(t), std::sin(t), t * 0.05f);
+		}
+		return curve;
+	}
+
+	//Largest difference of positions, normals and frames, infinite if the topology differs
+	float Compare(const TubeMesh &tube, const TubeMesh &fresh)
+	{
+		if (tube.Vertices().size() != fresh.Vertices().size() || tube.Indices() != fresh.Indices() ||
+			tube.Frames().size() != fresh.Frames().size())
+			return INFINITY;
+		float worst = 0.f;
+		for (size_t i = 0; i < tube.Vertices().size(); ++i) {
+			const TubeMesh::Vertex &a = tube.Vertices()[i], &b = fresh.Vertices()[i];
+			worst = std::max(worst, Difference(a.position, b.position));
+			worst = std::max(worst, Difference(a.normal, b.normal));
+			worst = std::max(worst, std::abs(a.texCoord.x - b.texCoord.x) + std::abs(a.texCoord.y - b.texCoord.y));
+		}
+		for (size_t i = 0; i < tube.Frames().size(); ++i) {
+			const CurveFrame &a = tube.Frames()[i], &b = fresh.Frames()[i];
+			worst = std::max(worst, Difference(a.tangent, b.tangent));
+			worst = std::max(worst, Difference(a.normal, b.normal));
+			worst = std::max(worst, Difference(a.binormal, b.binormal));
+		}
+		return worst;
+	}
+
+	void CheckEdits(const char *name, TubeMesh::Shape shape, std::mt19937 &rng)
+	{
+		//The moves kink the first half, a slide close to a kink would turn the frames after it as well
+		std::uniform_int_distribution<size_t> pickMove(1, SampleCount / 2 - 1);
+		std::uniform_int_distribution<size_t> pickSlide(SampleCount / 2 + 10, SampleCount - 2);
+		std::uniform_real_distribution<float> slide(-1e-4f, 1e-4f);
+		std::uniform_real_distribution<float> nudge(-0.05f, 0.05f);
+		std::vector<vec3> curve = Helix();
+		TubeMesh tube(shape);
+		tube.Update(curve);
+		bool full = tube.ringsRebuilt == SampleCount;
+
+		//Local slides along the axis and a few moves that turn the frames behind them
+		size_t maxLocalRings = 0;
+		for (int edit = 0; edit < Edits; ++edit) {
+			if (edit % 4 == 0) {
+				size_t i = pickMove(rng);
+				curve[i] += vec3(nudge(rng), nudge(rng), nudge(rng));
+				tube.Update(curve);
+				continue;
+			}
+			size_t i = pickSlide(rng);
+			curve[i] += vec3(0, 0, slide(rng));
+			tube.Update(curve);
+			maxLocalRings = std::max(maxLocalRings, tube.ringsRebuilt);
+		}
+		TubeMesh fresh(shape);
+		fresh.Update(curve);
+
+		char line[96];
+		std::snprintf(line, sizeof(line), "%s: Update = fresh TubeMesh", name);
+		float difference = Compare(tube, fresh);
+		Report(line, full && difference <= Tolerance, difference);
+
+		std::snprintf(line, sizeof(line), "%s: rings of a local edit", name);
+		Report(line, maxLocalRings > 0 && maxLocalRings <= 4, maxLocalRings);
+
+		//Bending near the start turns every frame after it
+		size_t bend = SampleCount / 10;
+		curve[bend] += vec3(0.5f, 0, 0);
+		tube.Update(curve);
+		size_t bendRings = tube.ringsRebuilt;
+		fresh.Update(curve);
+		std::snprintf(line, sizeof(line), "%s: rings of a bend", name);
+		Report(line, bendRings >= SampleCount - bend, bendRings);
+
+		tube.Update(curve);
+		std::snprintf(line, sizeof(line), "%s: nothing moved, no rings", name);
+		Report(line, tube.ringsRebuilt == 0 && Compare(tube, fresh) <= Tolerance);
+
+		//Another sample count rebuilds everything
+		curve.pop_back();
+		tube.Update(curve);
+		TubeMesh shorter(shape);
+		shorter.Update(curve);
+		std::snprintf(line, sizeof(line), "%s: one sample less, rebuilt", name);
+		Report(line, tube.ringsRebuilt == SampleCount - 1 && Compare(tube, shorter) == 0.f);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(23);
+	CheckEdits("Tube", TubeMesh::Tube, rng);
+	CheckEdits("Ribbon", TubeMesh::Ribbon, rng);
+
+	std::printf(failures ? "TubeMeshTest: %d failed\n" : "TubeMeshTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
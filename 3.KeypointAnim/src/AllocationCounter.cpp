@@ -0,0 +1,48 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+	thread_local size_t allocations = 0;
+
+	void* Allocate(size_t size)
+	{
+		++allocations;
+		if (size == 0)
+			size = 1;
+		for (;;) {
+			if (void *p = std::malloc(size))
+				return p;
+			std::new_handler handler = std::get_new_handler();
+			if (!handler)
+				throw std::bad_alloc();
+			handler();
+		}
+	}
+
+	void* AllocateNoThrow(size_t size) noexcept
+	{
+		try {
+			return Allocate(size);
+		}
+		catch (const std::bad_alloc&) {
+			return nullptr;
+		}
+	}
+}
+
+size_t AllocationCounter::Count()
+{
+	return allocations;
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return AllocateNoThrow(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+
+//Counts the calls of the global operator new. AllocationCounter.cpp replaces it for the whole program, so a stretch of code
+//can be checked for heap allocations by comparing Count() before and after it. The count is per thread, allocations of
+//the thread pool or of a LOD build running meanwhile do not show up in the render thread's count
+namespace AllocationCounter {
+
+	size_t Count();
+}
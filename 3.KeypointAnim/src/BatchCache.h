@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <map>
+
+//The batches of one mesh, one for every program it is drawn with. Replacing the program of a batch rebuilds its VAO,
+//so a batch is kept for as long as the mesh lives and every later frame gets the same object back.
+//Program and Batch are gl::GlslProgRef and gl::BatchRef in the app
+template<typename Program, typename Batch>
+class BatchCache {
+public:
+	//create(prog) builds the batch the first time prog is seen
+	template<typename Create>
+	const Batch& For(const Program &prog, const Create &create)
+	{
+		auto found = batches.find(prog);
+		if (found != batches.end())
+			return found->second;
+		return batches[prog] = create(prog);
+	}
+	size_t Size() const { return batches.size(); }
+
+private:
+	std::map<Program, Batch> batches;
+};
@@ -0,0 +1,245 @@
+#include "CurveDeformer.h"
+#include "Deformations.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+	const size_t Grain = 4096;	//Vertices per chunk handed to a worker
+
+	//The table entries on both sides of Lanes vertices, gathered into structure-of-arrays form
+	struct LaneEntries {
+		float position[3][CurveDeformer::Lanes];
+		float normal[3][CurveDeformer::Lanes];
+		float binormal[3][CurveDeformer::Lanes];
+	};
+}
+
+//Resamples the curve at tableSize equal arc length steps. The frames are interpolated between the samples and made
+//perpendicular to the interpolated tangent again
+void CurveDeformer::SetCurve(const std::vector<vec3> &samples)
+{
+	++tableBuilds;
+	uploaded = false;
+	CurveFrames::RemoveRepeats(samples, points);
+	if (points.size() < 2 || tableSize < 2) {
+		table.clear();
+		texels.clear();
+		length = 0.f;
+		return;
+	}
+	CurveFrames::Tangents(points, tangents);
+	CurveFrames::RotationMinimizing(points, tangents, frames);
+
+	size_t n = points.size();
+	arcLengths.resize(n);
+	arcLengths[0] = 0.f;
+	for (size_t i = 1; i < n; ++i)
+		arcLengths[i] = arcLengths[i - 1] + distance(points[i - 1], points[i]);
+	length = arcLengths.back();
+
+	table.resize(tableSize);
+	texels.resize(table.size() * 3);
+	size_t j = 0;
+	for (int e = 0; e < tableSize; ++e) {
+		float s = length * e / (tableSize - 1);
+		while (j + 2 < n && arcLengths[j + 1] < s)
+			++j;
+		float segment = arcLengths[j + 1] - arcLengths[j];
+		float f = segment > 0 ? std::min(std::max((s - arcLengths[j]) / segment, 0.f), 1.f) : 0.f;
+
+		vec3 tangent = normalize(mix(tangents[j], tangents[j + 1], f));
+		vec3 normal = mix(frames[j].normal, frames[j + 1].normal, f);
+		normal = normalize(normal - dot(normal, tangent) * tangent);
+		Entry &entry = table[e];
+		entry.position = mix(points[j], points[j + 1], f);
+		entry.normal = normal;
+		entry.binormal = cross(tangent, normal);
+		texels[e * 3] = vec4(entry.position, 1);
+		texels[e * 3 + 1] = vec4(entry.normal, 0);
+		texels[e * 3 + 2] = vec4(entry.binormal, 0);
+	}
+}
+
+//Mirrored by alongCurve in Shaders::CurveLibrary
+vec3 CurveDeformer::Deform(vec3 pos, float k, vec3 meshMin, vec3 meshMax, mat3 *jacobian) const
+{
+	if (table.empty()) {
+		if (jacobian)
+			*jacobian = mat3(1.f);
+		return pos;
+	}
+	int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+	float extent = meshMax[axis] - meshMin[axis];
+	float scale = extent > 0 ? (table.size() - 1) / extent : 0.f;
+	float x = std::min(std::max((pos[axis] - meshMin[axis]) * scale, 0.f), (float)(table.size() - 1));
+	int i = std::min((int)x, (int)table.size() - 2);
+	float f = x - i;
+	const Entry &e0 = table[i];
+	const Entry &e1 = table[i + 1];
+
+	vec3 center = (meshMin + meshMax) * 0.5f;
+	float u = pos[a1] - center[a1];
+	float v = pos[a2] - center[a2];
+	vec3 normal = mix(e0.normal, e1.normal, f);
+	vec3 binormal = mix(e0.binormal, e1.binormal, f);
+	vec3 laid = mix(e0.position, e1.position, f) + u * normal + v * binormal;
+	if (jacobian) {
+		mat3 J(0.f);
+		J[axis] = scale * (e1.position - e0.position + u * (e1.normal - e0.normal) + v * (e1.binormal - e0.binormal));
+		J[a1] = normal;
+		J[a2] = binormal;
+		*jacobian = (1 - k) * mat3(1.f) + k * J;
+	}
+	return mix(pos, laid, k);
+}
+
+void CurveDeformer::Deform(const vec3 *positions, size_t count, float k, vec3 meshMin, vec3 meshMax, vec3 *out,
+						   const vec3 *normals, vec3 *outNormals, ThreadPool &pool) const
+{
+	pool.ParallelFor(count, Grain, [&](size_t begin, size_t end) {
+		DeformRange(positions, k, meshMin, meshMax, out, normals, outNormals, begin, end);
+	});
+}
+
+void CurveDeformer::DeformRange(const vec3 *positions, float k, vec3 meshMin, vec3 meshMax, vec3 *out,
+								const vec3 *normals, vec3 *outNormals, size_t begin, size_t end) const
+{
+	const int L = Lanes;
+	bool withNormals = normals && outNormals;
+	if (table.empty()) {
+		std::copy(positions + begin, positions + end, out + begin);
+		if (withNormals)
+			std::copy(normals + begin, normals + end, outNormals + begin);
+		return;
+	}
+	int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+	float extent = meshMax[axis] - meshMin[axis];
+	float scale = extent > 0 ? (table.size() - 1) / extent : 0.f;
+	float last = (float)(table.size() - 1);
+	int lastSegment = (int)table.size() - 2;
+	vec3 center = (meshMin + meshMax) * 0.5f;
+
+	float x[L], f[L], u[L], v[L];
+	int index[L];
+	LaneEntries e0, e1;
+	float laid[3][L];
+	float normal[3][L];
+	float binormal[3][L];
+	float along[3][L];		//Derivative along the axis, the first Jacobian column
+
+	for (size_t block = begin; block < end; block += L) {
+		int n = (int)std::min((size_t)L, end - block);
+
+		//Load, a partial block repeats its last vertex
+		for (int l = 0; l < L; ++l) {
+			const vec3 &p = positions[block + std::min(l, n - 1)];
+			x[l] = p[axis] - meshMin[axis];
+			u[l] = p[a1] - center[a1];
+			v[l] = p[a2] - center[a2];
+		}
+		for (int l = 0; l < L; ++l)
+			x[l] = std::min(std::max(x[l] * scale, 0.f), last);
+		for (int l = 0; l < L; ++l) {
+			index[l] = std::min((int)x[l], lastSegment);
+			f[l] = x[l] - index[l];
+		}
+
+		//The gather is the only part that works lane by lane
+		for (int l = 0; l < L; ++l) {
+			const Entry &lo = table[index[l]];
+			const Entry &hi = table[index[l] + 1];
+			for (int c = 0; c < 3; ++c) {
+				e0.position[c][l] = lo.position[c];
+				e0.normal[c][l] = lo.normal[c];
+				e0.binormal[c][l] = lo.binormal[c];
+				e1.position[c][l] = hi.position[c];
+				e1.normal[c][l] = hi.normal[c];
+				e1.binormal[c][l] = hi.binormal[c];
+			}
+		}
+
+		for (int c = 0; c < 3; ++c)
+			for (int l = 0; l < L; ++l) {
+				normal[c][l] = e0.normal[c][l] + f[l] * (e1.normal[c][l] - e0.normal[c][l]);
+				binormal[c][l] = e0.binormal[c][l] + f[l] * (e1.binormal[c][l] - e0.binormal[c][l]);
+				laid[c][l] = e0.position[c][l] + f[l] * (e1.position[c][l] - e0.position[c][l]) + u[l] * normal[c][l] + v[l] * binormal[c][l];
+			}
+		if (withNormals) {
+			for (int c = 0; c < 3; ++c)
+				for (int l = 0; l < L; ++l)
+					along[c][l] = scale * (e1.position[c][l] - e0.position[c][l] + u[l] * (e1.normal[c][l] - e0.normal[c][l])
+										   + v[l] * (e1.binormal[c][l] - e0.binormal[c][l]));
+		}
+
+		for (int l = 0; l < n; ++l) {
+			out[block + l] = mix(positions[block + l], vec3(laid[0][l], laid[1][l], laid[2][l]), k);
+			if (withNormals) {
+				mat3 J(0.f);
+				J[axis] = vec3(along[0][l], along[1][l], along[2][l]);
+				J[a1] = vec3(normal[0][l], normal[1][l], normal[2][l]);
+				J[a2] = vec3(binormal[0][l], binormal[1][l], binormal[2][l]);
+				outNormals[block + l] = Deformations::TransformNormal((1 - k) * mat3(1.f) + k * J, normals[block + l]);
+			}
+		}
+	}
+}
+
+std::vector<vec3> CurveDeformer::SampleCurve(size_t sampleCount, float phase)
+{
+	const float Pi = 3.14159f;
+	std::vector<vec3> samples(sampleCount);
+	for (size_t i = 0; i < sampleCount; ++i) {
+		float t = sampleCount > 1 ? i / (float)(sampleCount - 1) : 0.f;
+		float angle = 3 * Pi * t;
+		samples[i] = vec3(2 * std::cos(angle), 3 * (t - 0.5f) + 0.3f * std::sin(4 * Pi * t + phase), 2 * std::sin(angle));
+	}
+	return samples;
+}
+
+//Lays vertexCount random points with normals along a curve of 10k samples, once on a single thread and once on the shared pool
+CurveDeformer::BenchmarkResult CurveDeformer::Benchmark(size_t vertexCount)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> box(-1.f, 1.f);
+	std::vector<vec3> positions(vertexCount);
+	std::vector<vec3> normals(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		positions[i] = vec3(box(rng) * 0.2f, box(rng), box(rng) * 0.2f);
+		normals[i] = normalize(vec3(box(rng), box(rng), box(rng)) + vec3(0, 0, 2));
+	}
+	vec3 meshMin(-0.2f, -1, -0.2f), meshMax(0.2f, 1, 0.2f);
+	std::vector<vec3> out(vertexCount), outNormals(vertexCount);
+	std::vector<vec3> curve = SampleCurve(10000);
+
+	typedef std::chrono::high_resolution_clock clock;
+	BenchmarkResult result;
+	result.vertexCount = vertexCount;
+	result.curveSamples = curve.size();
+	result.threads = ThreadPool::Shared().Size();
+
+	CurveDeformer deformer;
+	const int Builds = 10;
+	auto start = clock::now();
+	for (int b = 0; b < Builds; ++b)
+		deformer.SetCurve(curve);
+	result.tableMs = std::chrono::duration<double, std::milli>(clock::now() - start).count() / Builds;
+
+	start = clock::now();
+	deformer.DeformRange(positions.data(), 1.f, meshMin, meshMax, out.data(), normals.data(), outNormals.data(), 0, vertexCount);
+	result.singleThreadMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	start = clock::now();
+	deformer.Deform(positions.data(), vertexCount, 1.f, meshMin, meshMax, out.data(), normals.data(), outNormals.data());
+	result.multiThreadMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	result.maxError = 0.f;
+	for (size_t i = 0; i < vertexCount; i += 997) {
+		mat3 J;
+		vec3 reference = deformer.Deform(positions[i], 1.f, meshMin, meshMax, &J);
+		float error = std::max(distance(out[i], reference), distance(outNormals[i], Deformations::TransformNormal(J, normals[i])));
+		result.maxError = std::max(result.maxError, error);
+	}
+	return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "cinder/gl/gl.h"
+#include "cinder/gl/BufferTexture.h"
+#include "CurveFrames.h"
+#include "ThreadPool.h"
+#include <vector>
+
+using namespace ci;
+
+//Lays a mesh along a curve given as dense samples, like the tessellation of PointInterp::GetActiveSpline.
+//One axis of the mesh bounds is stretched over the arc length of the curve, the cross section follows its rotation
+//minimizing frames. SetCurve() resamples positions and frames at equal arc length steps into a table, so a vertex finds
+//its entry with one multiply instead of searching the arc lengths, and an edited curve costs one table rebuild however many
+//vertices follow it. The alongCurve step of a DeformerStack reads the same table from a buffer texture
+class CurveDeformer {
+public:
+	static const int Lanes = 8;
+	static const int TextureUnit = 3;	//The FFD lattice and its binding use 0 to 2
+
+	struct BenchmarkResult {
+		size_t vertexCount;
+		size_t curveSamples;
+		unsigned threads;
+		double tableMs;			//SetCurve, what a curve edit costs
+		double singleThreadMs;
+		double multiThreadMs;
+		float maxError;			//Largest deviation of the lane code from Deform()
+	};
+
+	int tableSize = 1024;		//Entries, more follow tighter bends of the curve
+	int axis = 1;				//Laid along the curve, the next axis follows the normal and the one after the binormal
+
+	void SetCurve(const std::vector<vec3> &samples);
+	bool Empty() const { return table.empty(); }
+	float Length() const { return length; }
+	int tableBuilds = 0;
+	int tableUploads = 0;
+
+	//k blends from the rest position (0) to the mesh laid along the curve (1). jacobian is column wise as in Deformations
+	vec3 Deform(vec3 pos, float k, vec3 meshMin, vec3 meshMax, mat3 *jacobian = nullptr) const;
+	//Vertices in blocks of Lanes in structure-of-arrays form like FFDDeformer, blocks are spread over pool
+	void Deform(const vec3 *positions, size_t count, float k, vec3 meshMin, vec3 meshMax, vec3 *out,
+				const vec3 *normals = nullptr, vec3 *outNormals = nullptr, ThreadPool &pool = ThreadPool::Shared()) const;
+	void DeformRange(const vec3 *positions, float k, vec3 meshMin, vec3 meshMax, vec3 *out,
+					 const vec3 *normals, vec3 *outNormals, size_t begin, size_t end) const;
+
+	//Uploads the table if SetCurve changed it and sets the uniforms of a program with an alongCurve step
+	void Bind(const gl::GlslProgRef &prog);
+	void Unbind();
+
+	//A wave laid along a helix, useful as a demo curve too
+	static std::vector<vec3> SampleCurve(size_t sampleCount, float phase = 0.f);
+	static BenchmarkResult Benchmark(size_t vertexCount);
+
+private:
+	struct Entry {
+		vec3 position;
+		vec3 normal;
+		vec3 binormal;
+	};
+
+	std::vector<Entry> table;
+	float length = 0.f;
+
+	//Scratch of SetCurve, kept to avoid allocations per edit
+	std::vector<vec3> points;
+	std::vector<vec3> tangents;
+	std::vector<CurveFrame> frames;
+	std::vector<float> arcLengths;
+
+	std::vector<vec4> texels;		//table padded to vec4 for the RGBA32F buffer texture, three per entry
+	bool uploaded = false;
+	size_t texelCapacity = 0;
+	gl::BufferObjRef tableBufRef;
+	gl::BufferTextureRef tableTexRef;
+};
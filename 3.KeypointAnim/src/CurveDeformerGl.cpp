@@ -0,0 +1,26 @@
+#include "CurveDeformer.h"
+
+//The buffer only grows, a table of the same size is re-uploaded in place
+void CurveDeformer::Bind(const gl::GlslProgRef &prog)
+{
+	if (!uploaded && !texels.empty()) {
+		if (texels.size() > texelCapacity) {
+			texelCapacity = texels.size();
+			tableBufRef = gl::BufferObj::create(GL_TEXTURE_BUFFER, texelCapacity * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
+			tableTexRef = gl::BufferTexture::create(tableBufRef, GL_RGBA32F);
+		}
+		tableBufRef->bufferSubData(0, texels.size() * sizeof(vec4), texels.data());
+		++tableUploads;
+	}
+	uploaded = true;
+	prog->uniform("curveEntries", (int)table.size());
+	prog->uniform("curveAxis", axis);
+	if (tableTexRef)
+		tableTexRef->bindTexture(TextureUnit);
+}
+
+void CurveDeformer::Unbind()
+{
+	if (tableTexRef)
+		tableTexRef->unbindTexture(TextureUnit);
+}
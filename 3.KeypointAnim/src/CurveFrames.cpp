@@ -0,0 +1,67 @@
+#include "CurveFrames.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	//A frame this close to the one it had is taken as unchanged, the rotations after it would only carry the difference on
+	const float SettleTolerance = 1e-5f;
+}
+
+namespace CurveFrames {
+
+	void Tangents(const std::vector<vec3> &points, std::vector<vec3> &tangents, size_t begin, size_t end)
+	{
+		size_t n = points.size();
+		tangents.resize(n);
+		end = std::min(end, n);
+		if (n < 2) {
+			if (n == 1)
+				tangents[0] = vec3(1, 0, 0);
+			return;
+		}
+		for (size_t i = begin; i < end; ++i)
+			tangents[i] = normalize(points[std::min(i + 1, n - 1)] - points[i > 0 ? i - 1 : 0]);
+	}
+
+	size_t RotationMinimizing(const std::vector<vec3> &points, const std::vector<vec3> &tangents, std::vector<CurveFrame> &frames,
+							  size_t begin, size_t settleFrom)
+	{
+		size_t n = points.size();
+		frames.resize(n);
+		if (n == 0)
+			return 0;
+		if (begin == 0) {
+			//Any normal works for the first frame, the axis least aligned with the tangent gives a stable one
+			vec3 t = tangents[0];
+			vec3 axis = std::abs(t.x) < std::abs(t.y) ? (std::abs(t.x) < std::abs(t.z) ? vec3(1, 0, 0) : vec3(0, 0, 1))
+													  : (std::abs(t.y) < std::abs(t.z) ? vec3(0, 1, 0) : vec3(0, 0, 1));
+			vec3 normal = normalize(cross(cross(t, axis), t));
+			frames[0] = { t, normal, cross(t, normal) };
+			begin = 1;
+		}
+
+		for (size_t i = begin; i < n; ++i) {
+			const CurveFrame &previous = frames[i - 1];
+			vec3 v1 = points[i] - points[i - 1];
+			float c1 = dot(v1, v1);
+			vec3 reflectedNormal = previous.normal - (2 / c1) * dot(v1, previous.normal) * v1;
+			vec3 reflectedTangent = previous.tangent - (2 / c1) * dot(v1, previous.tangent) * v1;
+			vec3 v2 = tangents[i] - reflectedTangent;
+			float c2 = dot(v2, v2);
+			vec3 normal = c2 > 0 ? reflectedNormal - (2 / c2) * dot(v2, reflectedNormal) * v2 : reflectedNormal;
+			CurveFrame frame = { tangents[i], normal, cross(tangents[i], normal) };
+			if (i >= settleFrom && frame.tangent == frames[i].tangent && distance2(frame.normal, frames[i].normal) < SettleTolerance * SettleTolerance)
+				return i;
+			frames[i] = frame;
+		}
+		return n;
+	}
+
+	void RemoveRepeats(const std::vector<vec3> &curve, std::vector<vec3> &points)
+	{
+		points.clear();
+		for (const vec3 &p : curve)
+			if (points.empty() || p != points.back())
+				points.push_back(p);
+	}
+}
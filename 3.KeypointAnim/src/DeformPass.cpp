@@ -0,0 +1,20 @@
+#include "DeformPass.h"
+#include "Deformations.h"
+#include "ThreadPool.h"
+
+namespace {
+	const size_t Grain = 4096;
+}
+
+void DeformPass::Emulate(const DeformerStack &stack, const DeformerStack::Context &context, const vec3 *positions,
+						 const vec3 *normals, size_t vertexCount, std::vector<vec3> &out)
+{
+	out.resize(vertexCount * 2);
+	ThreadPool::Shared().ParallelFor(vertexCount, Grain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			mat3 J;
+			out[i * 2] = stack.Apply(positions[i], context, &J);
+			out[i * 2 + 1] = Deformations::TransformNormal(J, normals[i]);
+		}
+	});
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "cinder/app/App.h"
+#include "cinder/gl/gl.h"
+#include "DeformerStack.h"
+#include <memory>
+#include <vector>
+
+using namespace ci;
+using namespace ci::app;
+
+typedef std::shared_ptr<class DeformPass> DeformPassRef;
+
+//Deforms a mesh once per frame and keeps the result in a buffer.
+//Run() captures the deformed position and normal of every vertex with transform feedback,
+//every following draw() reads that buffer together with the index buffer of the source instead of deforming again.
+class DeformPass {
+public:
+	DeformPass(const gl::VboMeshRef &source);
+
+	//Runs the program of batch once per vertex, its uniforms and textures have to be set already
+	void Run(const gl::BatchRef &batch);
+	void draw();
+
+	//CPU version of Run for a program of stack: the stack's CPU pipeline writes every vertex into out with the layout of
+	//the captured buffer, position and normal interleaved, 2 * vertexCount entries
+	static void Emulate(const DeformerStack &stack, const DeformerStack::Context &context, const vec3 *positions,
+						const vec3 *normals, size_t vertexCount, std::vector<vec3> &out);
+
+	gl::VboRef outputVboRef;
+	gl::BatchRef shadedBatchRef;
+	uint32_t vertexCount;
+};
@@ -0,0 +1,37 @@
+#include "DeformPass.h"
+#include "Shaders.h"
+
+DeformPass::DeformPass(const gl::VboMeshRef &source)
+{
+	vertexCount = source->getNumVertices();
+
+	//Interleaved position/normal, the order of the feedback varyings in Shaders.h
+	outputVboRef = gl::Vbo::create(GL_ARRAY_BUFFER, vertexCount * sizeof(vec3) * 2, nullptr, GL_DYNAMIC_COPY);
+	geom::BufferLayout layout;
+	layout.append(geom::Attrib::POSITION, 3, sizeof(vec3) * 2, 0);
+	layout.append(geom::Attrib::NORMAL, 3, sizeof(vec3) * 2, sizeof(vec3));
+	auto vboMesh = gl::VboMesh::create(vertexCount, GL_TRIANGLES, { { layout, outputVboRef } },
+									   source->getNumIndices(), source->getIndexDataType(), source->getIndexVbo());
+
+	auto progRef = Shaders::GetShadedShader();
+	progRef->uniform("lightDir", normalize(vec3(-3, 10, 0)));
+	shadedBatchRef = gl::Batch::create(vboMesh, progRef);
+}
+
+//Every vertex is deformed exactly once by drawing the vertices as points
+void DeformPass::Run(const gl::BatchRef &batch)
+{
+	gl::ScopedGlslProg scopedProg(batch->getGlslProg());
+	gl::ScopedVao scopedVao(batch->getVao());
+	gl::setDefaultShaderVars();
+	gl::ScopedState discard(GL_RASTERIZER_DISCARD, true);
+	gl::bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, outputVboRef);
+	gl::beginTransformFeedback(GL_POINTS);
+	gl::drawArrays(GL_POINTS, 0, vertexCount);
+	gl::endTransformFeedback();
+}
+
+void DeformPass::draw()
+{
+	shadedBatchRef->draw();
+}
@@ -0,0 +1,122 @@
+#include "Deformations.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Deformations {
+
+	const float Pi = 3.14159f;	//Same value as M_PI in the shader
+
+	vec3 Taper(vec3 pos, float k, vec3 min, vec3 max)
+	{
+		float s = (max.y - pos.y) / (max.y - min.y);
+		float f = k * s + (1 - k);
+		return vec3(f * pos.x, pos.y, f * pos.z);
+	}
+
+	mat3 TaperJacobian(vec3 pos, float k, vec3 min, vec3 max)
+	{
+		float s = (max.y - pos.y) / (max.y - min.y);
+		float f = k * s + (1 - k);
+		float dfdy = -k / (max.y - min.y);
+		return mat3(vec3(f, 0, 0), vec3(pos.x * dfdy, 1, pos.z * dfdy), vec3(0, 0, f));
+	}
+
+	vec3 Twist(vec3 pos, float k)
+	{
+		float cosTerm = std::cos(k * pos.y * Pi);
+		float sinTerm = std::sin(k * pos.y * Pi);
+		return vec3(pos.x * cosTerm - pos.z * sinTerm, pos.y, pos.x * sinTerm + pos.z * cosTerm);
+	}
+
+	mat3 TwistJacobian(vec3 pos, float k)
+	{
+		float cosTerm = std::cos(k * pos.y * Pi);
+		float sinTerm = std::sin(k * pos.y * Pi);
+		float dtdy = k * Pi;
+		return mat3(vec3(cosTerm, 0, sinTerm),
+					vec3(dtdy * (-pos.x * sinTerm - pos.z * cosTerm), 1, dtdy * (pos.x * cosTerm - pos.z * sinTerm)),
+					vec3(-sinTerm, 0, cosTerm));
+	}
+
+	vec3 Bend(vec3 pos, float k)
+	{
+		float z0 = -1;
+		float ymin = (1 - k) * 2 - 0.75f;
+		float ymax = 1;
+		float teta = pos.y - ymin;
+		float r = z0 - pos.z;
+		vec3 bentPos = pos;
+		if (pos.y > ymax) {
+			teta = ymax - ymin;
+			bentPos.y = ymin - (r * std::sin(teta)) + (pos.y - ymax) * std::cos(teta);
+			bentPos.z = z0 - (r * std::cos(teta)) + (pos.y - ymax) * std::sin(teta);
+		}
+		else if (pos.y >= ymin) {
+			bentPos.y = ymin - (r * std::sin(teta));
+			bentPos.z = z0 - (r * std::cos(teta));
+		}
+		return bentPos;
+	}
+
+	mat3 BendJacobian(vec3 pos, float k)
+	{
+		float z0 = -1;
+		float ymin = (1 - k) * 2 - 0.75f;
+		float ymax = 1;
+		float r = z0 - pos.z;
+		if (pos.y > ymax) {
+			float teta = ymax - ymin;
+			return mat3(vec3(1, 0, 0), vec3(0, std::cos(teta), std::sin(teta)), vec3(0, std::sin(teta), std::cos(teta)));
+		}
+		if (pos.y >= ymin) {
+			float teta = pos.y - ymin;
+			return mat3(vec3(1, 0, 0), vec3(0, -r * std::cos(teta), r * std::sin(teta)), vec3(0, std::sin(teta), std::cos(teta)));
+		}
+		return mat3(1.f);
+	}
+
+	vec3 Other(vec3 pos, float k)
+	{
+		return vec3(pos.x * std::log(1 + pos.y) * k + pos.x * (1 - k), pos.y, pos.z);
+	}
+
+	mat3 OtherJacobian(vec3 pos, float k)
+	{
+		float f = std::log(1 + pos.y) * k + (1 - k);
+		return mat3(vec3(f, 0, 0), vec3(pos.x * k / (1 + pos.y), 1, 0), vec3(0, 0, 1));
+	}
+
+	mat3 NormalMatrix(const mat3 &jacobian)
+	{
+		return mat3(cross(jacobian[1], jacobian[2]), cross(jacobian[2], jacobian[0]), cross(jacobian[0], jacobian[1]));
+	}
+
+	vec3 TransformNormal(const mat3 &jacobian, vec3 normal)
+	{
+		vec3 n = NormalMatrix(jacobian) * normal;
+		float len = length(n);
+		return len > 0.f ? n / len : normal;
+	}
+
+	mat3 FiniteDifferenceJacobian(const std::function<vec3(vec3)> &deform, vec3 pos, float h)
+	{
+		mat3 jacobian;
+		for (int a = 0; a < 3; ++a) {
+			vec3 offset(0, 0, 0);
+			offset[a] = h;
+			jacobian[a] = (deform(pos + offset) - deform(pos - offset)) / (2 * h);
+		}
+		return jacobian;
+	}
+
+	float MaxJacobianError(const std::function<vec3(vec3)> &deform, const std::function<mat3(vec3)> &jacobian, vec3 pos, float h)
+	{
+		mat3 numeric = FiniteDifferenceJacobian(deform, pos, h);
+		mat3 analytic = jacobian(pos);
+		float error = 0.f;
+		for (int a = 0; a < 3; ++a)
+			for (int b = 0; b < 3; ++b)
+				error = std::max(error, std::abs(numeric[a][b] - analytic[a][b]));
+		return error;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "cinder/Vector.h"
+#include "cinder/Matrix.h"
+#include <functional>
+
+using namespace ci;
+
+//CPU versions of the deformations in Shaders.h together with their Jacobians.
+//A Jacobian is stored column wise: column a is the derivative of the deformed position along axis a.
+namespace Deformations {
+
+	vec3 Taper(vec3 pos, float k, vec3 min, vec3 max);
+	vec3 Twist(vec3 pos, float k);
+	vec3 Bend(vec3 pos, float k);
+	vec3 Other(vec3 pos, float k);
+
+	mat3 TaperJacobian(vec3 pos, float k, vec3 min, vec3 max);
+	mat3 TwistJacobian(vec3 pos, float k);
+	mat3 BendJacobian(vec3 pos, float k);
+	mat3 OtherJacobian(vec3 pos, float k);
+
+	//Maps a rest normal through the Jacobian. Uses the cofactor matrix (det(J) * J^-T),
+	//which matches the orientation of the cross product normals the geometry shader used to compute
+	mat3 NormalMatrix(const mat3 &jacobian);
+	vec3 TransformNormal(const mat3 &jacobian, vec3 normal);
+
+	//Central differences, used to verify the analytic Jacobians
+	mat3 FiniteDifferenceJacobian(const std::function<vec3(vec3)> &deform, vec3 pos, float h = 1e-3f);
+	float MaxJacobianError(const std::function<vec3(vec3)> &deform, const std::function<mat3(vec3)> &jacobian, vec3 pos, float h = 1e-3f);
+}
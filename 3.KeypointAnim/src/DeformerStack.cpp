@@ -0,0 +1,173 @@
+#include "DeformerStack.h"
+#include "Deformations.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <set>
+
+namespace {
+	const char* const BuiltinNames[] = { "taper", "twist", "bend", "otherDeformation" };
+	const size_t Grain = 4096;
+}
+
+Deformer Deformer::Custom(const std::string &name, const std::string &glsl,
+						  const std::function<vec3(vec3, float)> &deform, const std::function<mat3(vec3, float)> &jacobian, float k)
+{
+	Deformer deformer(custom, k);
+	deformer.name = name;
+	deformer.glsl = glsl;
+	deformer.cpuDeform = deform;
+	deformer.cpuJacobian = jacobian;
+	return deformer;
+}
+
+//Two stacks with the same signature compile to the same shader, custom deformers are identified by name
+std::string DeformerStack::Signature() const
+{
+	std::string signature;
+	for (const Deformer &d : deformers) {
+		if (!signature.empty())
+			signature += "|";
+		if (d.type == Deformer::ffd)
+			signature += "ffd";
+		else if (d.type == Deformer::curve)
+			signature += "curve";
+		else if (d.type == Deformer::custom)
+			signature += "custom:" + d.name;
+		else
+			signature += BuiltinNames[d.type];
+	}
+	return signature;
+}
+
+void DeformerStack::SetUniforms(DeformerUniforms &target, vec3 meshMin, vec3 meshMax) const
+{
+	if (deformers.empty())
+		return;
+	//On the stack, this runs for every draw
+	float k[MaxDeformers];
+	int count = (int)std::min(deformers.size(), (size_t)MaxDeformers);
+	for (int i = 0; i < count; ++i)
+		k[i] = deformers[i].k;
+	target.Uniform("deformK", k, count);
+	if (UsesBounds()) {
+		target.Uniform("meshMin", meshMin);
+		target.Uniform("meshMax", meshMax);
+	}
+}
+
+void DeformerStack::SetStrength(float k)
+{
+	for (Deformer &d : deformers)
+		d.k = k;
+}
+
+bool DeformerStack::Valid() const
+{
+	return deformers.size() <= (size_t)MaxDeformers;
+}
+
+bool DeformerStack::UsesLattice() const
+{
+	for (const Deformer &d : deformers)
+		if (d.type == Deformer::ffd)
+			return true;
+	return false;
+}
+
+bool DeformerStack::UsesCurve() const
+{
+	for (const Deformer &d : deformers)
+		if (d.type == Deformer::curve)
+			return true;
+	return false;
+}
+
+bool DeformerStack::UsesBuiltins() const
+{
+	for (const Deformer &d : deformers)
+		if (d.type <= Deformer::other)
+			return true;
+	return false;
+}
+
+bool DeformerStack::UsesBounds() const
+{
+	return UsesBuiltins() || UsesCurve();
+}
+
+//The GLSL function of a step, its Jacobian is the same name with Jacobian appended
+std::string DeformerStack::FunctionName(const Deformer &d)
+{
+	if (d.type == Deformer::custom)
+		return d.name;
+	if (d.type == Deformer::curve)
+		return "alongCurve";
+	return BuiltinNames[d.type];
+}
+
+vec3 DeformerStack::Apply(vec3 pos, const Context &context, mat3 *jacobian) const
+{
+	mat3 J(1.f);
+	for (const Deformer &d : deformers) {
+		mat3 Ji(1.f);
+		switch (d.type) {
+		case Deformer::taper:
+			if (jacobian)
+				Ji = Deformations::TaperJacobian(pos, d.k, context.meshMin, context.meshMax);
+			pos = Deformations::Taper(pos, d.k, context.meshMin, context.meshMax);
+			break;
+		case Deformer::twist:
+			if (jacobian)
+				Ji = Deformations::TwistJacobian(pos, d.k);
+			pos = Deformations::Twist(pos, d.k);
+			break;
+		case Deformer::bend:
+			if (jacobian)
+				Ji = Deformations::BendJacobian(pos, d.k);
+			pos = Deformations::Bend(pos, d.k);
+			break;
+		case Deformer::other:
+			if (jacobian)
+				Ji = Deformations::OtherJacobian(pos, d.k);
+			pos = Deformations::Other(pos, d.k);
+			break;
+		case Deformer::ffd:
+			if (jacobian)
+				pos = context.lattice->Evaluate(pos, context.latticePoints, Ji);
+			else
+				pos = context.lattice->Evaluate(pos, context.latticePoints);
+			break;
+		case Deformer::curve:
+			if (context.curve)
+				pos = context.curve->Deform(pos, d.k, context.meshMin, context.meshMax, jacobian ? &Ji : nullptr);
+			break;
+		case Deformer::custom:
+			if (jacobian)
+				Ji = d.cpuJacobian(pos, d.k);
+			pos = d.cpuDeform(pos, d.k);
+			break;
+		}
+		J = Ji * J;
+	}
+	if (jacobian)
+		*jacobian = J;
+	return pos;
+}
+
+//Vertices are independent, so the arrays are split over the shared ThreadPool like in FFDDeformer
+void DeformerStack::Apply(const vec3 *positions, const vec3 *normals, size_t count, const Context &context,
+						  vec3 *outPositions, vec3 *outNormals) const
+{
+	bool withNormals = normals && outNormals;
+	ThreadPool::Shared().ParallelFor(count, Grain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			if (withNormals) {
+				mat3 J;
+				outPositions[i] = Apply(positions[i], context, &J);
+				outNormals[i] = Deformations::TransformNormal(J, normals[i]);
+			}
+			else
+				outPositions[i] = Apply(positions[i], context);
+		}
+	});
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "cinder/gl/gl.h"
+#include "CurveDeformer.h"
+#include "Lattice.h"
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+using namespace ci;
+
+//One step of a DeformerStack together with its strength k.
+//taper, twist, bend and other are the functions of Shaders::DeformationLibrary and Deformations, ffd is the lattice of a Volume,
+//curve lays the mesh along the curve of a CurveDeformer (k blends from the rest shape).
+//A custom deformer brings the GLSL functions <name>(vec3 pos, float k) and <name>Jacobian(vec3 pos, float k) plus their CPU versions
+struct Deformer {
+	enum deformerType { taper, twist, bend, other, ffd, curve, custom };
+
+	Deformer(deformerType type = taper, float k = 0.f) : type(type), k(k) {}
+	static Deformer Custom(const std::string &name, const std::string &glsl,
+						   const std::function<vec3(vec3, float)> &deform, const std::function<mat3(vec3, float)> &jacobian, float k = 0.f);
+
+	deformerType type;
+	float k;										//Ignored by ffd, the lattice itself is the parameter
+	std::string name;								//custom only, also identifies the GLSL in the program cache
+	std::string glsl;
+	std::function<vec3(vec3, float)> cpuDeform;
+	std::function<mat3(vec3, float)> cpuJacobian;
+};
+
+//Receives what DeformerStack::SetUniforms uploads, the GlslProg of the stack in the app
+class DeformerUniforms {
+public:
+	virtual ~DeformerUniforms() {}
+	virtual void Uniform(const char *name, const float *values, int count) = 0;
+	virtual void Uniform(const char *name, vec3 value) = 0;
+};
+
+//An ordered list of deformers, the first one sees the rest position.
+//Each stack compiles into its own vertex shader with the calls unrolled in order, so nothing branches per vertex.
+//Stacks with the same Signature() generate the same source and so share one program.
+class DeformerStack {
+public:
+	//SetUniforms uploads the strengths from a fixed array of this size, Mesh::SetStack rejects longer stacks.
+	//The mode stacks use at most 2
+	static const int MaxDeformers = 16;
+	//Everything besides k that the deformers read, the CPU side of the uniforms
+	struct Context {
+		vec3 meshMin;
+		vec3 meshMax;
+		const Lattice *lattice = nullptr;		//ffd only
+		const vec3 *latticePoints = nullptr;	//In lattice order, see Volume::GetLatticePoints
+		const CurveDeformer *curve = nullptr;	//curve only
+	};
+
+	DeformerStack() {}
+	DeformerStack(std::initializer_list<Deformer> deformers) : deformers(deformers) {}
+
+	std::vector<Deformer> deformers;
+
+	std::string Signature() const;
+	//packed reads the vertices as PackedVertices, the program then needs the quantMin and quantExtent uniforms
+	std::string VertexShaderSource(bool packed = false) const;
+	gl::GlslProgRef GetProgram(bool packed = false) const;
+	//Uploads the strengths as the deformK array and the bounds the built in deformers need
+	void SetUniforms(const gl::GlslProgRef &prog, vec3 meshMin, vec3 meshMax) const;
+	void SetUniforms(DeformerUniforms &target, vec3 meshMin, vec3 meshMax) const;
+	void SetStrength(float k);
+	bool Valid() const;					//At most MaxDeformers steps
+	bool UsesLattice() const;			//The program expects the lattice uniforms, see Volume::BindLattice
+	bool UsesCurve() const;				//The program expects the curve table, see CurveDeformer::Bind
+
+	//CPU pipeline, matches the generated shader. jacobian receives the product of all Jacobians
+	vec3 Apply(vec3 pos, const Context &context, mat3 *jacobian = nullptr) const;
+	void Apply(const vec3 *positions, const vec3 *normals, size_t count, const Context &context,
+			   vec3 *outPositions, vec3 *outNormals = nullptr) const;
+
+private:
+	bool UsesBuiltins() const;
+	bool UsesBounds() const;
+	static std::string FunctionName(const Deformer &d);
+};
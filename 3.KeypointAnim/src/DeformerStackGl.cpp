@@ -0,0 +1,83 @@
+#include "DeformerStack.h"
+#include "Shaders.h"
+#include <set>
+
+//Only the libraries the stack uses are included, main() calls the deformers one after another
+std::string DeformerStack::VertexShaderSource(bool packed) const
+{
+	std::string source = "#version 150\n";
+	if (UsesBounds())
+		source += Shaders::BoundsLibrary;
+	if (UsesBuiltins())
+		source += Shaders::DeformationLibrary;
+	if (UsesLattice())
+		source += Shaders::FFDLibrary;
+	if (UsesCurve())
+		source += Shaders::CurveLibrary;
+	std::set<std::string> customs;
+	for (const Deformer &d : deformers)
+		if (d.type == Deformer::custom && customs.insert(d.name).second)
+			source += "\n" + d.glsl + "\n";
+	source += Shaders::NormalLibrary;
+	source += Shaders::VertexInput(packed);
+
+	source += "\nuniform mat4 ciModelViewProjection;\n"
+			  "out vec3 position;\n"
+			  "out vec3 normal;\n";
+	if (!deformers.empty())
+		source += "uniform float deformK[" + std::to_string(deformers.size()) + "];\n";
+
+	source += "void main(void) {\n"
+			  "\tvec3 p = restPosition();\n"
+			  "\tmat3 J = mat3(1.0);\n"
+			  "\tmat3 Ji;\n";
+	for (size_t i = 0; i < deformers.size(); ++i) {
+		const Deformer &d = deformers[i];
+		if (d.type == Deformer::ffd) {
+			source += "\tp = transformPoint(p, Ji);\n"
+					  "\tJ = Ji * J;\n";
+			continue;
+		}
+		std::string fn = FunctionName(d);
+		std::string k = "deformK[" + std::to_string(i) + "]";
+		//The Jacobian has to be taken at the input of the deformer, so before p is overwritten
+		source += "\tJ = " + fn + "Jacobian(p, " + k + ") * J;\n"
+				  "\tp = " + fn + "(p, " + k + ");\n";
+	}
+	source += "\tposition = p;\n"
+			  "\tnormal = transformNormal(J, restNormal());\n"
+			  "\tgl_Position = ciModelViewProjection * vec4(p, 1);\n"
+			  "}\n";
+	return source;
+}
+
+//Generating the source is cheap, the compile is avoided by the program cache of Shaders
+gl::GlslProgRef DeformerStack::GetProgram(bool packed) const
+{
+	auto prog = Shaders::GetDeformingShader(VertexShaderSource(packed));
+	if (UsesLattice()) {
+		prog->uniform("controlPoints", 0);
+		prog->uniform("useBinding", 0);
+	}
+	if (UsesCurve())
+		prog->uniform("curveTable", CurveDeformer::TextureUnit);
+	return prog;
+}
+
+namespace {
+	class ProgramUniforms : public DeformerUniforms {
+	public:
+		ProgramUniforms(const gl::GlslProgRef &prog) : prog(prog) {}
+		void Uniform(const char *name, const float *values, int count) override { prog->uniform(name, values, count); }
+		void Uniform(const char *name, vec3 value) override { prog->uniform(name, value); }
+
+	private:
+		const gl::GlslProgRef &prog;
+	};
+}
+
+void DeformerStack::SetUniforms(const gl::GlslProgRef &prog, vec3 meshMin, vec3 meshMax) const
+{
+	ProgramUniforms target(prog);
+	SetUniforms(target, meshMin, meshMax);
+}
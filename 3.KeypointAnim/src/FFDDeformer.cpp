@@ -0,0 +1,275 @@
+#include "FFDDeformer.h"
+#include "Deformations.h"
+#include <chrono>
+#include <random>
+
+namespace {
+	const size_t Grain = 4096;	//Vertices per chunk handed to a worker
+
+	//Lattice::Weights for Lanes values at once, dw holds the derivatives
+	struct BlockWeights {
+		int first[FFDDeformer::Lanes];
+		float w[Lattice::MaxResolution][FFDDeformer::Lanes];
+		float dw[Lattice::MaxResolution][FFDDeformer::Lanes];
+	};
+
+	void BlockAxisWeights(const Lattice &lattice, int axis, const float *x, BlockWeights &out)
+	{
+		const int L = FFDDeformer::Lanes;
+		int res = lattice.resolution[axis];
+		float lo = lattice.boxMin[axis];
+		float invExtent = 1.f / (lattice.boxMax[axis] - lattice.boxMin[axis]);
+
+		if (lattice.basis == Lattice::bspline) {
+			float u[L];
+			float dudx = (res - 3) * invExtent;
+			for (int l = 0; l < L; ++l) {
+				float c = (x[l] - lo) * invExtent * (res - 3);
+				int cell = std::min(std::max((int)std::floor(c), 0), res - 4);
+				out.first[l] = cell;
+				u[l] = c - cell;
+			}
+			for (int l = 0; l < L; ++l) {
+				float u2 = u[l] * u[l];
+				float u3 = u2 * u[l];
+				float v = 1 - u[l];
+				out.w[0][l] = v * v * v / 6.f;
+				out.w[1][l] = (3 * u3 - 6 * u2 + 4) / 6.f;
+				out.w[2][l] = (-3 * u3 + 3 * u2 + 3 * u[l] + 1) / 6.f;
+				out.w[3][l] = u3 / 6.f;
+				out.dw[0][l] = -v * v / 2.f * dudx;
+				out.dw[1][l] = (3 * u2 - 4 * u[l]) / 2.f * dudx;
+				out.dw[2][l] = (-3 * u2 + 2 * u[l] + 1) / 2.f * dudx;
+				out.dw[3][l] = u2 / 2.f * dudx;
+			}
+			return;
+		}
+
+		float s[L];
+		for (int l = 0; l < L; ++l) {
+			s[l] = (x[l] - lo) * invExtent;
+			out.first[l] = 0;
+			out.w[0][l] = 1.f;
+		}
+		for (int d = 1; d < res; ++d) {
+			if (d == res - 1) {
+				for (int i = 0; i < res; ++i)
+					for (int l = 0; l < L; ++l)
+						out.dw[i][l] = d * ((i > 0 ? out.w[i - 1][l] : 0.f) - (i < d ? out.w[i][l] : 0.f)) * invExtent;
+			}
+			for (int l = 0; l < L; ++l)
+				out.w[d][l] = out.w[d - 1][l] * s[l];
+			for (int i = d - 1; i > 0; --i)
+				for (int l = 0; l < L; ++l)
+					out.w[i][l] = out.w[i][l] * (1 - s[l]) + out.w[i - 1][l] * s[l];
+			for (int l = 0; l < L; ++l)
+				out.w[0][l] *= 1 - s[l];
+		}
+	}
+}
+
+FFDDeformer::FFDDeformer(ThreadPool &pool)
+	: pool(pool)
+{
+}
+
+void FFDDeformer::Deform(const Lattice &lattice, const mat4 &transform, const vec3 *latticePoints,
+						 const vec3 *positions, size_t count, vec3 *out,
+						 const vec3 *normals, vec3 *outNormals)
+{
+	pool.ParallelFor(count, Grain, [&](size_t begin, size_t end) {
+		DeformRange(lattice, transform, latticePoints, positions, out, normals, outNormals, begin, end);
+	});
+}
+
+void FFDDeformer::DeformRange(const Lattice &lattice, const mat4 &transform, const vec3 *latticePoints,
+							  const vec3 *positions, vec3 *out, const vec3 *normals, vec3 *outNormals,
+							  size_t begin, size_t end)
+{
+	const int L = Lanes;
+	bool shared = lattice.basis == Lattice::bernstein;	//All vertices use the same points, no gather needed
+	bool withNormals = normals && outNormals;
+	int supportX = shared ? lattice.resolution.x : 4;
+	int supportY = shared ? lattice.resolution.y : 4;
+	int supportZ = shared ? lattice.resolution.z : 4;
+	mat3 linear = mat3(transform);
+
+	float px[L], py[L], pz[L];
+	float o[3][L];			//Deformed position
+	float jac[3][3][L];		//Jacobian column, component, lane
+	BlockWeights wx, wy, wz;
+
+	for (size_t block = begin; block < end; block += L) {
+		int n = (int)std::min((size_t)L, end - block);
+
+		//Load and transform, a partial block repeats its last vertex
+		for (int l = 0; l < L; ++l) {
+			vec4 p = transform * vec4(positions[block + std::min(l, n - 1)], 1);
+			px[l] = p.x;
+			py[l] = p.y;
+			pz[l] = p.z;
+			for (int c = 0; c < 3; ++c) {
+				o[c][l] = 0.f;
+				jac[0][c][l] = jac[1][c][l] = jac[2][c][l] = 0.f;
+			}
+		}
+		BlockAxisWeights(lattice, 0, px, wx);
+		BlockAxisWeights(lattice, 1, py, wy);
+		BlockAxisWeights(lattice, 2, pz, wz);
+
+		for (int k = 0; k < supportZ; ++k) {
+			for (int j = 0; j < supportY; ++j) {
+				float wyz[L], dyz[L], wdz[L];
+				for (int l = 0; l < L; ++l) {
+					wyz[l] = wy.w[j][l] * wz.w[k][l];
+					dyz[l] = wy.dw[j][l] * wz.w[k][l];
+					wdz[l] = wy.w[j][l] * wz.dw[k][l];
+				}
+				for (int i = 0; i < supportX; ++i) {
+					float cp[3][L];
+					if (shared) {
+						vec3 p = latticePoints[lattice.Index(i, j, k)];
+						for (int l = 0; l < L; ++l) {
+							cp[0][l] = p.x;
+							cp[1][l] = p.y;
+							cp[2][l] = p.z;
+						}
+					}
+					else {
+						for (int l = 0; l < L; ++l) {
+							const vec3 &p = latticePoints[lattice.Index(wx.first[l] + i, wy.first[l] + j, wz.first[l] + k)];
+							cp[0][l] = p.x;
+							cp[1][l] = p.y;
+							cp[2][l] = p.z;
+						}
+					}
+					for (int c = 0; c < 3; ++c)
+						for (int l = 0; l < L; ++l)
+							o[c][l] += wx.w[i][l] * wyz[l] * cp[c][l];
+					if (withNormals) {
+						for (int c = 0; c < 3; ++c)
+							for (int l = 0; l < L; ++l) {
+								jac[0][c][l] += wx.dw[i][l] * wyz[l] * cp[c][l];
+								jac[1][c][l] += wx.w[i][l] * dyz[l] * cp[c][l];
+								jac[2][c][l] += wx.w[i][l] * wdz[l] * cp[c][l];
+							}
+					}
+				}
+			}
+		}
+
+		for (int l = 0; l < n; ++l) {
+			out[block + l] = vec3(o[0][l], o[1][l], o[2][l]);
+			if (withNormals) {
+				mat3 J(vec3(jac[0][0][l], jac[0][1][l], jac[0][2][l]),
+					   vec3(jac[1][0][l], jac[1][1][l], jac[1][2][l]),
+					   vec3(jac[2][0][l], jac[2][1][l], jac[2][2][l]));
+				outNormals[block + l] = Deformations::TransformNormal(J * linear, normals[block + l]);
+			}
+		}
+	}
+}
+
+void FFDDeformer::Bind(const Lattice &lattice, const mat4 &transform, const vec3 *positions, size_t count, Binding &binding)
+{
+	int stride = lattice.Support();
+	binding.stride = stride;
+	binding.indices.resize(count * stride);
+	binding.weights.resize(count * stride);
+	binding.gradients.resize(count * stride);
+	binding.linear = mat3(transform);
+
+	pool.ParallelFor(count, Grain, [&](size_t begin, size_t end) {
+		Lattice::AxisWeights wx, wy, wz, dx, dy, dz;
+		for (size_t v = begin; v < end; ++v) {
+			vec3 p = vec3(transform * vec4(positions[v], 1));
+			lattice.Weights(0, p.x, wx, &dx);
+			lattice.Weights(1, p.y, wy, &dy);
+			lattice.Weights(2, p.z, wz, &dz);
+
+			uint32_t *index = &binding.indices[v * stride];
+			float *weight = &binding.weights[v * stride];
+			vec3 *gradient = &binding.gradients[v * stride];
+			for (int k = 0; k < wz.count; ++k)
+				for (int j = 0; j < wy.count; ++j)
+					for (int i = 0; i < wx.count; ++i) {
+						*index++ = lattice.Index(wx.first + i, wy.first + j, wz.first + k);
+						*weight++ = wx.w[i] * wy.w[j] * wz.w[k];
+						*gradient++ = vec3(dx.w[i] * wy.w[j] * wz.w[k], wx.w[i] * dy.w[j] * wz.w[k], wx.w[i] * wy.w[j] * dz.w[k]);
+					}
+		}
+	});
+}
+
+void FFDDeformer::Apply(const Binding &binding, const vec3 *latticePoints, vec3 *out,
+						const vec3 *normals, vec3 *outNormals)
+{
+	int stride = binding.stride;
+	bool withNormals = normals && outNormals;
+	pool.ParallelFor(binding.VertexCount(), Grain, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			const uint32_t *index = &binding.indices[v * stride];
+			const float *weight = &binding.weights[v * stride];
+			vec3 pos(0, 0, 0);
+			for (int s = 0; s < stride; ++s)
+				pos += weight[s] * latticePoints[index[s]];
+			out[v] = pos;
+
+			if (withNormals) {
+				const vec3 *gradient = &binding.gradients[v * stride];
+				mat3 J(0.f);
+				for (int s = 0; s < stride; ++s)
+					for (int a = 0; a < 3; ++a)
+						J[a] += gradient[s][a] * latticePoints[index[s]];
+				outNormals[v] = Deformations::TransformNormal(J * binding.linear, normals[v]);
+			}
+		}
+	});
+}
+
+//Deforms vertexCount random points with a randomly disturbed lattice, once on a single thread and once on the shared pool
+FFDDeformer::BenchmarkResult FFDDeformer::Benchmark(const Lattice &lattice, size_t vertexCount)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> box(-1.f, 1.f);
+	std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+	std::vector<vec3> positions(vertexCount);
+	for (auto &p : positions)
+		p = vec3(box(rng), box(rng), box(rng));
+	std::vector<vec3> latticePoints = lattice.RestPositions();
+	for (auto &p : latticePoints)
+		p += vec3(jitter(rng), jitter(rng), jitter(rng));
+	std::vector<vec3> out(vertexCount);
+	mat4 transform(1.f);
+
+	typedef std::chrono::high_resolution_clock clock;
+	BenchmarkResult result;
+	result.vertexCount = vertexCount;
+	result.threads = ThreadPool::Shared().Size();
+
+	auto start = clock::now();
+	DeformRange(lattice, transform, latticePoints.data(), positions.data(), out.data(), nullptr, nullptr, 0, vertexCount);
+	result.singleThreadMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	FFDDeformer deformer;
+	start = clock::now();
+	deformer.Deform(lattice, transform, latticePoints.data(), positions.data(), vertexCount, out.data());
+	result.multiThreadMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	Binding binding;
+	start = clock::now();
+	deformer.Bind(lattice, transform, positions.data(), vertexCount, binding);
+	result.bindMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	std::vector<vec3> boundOut(vertexCount);
+	start = clock::now();
+	deformer.Apply(binding, latticePoints.data(), boundOut.data());
+	result.boundMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	result.maxError = 0.f;
+	for (size_t i = 0; i < vertexCount; i += 997) {
+		vec3 reference = lattice.Evaluate(positions[i], latticePoints.data());
+		result.maxError = std::max(result.maxError, std::max(length(out[i] - reference), length(boundOut[i] - reference)));
+	}
+	return result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "Lattice.h"
+#include "ThreadPool.h"
+
+//Applies an FFD lattice to vertex arrays on the CPU.
+//Vertices are processed in blocks of Lanes in structure-of-arrays form so the weight and accumulation loops vectorize,
+//blocks are spread over a ThreadPool. The result matches transformPoint of the FFD shader.
+class FFDDeformer {
+public:
+	static const int Lanes = 8;
+
+	struct BenchmarkResult {
+		size_t vertexCount;
+		unsigned threads;
+		double singleThreadMs;
+		double multiThreadMs;
+		double bindMs;			//One time cost of Bind()
+		double boundMs;			//Apply() with the precomputed weights
+		float maxError;			//Largest deviation from Lattice::Evaluate
+	};
+
+	//Per vertex (lattice index, weight) pairs. They only depend on the rest positions,
+	//so once bound, deforming is a sparse matrix times the current lattice points
+	struct Binding {
+		int stride = 0;					//Pairs per vertex, the support of the lattice
+		std::vector<uint32_t> indices;
+		std::vector<float> weights;
+		std::vector<vec3> gradients;	//d weight / d p in lattice space, gives the Jacobian for the normals
+		mat3 linear;					//Linear part of the transform the binding was made with
+
+		size_t VertexCount() const { return stride ? weights.size() / stride : 0; }
+	};
+
+	FFDDeformer(ThreadPool &pool = ThreadPool::Shared());
+
+	//latticePoints are the current control points in lattice order, transform is applied to positions first (the "mv" uniform).
+	//If normals are given, outNormals receives them mapped through the Jacobian of the deformation
+	void Deform(const Lattice &lattice, const mat4 &transform, const vec3 *latticePoints,
+				const vec3 *positions, size_t count, vec3 *out,
+				const vec3 *normals = nullptr, vec3 *outNormals = nullptr);
+
+	void Bind(const Lattice &lattice, const mat4 &transform, const vec3 *positions, size_t count, Binding &binding);
+	void Apply(const Binding &binding, const vec3 *latticePoints, vec3 *out,
+			   const vec3 *normals = nullptr, vec3 *outNormals = nullptr);
+
+	static void DeformRange(const Lattice &lattice, const mat4 &transform, const vec3 *latticePoints,
+							const vec3 *positions, vec3 *out, const vec3 *normals, vec3 *outNormals,
+							size_t begin, size_t end);
+
+	static BenchmarkResult Benchmark(const Lattice &lattice, size_t vertexCount);
+
+private:
+	ThreadPool &pool;
+};
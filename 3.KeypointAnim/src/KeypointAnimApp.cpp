@@ -1,11 +1,19 @@
 #include "cinder/app/App.h"
+#include "cinder/CinderAssert.h"
 #include "cinder/gl/gl.h"
 #include "cinder/params/Params.h"
 #include "Mesh.h"
 #include "CamControl.h"
 #include "Volume.h"
 #include "Animation.h"
+#include "FFDDeformer.h"
+#include "CurveDeformer.h"
+#include "MeshCache.h"
+#include "Simplifier.h"
+#include "PoseRecorder.h"
+#include "AllocationCounter.h"
 #include <memory>
+#include <tuple>
 
 using namespace ci;
 using namespace ci::app;
@@ -16,25 +24,59 @@ class KeypointAnimApp : public App {
 	void setup() override;
 	void mouseDown( MouseEvent event ) override;
 	void mouseDrag(MouseEvent event) override;
+	void mouseUp(MouseEvent event) override;
 	void update() override;
 	void resize() override;
 	void draw() override;
 
 	void ChangeGeom(int geomNum);
+	void ChangeLattice(int latticeNum);
+	void ImportMesh();
+	void ShowMesh();
+	std::string MeshKey(const std::string &descriptor) const;
+	void BenchmarkCpuFFD();
+	void BenchmarkCurveDeformer();
+	void BenchmarkSimplifier();
 	void SetupKeyPoints();
+	Ray MouseRay(vec2 mousePos) const;
+	bool LatticeVisible() const;
 	CameraPersp cam;
 	params::InterfaceGlRef interfaceRef;
 
-	Mesh* mesh = nullptr;
+	std::shared_ptr<Mesh> mesh;
+	MeshCache meshCache;
 	Volume* volume = nullptr;
 	Animation animation;
+	PoseRecorder recorder;
+	CurveDeformer curveDeformer;
 
-	std::vector<string> modeStrings = { "taper", "twist", "bend", "other deform" };
+	std::vector<string> modeStrings = { "taper", "twist", "bend", "other deform", "taper + twist", "bend + FFD", "along curve" };
 	std::vector<string> geomStrings = { "cylinder", "cube", "teapot" };
+	std::vector<string> latticeStrings = { "2x2x2 trilinear", "4x4x4 bernstein", "4x4x4 b-spline", "8x8x8 b-spline" };
 	int mode = 0;
 	int geomSelected = 0;
+	int latticeSelected = 0;
 	float time = 0.f;
 	bool ffd = false;
+	bool prePass = false;
+	MeshOptions meshOptions;
+	float acmrBefore = 0.f;
+	float acmrAfter = 0.f;
+	bool useLods = true;
+	int drawnTriangles = 0;
+	float lodBuildMs = 0.f;
+	bool animateLattice = true;
+	int activeControlPoint = -1;
+	bool recordLattice = false;
+	bool playRecording = false;
+	int recordedFrames = 0;
+	int recordingKB = 0;
+	double lastUpdateTime = 0;
+	bool animateCurve = true;
+	int curveTableBuilds = 0;
+	int frameAllocations = 0;		//Heap allocations of the last frame from the lattice upload to the last draw call
+	//What decides the batches and buffers a frame draws with, see draw()
+	std::tuple<const Mesh*, const Volume*, int, bool, bool, bool> lastFrameState;
 };
 
 void KeypointAnimApp::setup()
@@ -46,33 +88,132 @@ void KeypointAnimApp::setup()
 	cam.setEyePoint(vec3(0, 6, -10));
 	cam.lookAt(vec3(0, 0, 0));
 	interfaceRef = params::InterfaceGl::create(getWindow(), "Keypoint Animation Exercise", toPixels(ivec2(200, 200)));
+
+	//Compile every program the modes can switch to now, so changing mode or geometry never waits for the compiler
+	Shaders::EnableDiskCache(getAppPath() / "ShaderCache");
+	std::vector<std::string> permutations;
+	for (size_t m = 0; m < modeStrings.size(); ++m)
+		permutations.push_back(Mesh::ModeStack((int)m).VertexShaderSource());
+	Shaders::WarmUp(permutations);
+
 	interfaceRef->addParam("Mode", modeStrings, &mode).updateFn([&] {mesh->SetMode(mode); });
 	interfaceRef->addParam("Geom", geomStrings, &geomSelected).updateFn([&] {ChangeGeom(geomSelected); });
 	interfaceRef->addParam("K", &time).min(0.0f).max(1.0f).step(0.01f);
 	interfaceRef->addParam("Enable/Disable FFD", &ffd);
-	mesh = new Mesh(&geom::Cylinder().height(1).origin(vec3(0, -0.5f, 0)));
-	mesh->SetMode(0);
+	interfaceRef->addParam("Deform pre-pass", &prePass);
+	interfaceRef->addParam("Lattice", latticeStrings, &latticeSelected).updateFn([&] {ChangeLattice(latticeSelected); });
+	interfaceRef->addParam("Animate lattice", &animateLattice);
+	interfaceRef->addParam("Record lattice", &recordLattice).updateFn([&] {
+		if (recordLattice) {
+			playRecording = false;
+			recorder.Start(volume->controlPoints);
+		}
+		else
+			recorder.Stop();
+	});
+	interfaceRef->addParam("Play recording", &playRecording).updateFn([&] {
+		if (playRecording) {
+			recordLattice = false;
+			recorder.Stop();
+			recorder.Rewind();
+			animateLattice = false;
+		}
+	});
+	interfaceRef->addParam("Recorded frames", &recordedFrames, true);
+	interfaceRef->addParam("Recording KB", &recordingKB, true);
+	ChangeGeom(0);
 	volume = new Volume(*mesh);
+	volume->FitToBounds(mesh->min, mesh->max);
+	interfaceRef->addButton("Import OBJ/PLY", std::bind(&KeypointAnimApp::ImportMesh, this));
+	interfaceRef->addParam("16 bit indices", &meshOptions.allow16BitIndices);
+	interfaceRef->addParam("Optimize vertex cache", &meshOptions.optimize);
+	interfaceRef->addParam("Packed vertices", &meshOptions.packed);
+	interfaceRef->addParam("ACMR generated", &acmrBefore, true);
+	interfaceRef->addParam("ACMR uploaded", &acmrAfter, true);
+	interfaceRef->addParam("Bind FFD weights", &volume->bindWeights);
+	interfaceRef->addButton("Build LODs", [&] { mesh->BuildLods(); });
+	interfaceRef->addParam("Use LODs", &useLods);
+	interfaceRef->addParam("Drawn triangles", &drawnTriangles, true);
+	interfaceRef->addParam("LOD build ms", &lodBuildMs, true);
+	interfaceRef->addButton("Benchmark simplifier", std::bind(&KeypointAnimApp::BenchmarkSimplifier, this));
+	interfaceRef->addButton("Benchmark CPU FFD", std::bind(&KeypointAnimApp::BenchmarkCpuFFD, this));
+	interfaceRef->addParam("Animate curve", &animateCurve);
+	interfaceRef->addParam("Curve table builds", &curveTableBuilds, true);
+	interfaceRef->addButton("Benchmark curve deformer", std::bind(&KeypointAnimApp::BenchmarkCurveDeformer, this));
+	interfaceRef->addParam("Programs compiled", &Shaders::Stats().compiles, true);
+	interfaceRef->addParam("Compiles avoided", &Shaders::Stats().hits, true);
+	interfaceRef->addParam("Warmed up", &Shaders::Stats().warmedUp, true);
+	interfaceRef->addParam("Compile ms", &Shaders::Stats().compileMs, true);
+	interfaceRef->addParam("Batches built", &Mesh::batchesBuilt, true);
+	interfaceRef->addParam("Frame allocations", &frameAllocations, true);
+	interfaceRef->addParam("Mesh cache hits", &meshCache.hits, true);
+	interfaceRef->addParam("Mesh cache misses", &meshCache.misses, true);
+	interfaceRef->addParam("Mesh cache evictions", &meshCache.evictions, true);
 	SetupKeyPoints();
+	curveDeformer.SetCurve(CurveDeformer::SampleCurve(200));
 
 	gl::enableDepthWrite();
 	gl::enableDepthRead();
 	gl::enableVerticalSync(false);
 }
 
+//Grabbing a control point stops the scripted animation and the playback, they would move the point right back
 void KeypointAnimApp::mouseDown( MouseEvent event )
 {
-
+	if (!event.isLeft() || !LatticeVisible())
+		return;
+	activeControlPoint = volume->Pick(MouseRay(event.getPos()));
+	if (activeControlPoint != -1)
+		animateLattice = playRecording = false;
 }
 
+//The point moves in the plane through it that faces the camera
 void KeypointAnimApp::mouseDrag(MouseEvent event)
 {
+	if (!(event.isLeft() || event.isLeftDown()) || activeControlPoint == -1)
+		return;
+	Ray ray = MouseRay(event.getPos());
+	float t;
+	if (ray.calcPlaneIntersection(volume->controlPoints[activeControlPoint], -cam.getViewDirection(), &t))
+		volume->UpdateControlPoint(activeControlPoint, ray.calcPosition(t));
+}
+
+void KeypointAnimApp::mouseUp(MouseEvent event)
+{
+	if (event.isLeft())
+		activeControlPoint = -1;
+}
+
+Ray KeypointAnimApp::MouseRay(vec2 mousePos) const
+{
+	float u = mousePos.x / (float)getWindowWidth();
+	float v = mousePos.y / (float)getWindowHeight();
+	return cam.generateRay(u, 1.f - v, cam.getAspectRatio());
+}
 
+bool KeypointAnimApp::LatticeVisible() const
+{
+	return ffd || mesh->stack.UsesLattice();
 }
 
 void KeypointAnimApp::update()
 {
-	
+	if (mesh->PollLods())
+		lodBuildMs = (float)mesh->lodBuildMs;
+
+	float dt = (float)(getElapsedSeconds() - lastUpdateTime);
+	lastUpdateTime = getElapsedSeconds();
+	if (recorder.recording)
+		recorder.Update(dt, volume->controlPoints);
+	else if (playRecording && !recorder.Play(dt, volume->controlPoints))
+		playRecording = false;
+	recordedFrames = (int)recorder.FrameCount();
+	recordingKB = (int)(recorder.Bytes() / 1024);
+
+	//Editing the curve rebuilds the table once, the vertices pick it up in the shader
+	if (animateCurve && mesh->stack.UsesCurve())
+		curveDeformer.SetCurve(CurveDeformer::SampleCurve(200, (float)getElapsedSeconds()));
+	curveTableBuilds = curveDeformer.tableBuilds;
 }
 
 void KeypointAnimApp::resize()
@@ -85,50 +226,184 @@ void KeypointAnimApp::draw()
 	gl::clear(Color(0, 0, 0));
 	gl::setMatrices(cam);
 	interfaceRef->draw();
+	//A frame that only moves the lattice or changes the strength must not allocate. The first frame after a change of
+	//the drawn mesh, the lattice or the mode may, it builds the batch and the capture buffer
+	size_t allocations = AllocationCounter::Count();
 	volume->RebufferCPs();
+	//Only the level of detail that fits the size on screen is deformed
+	Mesh *drawn = useLods ? mesh->SelectLod(cam, (float)getWindowHeight(), ffd ? volume->transformMat : mat4(1.f)) : mesh.get();
+	drawnTriangles = (int)drawn->TriangleCount();
 	if (ffd) {
-		animation.Interpolate(0.01f, volume->controlPoints);
-		volume->draw(mesh);
+		//The scripted key points only exist for the 8 point cube
+		if (animateLattice && volume->controlPoints.size() == animation.keyPointPositions.front().size())
+			animation.Interpolate(0.01f, volume->controlPoints);
+		if (prePass) {
+			volume->Capture(drawn);
+			drawn->deformPass->draw();
+		}
+		else
+			volume->draw(drawn);
 		volume->draw();
 	}
-	else
-		mesh->draw(time);
+	else {
+		//A stack with an ffd step deforms with the lattice as it is, the FFD switch is not needed for that
+		bool lattice = drawn->stack.UsesLattice();
+		bool curve = drawn->stack.UsesCurve();
+		if (lattice)
+			volume->BindLattice(drawn->progRef);
+		if (curve)
+			curveDeformer.Bind(drawn->progRef);
+		if (prePass) {
+			drawn->Capture(time);
+			drawn->deformPass->draw();
+		}
+		else
+			drawn->draw(time);
+		if (curve)
+			curveDeformer.Unbind();
+		if (lattice) {
+			volume->UnbindLattice();
+			volume->draw();
+		}
+	}
+	frameAllocations = (int)(AllocationCounter::Count() - allocations);
+	auto state = std::make_tuple((const Mesh*)drawn, (const Volume*)volume, mode, ffd, prePass, volume->bindWeights);
+	CI_ASSERT_MSG(state != lastFrameState || frameAllocations == 0, "A frame with the same mesh, lattice and mode allocated");
+	lastFrameState = state;
 }
 
-//Changes the active objects geometry
+//Changes the active objects geometry, meshes that were shown before come out of the cache
 void KeypointAnimApp::ChangeGeom(int geomNum)
 {
-	if(mesh)
-		delete(mesh);
-	
 	switch (geomNum) {
 	case 0:
 	{
-		auto c = geom::Cylinder().height(1).origin(vec3(0, -0.5f, 0));
-		mesh = new Mesh(&c);
-		volume->Transform(vec3(0.f, 0.f, 0.f), vec3(1.0f, 1.0f, 1.0f));
+		mesh = meshCache.Get(MeshKey("cylinder height 1"), [&] {
+			auto c = geom::Cylinder().height(1).origin(vec3(0, -0.5f, 0));
+			return std::make_shared<Mesh>(&c, "cylinder height 1", meshOptions);
+		});
 		break;
 	}
 	case 1:
 	{
-		auto c = geom::Cube().subdivisions(10).size(vec3(1.5, 1.5, 1.5));
-		mesh = new Mesh(&c);
-		volume->Transform(vec3(0.f, 0.f, 0.f), vec3(1.0f, 1.0f, 1.0f));
+		mesh = meshCache.Get(MeshKey("cube subdivisions 10 size 1.5"), [&] {
+			auto c = geom::Cube().subdivisions(10).size(vec3(1.5, 1.5, 1.5));
+			return std::make_shared<Mesh>(&c, "cube subdivisions 10 size 1.5", meshOptions);
+		});
 		break;
 	}
 	case 2:
 	{
-		auto t = geom::Teapot();
-		mesh = new Mesh(&t);
-		volume->Transform(vec3(0.f, -0.5f, 0.f), vec3(1.0f, 1.0f, 1.0f));
+		mesh = meshCache.Get(MeshKey("teapot"), [&] {
+			auto t = geom::Teapot();
+			return std::make_shared<Mesh>(&t, "teapot", meshOptions);
+		});
 		break;
 	}
 	}
+	ShowMesh();
+}
+
+//Imports an OBJ or binary PLY file and shows it instead of the generated geometry
+void KeypointAnimApp::ImportMesh()
+{
+	fs::path path = getOpenFilePath("", { "obj", "ply" });
+	if (path.empty())
+		return;
+
+	std::string error;
+	std::string key = MeshKey(path.string());
+	auto imported = meshCache.Get(key, [&]() -> std::shared_ptr<Mesh> {
+		MeshData data;
+		if (!MeshImport::Load(path, data, &error))
+			return nullptr;
+		return std::make_shared<Mesh>(std::move(data), path.string(), meshOptions);
+	});
+	if (!imported) {
+		cout << "Import failed: " << error << endl;
+		return;
+	}
+	mesh = imported;
+	ShowMesh();
+}
+
+//Fits the lattice to the new mesh, the weights bound for the previous one are useless now
+void KeypointAnimApp::ShowMesh()
+{
 	mesh->SetMode(mode);
+	lodBuildMs = (float)mesh->lodBuildMs;
+	acmrBefore = mesh->layoutReport.acmrBefore;
+	acmrAfter = mesh->layoutReport.acmrAfter;
+	if (volume) {
+		volume->FitToBounds(mesh->min, mesh->max);
+		volume->InvalidateBinding();
+	}
+}
+
+//The layout options change what ends up on the GPU, so each combination is cached on its own.
+//They apply to the meshes created after the change
+std::string KeypointAnimApp::MeshKey(const std::string &descriptor) const
+{
+	return descriptor + (meshOptions.allow16BitIndices ? "" : " 32 bit") + (meshOptions.optimize ? "" : " unoptimized")
+		 + (meshOptions.packed ? " packed" : "");
 }
 
+//Changes the resolution and basis of the FFD lattice
+void KeypointAnimApp::ChangeLattice(int latticeNum)
+{
+	switch (latticeNum) {
+	case 0:
+		volume->SetLattice(Lattice(ivec3(2, 2, 2), Lattice::bernstein));
+		break;
+	case 1:
+		volume->SetLattice(Lattice(ivec3(4, 4, 4), Lattice::bernstein));
+		break;
+	case 2:
+		volume->SetLattice(Lattice(ivec3(4, 4, 4), Lattice::bspline));
+		break;
+	case 3:
+		volume->SetLattice(Lattice(ivec3(8, 8, 8), Lattice::bspline));
+		break;
+	}
+	animation.curKP = 0;
+	animation.curTime = 0.f;
+	//A recording only fits the lattice it was made with
+	recorder.Clear();
+	recordLattice = playRecording = false;
+}
+
+//Deforms a million vertices with the current lattice on the CPU and prints the timings
+void KeypointAnimApp::BenchmarkCpuFFD()
+{
+	auto result = FFDDeformer::Benchmark(volume->lattice, 1000000);
+	cout << "CPU FFD, " << result.vertexCount << " vertices, " << result.threads << " threads" << endl
+		 << "single thread: " << result.singleThreadMs << " ms" << endl
+		 << "thread pool:   " << result.multiThreadMs << " ms" << endl
+		 << "bind weights:  " << result.bindMs << " ms" << endl
+		 << "apply bound:   " << result.boundMs << " ms" << endl
+		 << "max error:     " << result.maxError << endl << endl;
+}
+
+//Lays a million vertices along a curve on the CPU and prints the timings
+void KeypointAnimApp::BenchmarkCurveDeformer()
+{
+	auto result = CurveDeformer::Benchmark(1000000);
+	cout << "Curve deformer, " << result.vertexCount << " vertices, " << result.curveSamples << " curve samples, " << result.threads << " threads" << endl
+		 << "table rebuild: " << result.tableMs << " ms" << endl
+		 << "single thread: " << result.singleThreadMs << " ms" << endl
+		 << "thread pool:   " << result.multiThreadMs << " ms" << endl
+		 << "max error:     " << result.maxError << endl << endl;
+}
+
+//Simplifies a million triangles down to 10% and into a LOD chain and prints the timings
+void KeypointAnimApp::BenchmarkSimplifier()
+{
+	auto result = Simplifier::Benchmark(1000000);
+	cout << "Simplifier, " << result.inputTriangles << " triangles" << endl
+		 << "to " << result.outputTriangles << ": " << result.simplifyMs << " ms" << endl
+		 << "4 level chain: " << result.chainMs << " ms" << endl << endl;
+}
 
-//Helper functions to generate some control points.
 void translateVector(vector<vec3> &pts, vec3 translation, int i = 0, int j = 8)
 {
 	for (; i < j; ++i)
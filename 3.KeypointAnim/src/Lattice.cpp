@@ -0,0 +1,165 @@
+#include "Lattice.h"
+#include <algorithm>
+#include <cmath>
+
+Lattice::Lattice(ivec3 resolution, basisType basis)
+	: resolution(resolution), basis(basis)
+{
+	int minRes = basis == bspline ? 4 : 2;
+	for (int a = 0; a < 3; ++a)
+		this->resolution[a] = std::min(std::max(resolution[a], minRes), (int)MaxResolution);
+}
+
+int Lattice::Size() const
+{
+	return resolution.x * resolution.y * resolution.z;
+}
+
+int Lattice::Support() const
+{
+	if (basis == bspline)
+		return 4 * 4 * 4;
+	return Size();
+}
+
+int Lattice::Index(int i, int j, int k) const
+{
+	return i + resolution.x * (j + resolution.y * k);
+}
+
+//Position of a lattice point before any deformation.
+//Bernstein points span the box, b-spline points reach one cell beyond it so the box is fully covered
+vec3 Lattice::RestPosition(int i, int j, int k) const
+{
+	ivec3 ijk(i, j, k);
+	vec3 pos;
+	for (int a = 0; a < 3; ++a) {
+		float extent = boxMax[a] - boxMin[a];
+		if (basis == bspline)
+			pos[a] = boxMin[a] + (ijk[a] - 1) * extent / (resolution[a] - 3);
+		else
+			pos[a] = boxMin[a] + ijk[a] * extent / (resolution[a] - 1);
+	}
+	return pos;
+}
+
+std::vector<vec3> Lattice::RestPositions() const
+{
+	std::vector<vec3> positions(Size());
+	for (int k = 0; k < resolution.z; ++k)
+		for (int j = 0; j < resolution.y; ++j)
+			for (int i = 0; i < resolution.x; ++i)
+				positions[Index(i, j, k)] = RestPosition(i, j, k);
+	return positions;
+}
+
+//Inverse of RestPosition, used to map points given in any order onto the lattice
+int Lattice::IndexOf(vec3 restPos) const
+{
+	ivec3 ijk;
+	for (int a = 0; a < 3; ++a) {
+		float extent = boxMax[a] - boxMin[a];
+		float c = basis == bspline ? (restPos[a] - boxMin[a]) / extent * (resolution[a] - 3) + 1
+								   : (restPos[a] - boxMin[a]) / extent * (resolution[a] - 1);
+		ijk[a] = std::min(std::max((int)std::lround(c), 0), resolution[a] - 1);
+	}
+	return Index(ijk.x, ijk.y, ijk.z);
+}
+
+void Lattice::Weights(int axis, float x, AxisWeights &out, AxisWeights *derivative) const
+{
+	int res = resolution[axis];
+	float extent = boxMax[axis] - boxMin[axis];
+	float s = (x - boxMin[axis]) / extent;
+
+	if (basis == bspline) {
+		//Uniform cubic b-spline, only the 4 points around the cell containing x contribute
+		float c = s * (res - 3);
+		int cell = std::min(std::max((int)std::floor(c), 0), res - 4);
+		float u = c - cell;
+		float u2 = u * u;
+		float u3 = u2 * u;
+		out.first = cell;
+		out.count = 4;
+		out.w[0] = (1 - u) * (1 - u) * (1 - u) / 6.f;
+		out.w[1] = (3 * u3 - 6 * u2 + 4) / 6.f;
+		out.w[2] = (-3 * u3 + 3 * u2 + 3 * u + 1) / 6.f;
+		out.w[3] = u3 / 6.f;
+		if (derivative) {
+			float dudx = (res - 3) / extent;
+			derivative->first = cell;
+			derivative->count = 4;
+			derivative->w[0] = -(1 - u) * (1 - u) / 2.f * dudx;
+			derivative->w[1] = (3 * u2 - 4 * u) / 2.f * dudx;
+			derivative->w[2] = (-3 * u2 + 2 * u + 1) / 2.f * dudx;
+			derivative->w[3] = u2 / 2.f * dudx;
+		}
+		return;
+	}
+
+	//Bernstein polynomials of degree res-1, raised one degree at a time.
+	//For res == 2 this is the trilinear weighting of the original 8 point cube
+	out.first = 0;
+	out.count = res;
+	out.w[0] = 1.f;
+	for (int d = 1; d < res; ++d) {
+		//The derivative of degree n is n times the difference of the degree n-1 polynomials
+		if (derivative && d == res - 1) {
+			derivative->first = 0;
+			derivative->count = res;
+			for (int i = 0; i < res; ++i) {
+				float lower = i > 0 ? out.w[i - 1] : 0.f;
+				float upper = i < d ? out.w[i] : 0.f;
+				derivative->w[i] = d * (lower - upper) / extent;
+			}
+		}
+		out.w[d] = out.w[d - 1] * s;
+		for (int i = d - 1; i > 0; --i)
+			out.w[i] = out.w[i] * (1 - s) + out.w[i - 1] * s;
+		out.w[0] *= 1 - s;
+	}
+}
+
+//controlPoints are expected in lattice order, see Index()
+vec3 Lattice::Evaluate(vec3 p, const vec3 *controlPoints) const
+{
+	AxisWeights wx, wy, wz;
+	Weights(0, p.x, wx);
+	Weights(1, p.y, wy);
+	Weights(2, p.z, wz);
+
+	vec3 transformedPos(0, 0, 0);
+	for (int k = 0; k < wz.count; ++k) {
+		for (int j = 0; j < wy.count; ++j) {
+			float wyz = wy.w[j] * wz.w[k];
+			const vec3 *row = controlPoints + Index(wx.first, wy.first + j, wz.first + k);
+			for (int i = 0; i < wx.count; ++i)
+				transformedPos += (wx.w[i] * wyz) * row[i];
+		}
+	}
+	return transformedPos;
+}
+
+//Also returns the Jacobian d transformed / d p, its columns are the derivatives along x, y and z
+vec3 Lattice::Evaluate(vec3 p, const vec3 *controlPoints, mat3 &jacobian) const
+{
+	AxisWeights wx, wy, wz, dx, dy, dz;
+	Weights(0, p.x, wx, &dx);
+	Weights(1, p.y, wy, &dy);
+	Weights(2, p.z, wz, &dz);
+
+	vec3 transformedPos(0, 0, 0);
+	jacobian = mat3(0.f);
+	for (int k = 0; k < wz.count; ++k) {
+		for (int j = 0; j < wy.count; ++j) {
+			const vec3 *row = controlPoints + Index(wx.first, wy.first + j, wz.first + k);
+			for (int i = 0; i < wx.count; ++i) {
+				transformedPos += (wx.w[i] * wy.w[j] * wz.w[k]) * row[i];
+				jacobian[0] += (dx.w[i] * wy.w[j] * wz.w[k]) * row[i];
+				jacobian[1] += (wx.w[i] * dy.w[j] * wz.w[k]) * row[i];
+				jacobian[2] += (wx.w[i] * wy.w[j] * dz.w[k]) * row[i];
+			}
+		}
+	}
+	return transformedPos;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "cinder/Vector.h"
+#include "cinder/Matrix.h"
+#include <vector>
+
+using namespace ci;
+
+//Rest state and basis of a l x m x n FFD lattice.
+//The FFD shader evaluates exactly the same math, so Evaluate() is the CPU reference of transformPoint.
+class Lattice {
+public:
+	enum basisType { bernstein, bspline };
+
+	static const int MaxResolution = 16;	//Per axis, the shader uses fixed size weight arrays of this length
+
+	//Weights of one axis: only count points starting at first have an influence
+	struct AxisWeights {
+		int first;
+		int count;
+		float w[MaxResolution];
+	};
+
+	//A cubic b-spline needs at least 4 points per axis, smaller resolutions are raised to 4
+	Lattice(ivec3 resolution = ivec3(2, 2, 2), basisType basis = bernstein);
+
+	ivec3 resolution;
+	basisType basis;
+	vec3 boxMin = vec3(-1, -1, -1);	//The box that is deformed, the teapot/cylinder/cube live inside -1..1
+	vec3 boxMax = vec3(1, 1, 1);
+
+	int Size() const;
+	int Support() const;		//Number of control points that influence a single vertex
+	int Index(int i, int j, int k) const;
+	int IndexOf(vec3 restPos) const;
+	vec3 RestPosition(int i, int j, int k) const;
+	std::vector<vec3> RestPositions() const;
+
+	//derivative receives d weight / d x, needed for the Jacobian
+	void Weights(int axis, float x, AxisWeights &out, AxisWeights *derivative = nullptr) const;
+	vec3 Evaluate(vec3 p, const vec3 *controlPoints) const;
+	vec3 Evaluate(vec3 p, const vec3 *controlPoints, mat3 &jacobian) const;
+};
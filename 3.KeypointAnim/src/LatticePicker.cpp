@@ -0,0 +1,149 @@
+#include "LatticePicker.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+void LatticePicker::Build(const std::vector<vec3> &newPoints, float newRadius)
+{
+	points = newPoints;
+	radius = newRadius;
+	cells.clear();
+	if (points.empty())
+		return;
+
+	vec3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const vec3 &p : points) {
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	//Some room around the points, so dragging one a little does not force a rebuild
+	vec3 margin = (hi - lo) * 0.25f + vec3(radius, radius, radius);
+	gridMin = lo - margin;
+	gridMax = hi + margin;
+
+	int perAxis = std::max(1, (int)std::ceil(std::cbrt((float)points.size())));
+	res = ivec3(perAxis, perAxis, perAxis);
+	cellSize = (gridMax - gridMin) / vec3(res);
+	cells.assign(res.x * res.y * res.z, std::vector<int>());
+	for (int i = 0; i < (int)points.size(); ++i)
+		Insert(i);
+}
+
+void LatticePicker::Move(int i, vec3 pos)
+{
+	for (int a = 0; a < 3; ++a)
+		if (pos[a] - radius < gridMin[a] || pos[a] + radius > gridMax[a]) {
+			points[i] = pos;
+			Build(std::vector<vec3>(points), radius);
+			return;
+		}
+	Remove(i);
+	points[i] = pos;
+	Insert(i);
+}
+
+int LatticePicker::Pick(const Ray &ray, float *distance) const
+{
+	pointsTested = 0;
+	if (points.empty())
+		return -1;
+	vec3 o = ray.getOrigin(), d = ray.getDirection();
+
+	//Where the ray enters and leaves the grid
+	float tEnter = 0, tExit = FLT_MAX;
+	for (int a = 0; a < 3; ++a) {
+		if (d[a] == 0) {
+			if (o[a] < gridMin[a] || o[a] > gridMax[a])
+				return -1;
+			continue;
+		}
+		float t0 = (gridMin[a] - o[a]) / d[a], t1 = (gridMax[a] - o[a]) / d[a];
+		tEnter = std::max(tEnter, std::min(t0, t1));
+		tExit = std::min(tExit, std::max(t0, t1));
+	}
+	if (tEnter > tExit)
+		return -1;
+
+	//Walk the cells in the order the ray passes them (Amanatides & Woo)
+	ivec3 cell = CellOf(o + d * tEnter), step;
+	vec3 tMax, tDelta;
+	for (int a = 0; a < 3; ++a) {
+		step[a] = d[a] > 0 ? 1 : -1;
+		if (d[a] == 0) {
+			tMax[a] = tDelta[a] = FLT_MAX;
+			continue;
+		}
+		float boundary = gridMin[a] + (cell[a] + (d[a] > 0 ? 1 : 0)) * cellSize[a];
+		tMax[a] = (boundary - o[a]) / d[a];
+		tDelta[a] = cellSize[a] / std::abs(d[a]);
+	}
+
+	int best = -1;
+	float bestT = FLT_MAX;
+	while (true) {
+		for (int i : cells[CellIndex(cell)]) {
+			++pointsTested;
+			float t = Hit(i, ray);
+			if (t >= 0 && t < bestT) {
+				bestT = t;
+				best = i;
+			}
+		}
+		//Every sphere that the ray hits inside this cell is listed in it, so nothing further on can be closer
+		int a = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+		if (best != -1 && bestT <= tMax[a])
+			break;
+		cell[a] += step[a];
+		if (cell[a] < 0 || cell[a] >= res[a] || tMax[a] > tExit)
+			break;
+		tMax[a] += tDelta[a];
+	}
+	if (distance && best != -1)
+		*distance = bestT;
+	return best;
+}
+
+ivec3 LatticePicker::CellOf(vec3 p) const
+{
+	ivec3 c;
+	for (int a = 0; a < 3; ++a)
+		c[a] = std::min(std::max((int)std::floor((p[a] - gridMin[a]) / cellSize[a]), 0), res[a] - 1);
+	return c;
+}
+
+void LatticePicker::Insert(int i)
+{
+	vec3 r(radius, radius, radius);
+	ivec3 lo = CellOf(points[i] - r), hi = CellOf(points[i] + r);
+	for (int z = lo.z; z <= hi.z; ++z)
+		for (int y = lo.y; y <= hi.y; ++y)
+			for (int x = lo.x; x <= hi.x; ++x)
+				cells[CellIndex(ivec3(x, y, z))].push_back(i);
+}
+
+void LatticePicker::Remove(int i)
+{
+	vec3 r(radius, radius, radius);
+	ivec3 lo = CellOf(points[i] - r), hi = CellOf(points[i] + r);
+	for (int z = lo.z; z <= hi.z; ++z)
+		for (int y = lo.y; y <= hi.y; ++y)
+			for (int x = lo.x; x <= hi.x; ++x) {
+				auto &cell = cells[CellIndex(ivec3(x, y, z))];
+				cell.erase(std::find(cell.begin(), cell.end(), i));
+			}
+}
+
+//Ray parameter of the first intersection with the sphere of point i, negative if there is none in front of the origin
+float LatticePicker::Hit(int i, const Ray &ray) const
+{
+	vec3 oc = points[i] - ray.getOrigin();
+	vec3 d = ray.getDirection();
+	float dd = dot(d, d);
+	float b = dot(oc, d);
+	float disc = b * b - dd * (dot(oc, oc) - radius * radius);
+	if (disc < 0)
+		return -1;
+	float root = std::sqrt(disc);
+	float t = (b - root) / dd;
+	return t >= 0 ? t : (b + root) / dd;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "cinder/Ray.h"
+#include "cinder/gl/gl.h"
+#include <vector>
+
+using namespace ci;
+
+//Finds the control point a ray hits first, every point is a sphere of the pick radius.
+//The spheres are sorted into a uniform grid of about one point per cell and the ray walks only the cells it passes,
+//front to back, so a pick looks at a handful of points no matter how large the lattice is.
+//Moving a point only moves it between cells, the grid is rebuilt when the points leave its bounds
+class LatticePicker {
+public:
+	void Build(const std::vector<vec3> &points, float radius);
+	void Move(int i, vec3 pos);
+	//Index of the nearest hit point, -1 if the ray misses all of them. distance receives the ray parameter of the hit
+	int Pick(const Ray &ray, float *distance = nullptr) const;
+	bool Empty() const { return points.empty(); }
+
+	mutable int pointsTested = 0;	//By the last Pick, to compare against testing every point
+
+private:
+	ivec3 CellOf(vec3 p) const;
+	int CellIndex(ivec3 c) const { return c.x + res.x * (c.y + res.y * c.z); }
+	void Insert(int i);
+	void Remove(int i);
+	float Hit(int i, const Ray &ray) const;
+
+	std::vector<vec3> points;
+	std::vector<std::vector<int>> cells;		//Every point is listed in all cells its sphere overlaps
+	float radius = 0;
+	vec3 gridMin, gridMax;
+	vec3 cellSize;
+	ivec3 res;
+};
@@ -1,47 +1,221 @@
 #include "Mesh.h"
+#include "MeshBounds.h"
 #include "glm/gtx/intersect.hpp"
+#include "Simplifier.h"
 #include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <map>
 
+int Mesh::batchesBuilt = 0;
+
+//time is used as the strength of every deformer in the stack
 void Mesh::draw(float time)
 {
 	batchRef->getVao()->bind();
-	batchRef->getGlslProg()->uniform("t", time);
+	stack.SetStrength(time);
+	SetUniforms();
 	batchRef->draw();
 }
 
-void Mesh::SetMode(int mode)
+//Deform into the DeformPass instead of drawing
+void Mesh::Capture(float time)
 {
-	batchRef->getVao()->bind();
-	batchRef->getGlslProg()->uniform("deformMode", mode);
+	stack.SetStrength(time);
+	SetUniforms();
+	deformPass->Run(batchRef);
 }
 
+void Mesh::SetMode(int mode)
+{
+	SetStack(ModeStack(mode));
+}
 
-Mesh::Mesh(geom::Source* geomSrc)
+//The stacks behind the modes of the app
+DeformerStack Mesh::ModeStack(int mode)
 {
-	progRef = Shaders::GetDeformationShader();
-	batchRef = gl::Batch::create(*geomSrc, progRef);
+	switch (mode) {
+	case 1: return { Deformer::twist };
+	case 2: return { Deformer::bend };
+	case 3: return { Deformer::other };
+	case 4: return { Deformer::taper, Deformer::twist };
+	case 5: return { Deformer::bend, Deformer::ffd };
+	case 6: return { Deformer::curve };
+	default: return { Deformer::taper };
+	}
+}
 
-	auto vborefs = batchRef->getVboMesh()->getVertexArrayVbos();
-	std::vector<vec3> vertices;
-	vertices.resize(vborefs.front()->getSize()/(sizeof(float)*3));
-	vborefs.front()->getBufferSubData(0, vborefs.front()->getSize(), vertices.data());
-	min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
-	max = vec3(FLT_MIN, FLT_MIN, FLT_MIN);
+size_t Mesh::GpuBytes() const
+{
+	size_t bytes = deformPass->outputVboRef->getSize();
+	for (auto &vbo : vboMeshRef->getVertexArrayVbos())
+		bytes += vbo->getSize();
+	if (vboMeshRef->getIndexVbo())
+		bytes += vboMeshRef->getIndexVbo()->getSize();
+	for (auto &lod : lods)
+		bytes += lod->GpuBytes();
+	return bytes;
+}
 
-	for_each(vertices.begin(), vertices.end(), [&](vec3 vec) {
-		min.x = vec.x < min.x ? vec.x : min.x;
-		min.y = vec.y < min.y ? vec.y : min.y;
-		min.z = vec.z < min.z ? vec.z : min.z;
+//Switches to the program of the stack, compiled only the first time its signature is seen.
+//A stack with more than MaxDeformers steps is rejected, the mesh keeps its current one
+bool Mesh::SetStack(const DeformerStack &newStack)
+{
+	if (!newStack.Valid())
+		return false;
+	stack = newStack;
+	stackSignature = stack.Signature();
+	progRef = stack.GetProgram(options.packed);
+	batchRef = BatchFor(progRef);
+	progRef->uniform("lightDir", normalize(vec3(-3, 10, 0)));
+	return true;
+}
 
-		max.x = vec.x > max.x ? vec.x : max.x;
-		max.y = vec.y > max.y ? vec.y : max.y;
-		max.z = vec.z > max.z ? vec.z : max.z;
+//Every program the mesh is drawn with gets a batch of its own, see BatchCache. They all share the buffers of the mesh
+const gl::BatchRef& Mesh::BatchFor(const gl::GlslProgRef &prog)
+{
+	return batches.For(prog, [&](const gl::GlslProgRef &program) {
+		++batchesBuilt;
+		return gl::Batch::create(vboMeshRef, program);
 	});
+}
+
+
+//The geometry is generated into a TriMesh on the CPU first, so the positions and bounds are known without reading the VBO back
+Mesh::Mesh(geom::Source* geomSrc, const std::string &descriptor, const MeshOptions &options)
+	: Mesh(Generate(*geomSrc), descriptor, options)
+{
+}
+
+//Generated and imported meshes both go through the layout passes before the upload
+Mesh::Mesh(MeshData data, const std::string &descriptor, const MeshOptions &options)
+	: options(options)
+{
+	if (options.optimize)
+		layoutReport = MeshOptimizer::Optimize(data);
+	else {
+		layoutReport.acmrBefore = layoutReport.acmrAfter = MeshOptimizer::Acmr(data.indices, data.positions.size());
+		layoutReport.ms = 0;
+	}
+
+	gl::VboMeshRef vboMesh;
+	if (options.packed) {
+		PackedVertices packed = MeshOptimizer::Quantize(data);
+		quantMin = packed.min;
+		quantExtent = packed.extent;
+		vboMesh = MeshImport::Upload(data, options.allow16BitIndices, &packed);
+	}
+	else
+		vboMesh = MeshImport::Upload(data, options.allow16BitIndices);
+	positions = std::move(data.positions);
+	normals = std::move(data.normals);
+	indices = std::move(data.indices);
+	Init(vboMesh, descriptor);
+}
+
+MeshData Mesh::Generate(const geom::Source &geomSrc)
+{
+	TriMesh triMesh(geomSrc);
+	MeshData data;
+	const vec3 *vertices = triMesh.getPositions<3>();
+	data.positions.assign(vertices, vertices + triMesh.getNumVertices());
+	data.normals = triMesh.getNormals();
+	data.indices = triMesh.getIndices();
+	return data;
+}
+
+//Bounds depend only on the geometry, with a descriptor they are computed once per kind of geometry
+void Mesh::Init(const gl::VboMeshRef &vboMesh, const std::string &descriptor)
+{
+	static std::map<std::string, std::pair<vec3, vec3>> boundsCache;
+
+	auto cached = descriptor.empty() ? boundsCache.end() : boundsCache.find(descriptor);
+	if (cached != boundsCache.end()) {
+		min = cached->second.first;
+		max = cached->second.second;
+	}
+	else {
+		MeshBounds::Compute(positions.data(), positions.size(), min, max);
+		if (!descriptor.empty())
+			boundsCache[descriptor] = std::make_pair(min, max);
+	}
+
+	stack = ModeStack(0);
+	stackSignature = stack.Signature();
+	progRef = stack.GetProgram(options.packed);
+	vboMeshRef = vboMesh;
+	batchRef = BatchFor(progRef);
+	deformPass = std::make_shared<DeformPass>(vboMeshRef);
 
 	batchRef->getGlslProg()->uniform("lightDir", normalize(vec3(-3, 10, 0)));
-	batchRef->getGlslProg()->uniform("min", min);
-	batchRef->getGlslProg()->uniform("max", max);
-	batchRef->getGlslProg()->uniform("t", 0.f);
+	SetUniforms();
+
+}
 
+void Mesh::SetUniforms()
+{
+	stack.SetUniforms(progRef, min, max);
+	if (options.packed) {
+		progRef->uniform("quantMin", quantMin);
+		progRef->uniform("quantExtent", quantExtent);
+	}
+}
+
+//The simplifier works on a copy, so the mesh can be drawn (and even deleted, which waits for the thread) meanwhile
+void Mesh::BuildLods(int levels)
+{
+	if (pendingLods.valid())
+		return;
+	MeshData data;
+	data.positions = positions;
+	data.normals = normals;
+	data.indices = indices;
+	pendingLods = std::async(std::launch::async, [levels](MeshData data) {
+		auto start = std::chrono::high_resolution_clock::now();
+		LodBuild build;
+		build.levels = Simplifier::BuildLodChain(data, levels);
+		build.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return build;
+	}, std::move(data));
+}
+
+bool Mesh::PollLods()
+{
+	if (!pendingLods.valid() || pendingLods.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+	LodBuild build = pendingLods.get();
+	lodBuildMs = build.ms;
+	lods.clear();
+	for (MeshData &level : build.levels) {
+		auto lod = std::make_shared<Mesh>(std::move(level), "", options);
+		//The deformers have to see the bounds of the full mesh, or taper would differ between the levels
+		lod->min = min;
+		lod->max = max;
+		lods.push_back(lod);
+	}
+	return true;
 }
 
+//The coarsest level that still has lodDensity triangles for every pixel the bounding sphere covers on screen
+Mesh* Mesh::SelectLod(const CameraPersp &cam, float viewportHeight, const mat4 &model)
+{
+	if (lods.empty())
+		return this;
+	vec3 center = vec3(model * vec4((min + max) * 0.5f, 1));
+	float radius = length(max - min) * 0.5f * length(vec3(model[0]));
+	float distance = length(center - cam.getEyePoint());
+	if (distance <= radius)
+		return this;
+	float pixels = radius / (distance * std::tan(toRadians(cam.getFov()) * 0.5f)) * viewportHeight * 0.5f;
+	float wanted = 3.14159f * pixels * pixels * lodDensity;
+
+	Mesh *chosen = this;
+	for (auto &lod : lods) {
+		if (lod->TriangleCount() < wanted)
+			break;
+		chosen = lod.get();
+	}
+	if (chosen != this && chosen->stackSignature != stackSignature)
+		chosen->SetStack(stack);
+	return chosen;
+}
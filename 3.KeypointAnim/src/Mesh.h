@@ -2,27 +2,79 @@
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
+#include "cinder/TriMesh.h"
 #include "Shaders.h"
+#include "BatchCache.h"
+#include "DeformPass.h"
+#include "DeformerStack.h"
+#include "MeshImport.h"
+#include "MeshOptimizer.h"
+#include "cinder/Camera.h"
+#include <future>
 
 using namespace ci;
 using namespace ci::app;
 
+//How a Mesh lays out its data on the GPU
+struct MeshOptions {
+	bool allow16BitIndices = true;
+	bool optimize = true;			//Reorder triangles and vertices for the vertex caches, see MeshOptimizer
+	bool packed = false;			//Upload PackedVertices instead of floats, half the vertex memory
+};
+
 class Mesh {
 public:
-	Mesh(geom::Source* geomSrc);
+	Mesh(geom::Source* geomSrc, const std::string &descriptor = "", const MeshOptions &options = MeshOptions());
+	Mesh(MeshData data, const std::string &descriptor = "", const MeshOptions &options = MeshOptions());
 
 	gl::GlslProgRef progRef;
-	gl::BatchRef batchRef;
+	gl::BatchRef batchRef;			//The batch of progRef
+	gl::VboMeshRef vboMeshRef;
+	DeformPassRef deformPass;		//Holds the deformed mesh when it is drawn through the pre-pass
+	DeformerStack stack;			//The deformers applied to the mesh, progRef is compiled from it
 	
 	void draw(float time);
+	void Capture(float time);
 	
 	void SetMode(int mode);
+	static DeformerStack ModeStack(int mode);
+	size_t GpuBytes() const;		//Vertex, index and deform pass buffers, including the LODs
+	bool SetStack(const DeformerStack &newStack);
+	const gl::BatchRef& BatchFor(const gl::GlslProgRef &prog);
+	//By all meshes, stays constant while nothing new is shown. Each one built a VAO, GL calls per frame are not counted
+	static int batchesBuilt;
 
 	vec3 min,max;
+	std::vector<vec3> positions;	//Rest positions in vertex order, needed to bind the FFD weights
+	std::vector<vec3> normals;		//CPU copy of the geometry, the simplifier starts from it
+	std::vector<uint32_t> indices;
+	size_t TriangleCount() const { return indices.size() / 3; }
+
+	MeshOptions options;
+	MeshOptimizer::Report layoutReport;	//ACMR of the triangle order as generated and as uploaded
+	vec3 quantMin, quantExtent;			//packed only, the range the positions are quantized over
+
+	//Levels of detail, each with about half the triangles of the one before (see Simplifier)
+	std::vector<std::shared_ptr<Mesh>> lods;
+	float lodDensity = 0.5f;		//Triangles per pixel of the projected bounding sphere
+	double lodBuildMs = 0;
+	void BuildLods(int levels = 4);	//Simplifies on a background thread
+	bool PollLods();				//Uploads the finished levels, has to run on the GL thread
+	Mesh* SelectLod(const CameraPersp &cam, float viewportHeight, const mat4 &model);
 
-	
 
 private:
+	static MeshData Generate(const geom::Source &geomSrc);
+	void Init(const gl::VboMeshRef &vboMesh, const std::string &descriptor);
+	void SetUniforms();
+
+	struct LodBuild {
+		std::vector<MeshData> levels;
+		double ms;
+	};
+	std::future<LodBuild> pendingLods;
+	BatchCache<gl::GlslProgRef, gl::BatchRef> batches;
+	std::string stackSignature;		//Of stack as SetStack last saw it, SelectLod compares it every frame
 
 };
 
@@ -0,0 +1,33 @@
+#include "MeshBounds.h"
+#include <algorithm>
+#include <cfloat>
+
+//Treats the positions as a flat float array: 8 vertices are 24 floats, and lane j always holds component j % 3.
+//So the inner loops are plain element wise min/max over contiguous floats, which the compiler turns into SIMD
+void MeshBounds::Compute(const vec3 *points, size_t count, vec3 &min, vec3 &max)
+{
+	const int Block = 8 * 3;
+	float lo[Block], hi[Block];
+	std::fill(lo, lo + Block, FLT_MAX);
+	std::fill(hi, hi + Block, -FLT_MAX);
+
+	const float *f = &points[0].x;
+	size_t blocks = count / 8;
+	for (size_t b = 0; b < blocks; ++b, f += Block) {
+		for (int j = 0; j < Block; ++j)
+			lo[j] = std::min(lo[j], f[j]);
+		for (int j = 0; j < Block; ++j)
+			hi[j] = std::max(hi[j], f[j]);
+	}
+	for (size_t j = 0; j < (count - blocks * 8) * 3; ++j) {
+		lo[j] = std::min(lo[j], f[j]);
+		hi[j] = std::max(hi[j], f[j]);
+	}
+
+	min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int j = 0; j < Block; ++j) {
+		min[j % 3] = std::min(min[j % 3], lo[j]);
+		max[j % 3] = std::max(max[j % 3], hi[j]);
+	}
+}
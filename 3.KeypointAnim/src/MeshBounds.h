@@ -0,0 +1,11 @@
+#pragma once
+#include "cinder/Vector.h"
+#include <cstddef>
+
+using namespace ci;
+
+namespace MeshBounds {
+
+	//Per axis minimum and maximum, also for meshes that lie entirely below zero
+	void Compute(const vec3 *points, size_t count, vec3 &min, vec3 &max);
+}
@@ -0,0 +1,49 @@
+#include "MeshCache.h"
+
+MeshCache::MeshCache(size_t budgetBytes)
+	: budgetBytes(budgetBytes)
+{
+}
+
+std::shared_ptr<Mesh> MeshCache::Get(const std::string &key, const std::function<std::shared_ptr<Mesh>()> &create)
+{
+	auto it = lookup.find(key);
+	if (it != lookup.end()) {
+		hits++;
+		entries.splice(entries.begin(), entries, it->second);
+		//LODs may have been added since the mesh was cached
+		Entry &entry = entries.front();
+		usedBytes = usedBytes - entry.bytes + entry.mesh->GpuBytes();
+		entry.bytes = entry.mesh->GpuBytes();
+		auto mesh = entry.mesh;
+		Evict();
+		return mesh;
+	}
+
+	misses++;
+	auto mesh = create();
+	if (!mesh)
+		return mesh;
+	entries.push_front({ key, mesh, mesh->GpuBytes() });
+	lookup[key] = entries.begin();
+	usedBytes += entries.front().bytes;
+	Evict();
+	return mesh;
+}
+
+void MeshCache::Clear()
+{
+	entries.clear();
+	lookup.clear();
+	usedBytes = 0;
+}
+
+void MeshCache::Evict()
+{
+	while (usedBytes > budgetBytes && entries.size() > 1) {
+		usedBytes -= entries.back().bytes;
+		lookup.erase(entries.back().key);
+		entries.pop_back();
+		evictions++;
+	}
+}
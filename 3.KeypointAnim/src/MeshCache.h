@@ -0,0 +1,37 @@
+#pragma once
+#include "Mesh.h"
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+//Keeps generated meshes (VBOs, VAO, deform pass, bounds) alive, keyed by the parameters of their geometry.
+//Once the GPU memory of all cached meshes exceeds the budget, the least recently used ones are released.
+//The mesh returned last is never released, it is the one on screen
+class MeshCache {
+public:
+	MeshCache(size_t budgetBytes = 256 * 1024 * 1024);
+
+	//Returns the cached mesh for key or creates it with create, nothing is cached if create returns null
+	std::shared_ptr<Mesh> Get(const std::string &key, const std::function<std::shared_ptr<Mesh>()> &create);
+	void Clear();
+
+	size_t budgetBytes;
+	size_t usedBytes = 0;
+	int hits = 0;
+	int misses = 0;
+	int evictions = 0;
+
+private:
+	struct Entry {
+		std::string key;
+		std::shared_ptr<Mesh> mesh;
+		size_t bytes;
+	};
+
+	void Evict();
+
+	std::list<Entry> entries;	//Most recently used first
+	std::map<std::string, std::list<Entry>::iterator> lookup;
+};
@@ -0,0 +1,575 @@
+#include "MeshImport.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+	const size_t Grain = 4096;
+	const int NoIndex = INT_MIN;
+
+	bool Fail(std::string *error, const std::string &message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+
+	//A 0 is appended (and not counted in size) so strtof/strtol always stop inside the buffer
+	bool ReadFile(const fs::path &path, std::vector<char> &data, size_t &size)
+	{
+		std::ifstream file(path.string(), std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+		size = (size_t)file.tellg();
+		data.resize(size + 1);
+		file.seekg(0);
+		file.read(data.data(), size);
+		data[size] = 0;
+		return (bool)file;
+	}
+
+	//--- OBJ ---
+
+	//Index of a face corner. OBJ allows negative indices relative to the vertices read so far,
+	//these are stored relative to the start of the chunk and made absolute once all chunks are parsed
+	struct ObjCorner {
+		int v, n;
+		bool vLocal, nLocal;
+	};
+
+	struct ObjChunk {
+		std::vector<vec3> positions;
+		std::vector<vec3> normals;
+		std::vector<ObjCorner> corners;	//3 per triangle
+		size_t firstPosition = 0, firstNormal = 0;
+		bool valid = true;
+	};
+
+	inline const char* SkipSpace(const char *p, const char *end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			++p;
+		return p;
+	}
+
+	inline const char* NextLine(const char *p, const char *end)
+	{
+		while (p < end && *p != '\n')
+			++p;
+		return p < end ? p + 1 : end;
+	}
+
+	//Chunks end at the beginning of a line, strtof stops at the line break before it
+	inline const char* ParseFloat(const char *p, const char *end, float &value)
+	{
+		p = SkipSpace(p, end);
+		value = 0;
+		if (p >= end || *p == '\n' || *p == '\r')
+			return p;
+		char *next;
+		value = std::strtof(p, &next);
+		return next;
+	}
+
+	inline const char* ParseInt(const char *p, const char *end, int &value, bool &found)
+	{
+		found = false;
+		if (p >= end || *p == '\n' || *p == '\r' || *p == ' ' || *p == '\t')
+			return p;
+		char *next;
+		long v = std::strtol(p, &next, 10);
+		found = next != p;
+		value = (int)v;
+		return next;
+	}
+
+	//Resolves the index as written in the file, count is the number of elements read in the chunk so far
+	inline void ObjIndex(int written, size_t count, int &index, bool &local)
+	{
+		local = written < 0;
+		index = written < 0 ? (int)count + written : written - 1;
+	}
+
+	void ParseObjChunk(const char *p, const char *end, ObjChunk &chunk)
+	{
+		std::vector<ObjCorner> face;
+		while (p < end) {
+			p = SkipSpace(p, end);
+			if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+				vec3 v;
+				p = ParseFloat(p + 1, end, v.x);
+				p = ParseFloat(p, end, v.y);
+				p = ParseFloat(p, end, v.z);
+				chunk.positions.push_back(v);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+				vec3 n;
+				p = ParseFloat(p + 2, end, n.x);
+				p = ParseFloat(p, end, n.y);
+				p = ParseFloat(p, end, n.z);
+				chunk.normals.push_back(n);
+			}
+			else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+				face.clear();
+				p += 1;
+				while (true) {
+					p = SkipSpace(p, end);
+					if (p >= end || *p == '\n' || *p == '\r' || *p == '#')
+						break;
+					//v, v/vt, v//vn or v/vt/vn, the texture coordinate is not used
+					ObjCorner corner = { NoIndex, NoIndex, false, false };
+					int value;
+					bool found;
+					p = ParseInt(p, end, value, found);
+					if (!found) {
+						chunk.valid = false;
+						break;
+					}
+					ObjIndex(value, chunk.positions.size(), corner.v, corner.vLocal);
+					if (p < end && *p == '/') {
+						p = ParseInt(p + 1, end, value, found);
+						if (p < end && *p == '/') {
+							p = ParseInt(p + 1, end, value, found);
+							if (found)
+								ObjIndex(value, chunk.normals.size(), corner.n, corner.nLocal);
+						}
+					}
+					face.push_back(corner);
+					while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+						++p;
+				}
+				//Polygons become triangle fans
+				for (size_t i = 2; i < face.size(); ++i) {
+					chunk.corners.push_back(face[0]);
+					chunk.corners.push_back(face[i - 1]);
+					chunk.corners.push_back(face[i]);
+				}
+			}
+			p = NextLine(p, end);
+		}
+	}
+
+	//--- PLY ---
+
+	enum plyType { plyNone, plyInt8, plyUInt8, plyInt16, plyUInt16, plyInt32, plyUInt32, plyFloat32, plyFloat64 };
+
+	plyType PlyTypeOf(const std::string &name)
+	{
+		if (name == "char" || name == "int8") return plyInt8;
+		if (name == "uchar" || name == "uint8") return plyUInt8;
+		if (name == "short" || name == "int16") return plyInt16;
+		if (name == "ushort" || name == "uint16") return plyUInt16;
+		if (name == "int" || name == "int32") return plyInt32;
+		if (name == "uint" || name == "uint32") return plyUInt32;
+		if (name == "float" || name == "float32") return plyFloat32;
+		if (name == "double" || name == "float64") return plyFloat64;
+		return plyNone;
+	}
+
+	size_t PlySize(plyType type)
+	{
+		static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+		return sizes[type];
+	}
+
+	double PlyRead(const char *p, plyType type, bool swap)
+	{
+		char bytes[8];
+		size_t size = PlySize(type);
+		if (swap)
+			std::reverse_copy(p, p + size, bytes);
+		else
+			std::memcpy(bytes, p, size);
+		switch (type) {
+		case plyInt8: { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+		case plyUInt8: { uint8_t v; std::memcpy(&v, bytes, 1); return v; }
+		case plyInt16: { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+		case plyUInt16: { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+		case plyInt32: { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+		case plyUInt32: { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+		case plyFloat32: { float v; std::memcpy(&v, bytes, 4); return v; }
+		case plyFloat64: { double v; std::memcpy(&v, bytes, 8); return v; }
+		default: return 0;
+		}
+	}
+
+	struct PlyProperty {
+		std::string name;
+		plyType type = plyNone;
+		plyType countType = plyNone;	//Set for list properties
+	};
+
+	struct PlyElement {
+		std::string name;
+		size_t count = 0;
+		std::vector<PlyProperty> properties;
+
+		//0 if the element contains lists and so has no fixed size
+		size_t RecordSize() const
+		{
+			size_t size = 0;
+			for (const PlyProperty &p : properties) {
+				if (p.countType != plyNone)
+					return 0;
+				size += PlySize(p.type);
+			}
+			return size;
+		}
+	};
+
+	bool IsLittleEndian()
+	{
+		uint16_t one = 1;
+		return *(const uint8_t*)&one == 1;
+	}
+}
+
+namespace MeshImport {
+
+	bool Load(const fs::path &path, MeshData &out, std::string *error, ThreadPool &pool)
+	{
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".obj")
+			return LoadObj(path, out, error, pool);
+		if (extension == ".ply")
+			return LoadPly(path, out, error, pool);
+		return Fail(error, "Unsupported file type " + extension);
+	}
+
+	bool LoadObj(const fs::path &path, MeshData &out, std::string *error, ThreadPool &pool)
+	{
+		std::vector<char> data;
+		size_t size;
+		if (!ReadFile(path, data, size))
+			return Fail(error, "Could not read " + path.string());
+
+		//Split into one chunk per thread and a few more for balance, every chunk starts at the beginning of a line
+		size_t chunkCount = std::max<size_t>(1, std::min<size_t>(pool.Size() * 4, size / (1 << 16)));
+		std::vector<const char*> bounds(chunkCount + 1);
+		const char *begin = data.data(), *end = data.data() + size;
+		bounds[0] = begin;
+		bounds[chunkCount] = end;
+		for (size_t c = 1; c < chunkCount; ++c)
+			bounds[c] = std::max(bounds[c - 1], NextLine(begin + size * c / chunkCount, end));
+
+		std::vector<ObjChunk> chunks(chunkCount);
+		pool.ParallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+			for (size_t c = first; c < last; ++c)
+				ParseObjChunk(bounds[c], bounds[c + 1], chunks[c]);
+		});
+
+		size_t positionCount = 0, normalCount = 0, cornerCount = 0;
+		for (ObjChunk &chunk : chunks) {
+			if (!chunk.valid)
+				return Fail(error, "Malformed face in " + path.string());
+			chunk.firstPosition = positionCount;
+			chunk.firstNormal = normalCount;
+			positionCount += chunk.positions.size();
+			normalCount += chunk.normals.size();
+			cornerCount += chunk.corners.size();
+		}
+		std::vector<vec3> positions, normals;
+		positions.reserve(positionCount);
+		normals.reserve(normalCount);
+		for (ObjChunk &chunk : chunks) {
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+			std::vector<vec3>().swap(chunk.positions);
+			std::vector<vec3>().swap(chunk.normals);
+		}
+
+		//Every distinct (position, normal) pair becomes one vertex
+		out = MeshData();
+		out.indices.reserve(cornerCount);
+		std::unordered_map<uint64_t, uint32_t> vertexOf;
+		vertexOf.reserve(positionCount);
+		bool hasNormals = true;
+		for (const ObjChunk &chunk : chunks) {
+			for (const ObjCorner &corner : chunk.corners) {
+				int64_t v = corner.v + (corner.vLocal ? (int64_t)chunk.firstPosition : 0);
+				int64_t n = corner.n == NoIndex ? -1 : corner.n + (corner.nLocal ? (int64_t)chunk.firstNormal : 0);
+				if (v < 0 || v >= (int64_t)positionCount || n >= (int64_t)normalCount || (corner.n != NoIndex && n < 0))
+					return Fail(error, "Face index out of range in " + path.string());
+				hasNormals &= n >= 0;
+
+				uint64_t key = ((uint64_t)v << 32) | (uint32_t)(n + 1);
+				auto inserted = vertexOf.insert(std::make_pair(key, (uint32_t)out.positions.size()));
+				if (inserted.second) {
+					out.positions.push_back(positions[v]);
+					out.normals.push_back(n >= 0 ? normalize(normals[n]) : vec3(0, 0, 0));
+				}
+				out.indices.push_back(inserted.first->second);
+			}
+		}
+		if (!hasNormals)
+			ComputeNormals(out, pool);
+		return true;
+	}
+
+	bool LoadPly(const fs::path &path, MeshData &out, std::string *error, ThreadPool &pool)
+	{
+		std::vector<char> data;
+		size_t size;
+		if (!ReadFile(path, data, size))
+			return Fail(error, "Could not read " + path.string());
+
+		static const char EndHeader[] = "end_header";
+		const char *start = data.data(), *end = data.data() + size;
+		const char *headerEnd = std::search(start, end, EndHeader, EndHeader + sizeof(EndHeader) - 1);
+		if (size < 3 || std::strncmp(start, "ply", 3) != 0 || headerEnd == end)
+			return Fail(error, path.string() + " is not a PLY file");
+		const char *body = NextLine(headerEnd, end);
+
+		std::istringstream header(std::string(start, headerEnd));
+		std::vector<PlyElement> elements;
+		bool swap = false;
+		std::string line;
+		while (std::getline(header, line)) {
+			std::istringstream words(line);
+			std::string keyword;
+			words >> keyword;
+			if (keyword == "format") {
+				std::string format;
+				words >> format;
+				if (format == "binary_little_endian")
+					swap = !IsLittleEndian();
+				else if (format == "binary_big_endian")
+					swap = IsLittleEndian();
+				else
+					return Fail(error, "Only binary PLY files are supported");
+			}
+			else if (keyword == "element") {
+				PlyElement element;
+				words >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property" && !elements.empty()) {
+				PlyProperty property;
+				std::string type;
+				words >> type;
+				if (type == "list") {
+					std::string countType, itemType;
+					words >> countType >> itemType;
+					property.countType = PlyTypeOf(countType);
+					property.type = PlyTypeOf(itemType);
+					if (property.countType == plyNone)
+						return Fail(error, "Unknown PLY type " + countType);
+				}
+				else
+					property.type = PlyTypeOf(type);
+				if (property.type == plyNone)
+					return Fail(error, "Unknown PLY type " + type);
+				words >> property.name;
+				elements.back().properties.push_back(property);
+			}
+		}
+
+		out = MeshData();
+		const char *p = body;
+		for (const PlyElement &element : elements) {
+			size_t recordSize = element.RecordSize();
+			if (element.name == "vertex") {
+				if (!recordSize || p + recordSize * element.count > end)
+					return Fail(error, "Malformed vertex element in " + path.string());
+				//Offsets of x y z nx ny nz inside a record
+				static const char* const names[] = { "x", "y", "z", "nx", "ny", "nz" };
+				size_t offsets[6];
+				plyType types[6] = { plyNone, plyNone, plyNone, plyNone, plyNone, plyNone };
+				size_t offset = 0;
+				for (const PlyProperty &property : element.properties) {
+					for (int a = 0; a < 6; ++a)
+						if (property.name == names[a]) {
+							offsets[a] = offset;
+							types[a] = property.type;
+						}
+					offset += PlySize(property.type);
+				}
+				if (types[0] == plyNone || types[1] == plyNone || types[2] == plyNone)
+					return Fail(error, "PLY vertices without positions in " + path.string());
+				bool hasNormals = types[3] != plyNone && types[4] != plyNone && types[5] != plyNone;
+
+				//Fixed size records, so every range can be decoded independently
+				out.positions.resize(element.count);
+				out.normals.resize(element.count);
+				pool.ParallelFor(element.count, Grain, [&](size_t first, size_t last) {
+					for (size_t i = first; i < last; ++i) {
+						const char *record = p + i * recordSize;
+						for (int a = 0; a < 3; ++a)
+							out.positions[i][a] = (float)PlyRead(record + offsets[a], types[a], swap);
+						if (hasNormals)
+							for (int a = 0; a < 3; ++a)
+								out.normals[i][a] = (float)PlyRead(record + offsets[a + 3], types[a + 3], swap);
+					}
+				});
+				if (!hasNormals)
+					out.normals.clear();
+				p += recordSize * element.count;
+			}
+			else if (element.name == "face") {
+				//Records have different lengths, so faces are read in order
+				out.indices.reserve(element.count * 3);
+				for (size_t f = 0; f < element.count; ++f) {
+					for (const PlyProperty &property : element.properties) {
+						if (property.countType == plyNone) {
+							p += PlySize(property.type);
+							continue;
+						}
+						if (p + PlySize(property.countType) > end)
+							return Fail(error, "Truncated face element in " + path.string());
+						size_t count = (size_t)PlyRead(p, property.countType, swap);
+						p += PlySize(property.countType);
+						size_t itemSize = PlySize(property.type);
+						if (p + count * itemSize > end)
+							return Fail(error, "Truncated face element in " + path.string());
+						if (property.name == "vertex_indices" || property.name == "vertex_index") {
+							uint32_t first = (uint32_t)PlyRead(p, property.type, swap);
+							for (size_t i = 2; i < count; ++i) {
+								out.indices.push_back(first);
+								out.indices.push_back((uint32_t)PlyRead(p + (i - 1) * itemSize, property.type, swap));
+								out.indices.push_back((uint32_t)PlyRead(p + i * itemSize, property.type, swap));
+							}
+						}
+						p += count * itemSize;
+					}
+				}
+			}
+			else {
+				if (!recordSize)
+					return Fail(error, "Cannot skip PLY element " + element.name);
+				p += recordSize * element.count;
+			}
+		}
+
+		for (uint32_t index : out.indices)
+			if (index >= out.positions.size())
+				return Fail(error, "Face index out of range in " + path.string());
+		//Without normals duplicates are merged by position first, so the computed normals are smooth across them
+		bool hasNormals = !out.normals.empty();
+		if (!hasNormals)
+			out.normals.assign(out.positions.size(), vec3(0, 0, 0));
+		Deduplicate(out);
+		if (!hasNormals)
+			ComputeNormals(out, pool);
+		return true;
+	}
+
+	void Deduplicate(MeshData &mesh)
+	{
+		struct Hash {
+			const MeshData &mesh;
+			size_t operator()(uint32_t i) const
+			{
+				uint32_t words[6];
+				std::memcpy(words, &mesh.positions[i], sizeof(vec3));
+				std::memcpy(words + 3, &mesh.normals[i], sizeof(vec3));
+				uint64_t hash = 14695981039346656037ull;
+				for (uint32_t w : words)
+					hash = (hash ^ w) * 1099511628211ull;
+				return (size_t)hash;
+			}
+		};
+		struct Equal {
+			const MeshData &mesh;
+			bool operator()(uint32_t a, uint32_t b) const
+			{
+				return std::memcmp(&mesh.positions[a], &mesh.positions[b], sizeof(vec3)) == 0
+					&& std::memcmp(&mesh.normals[a], &mesh.normals[b], sizeof(vec3)) == 0;
+			}
+		};
+
+		//remap[i] is the first vertex equal to i, kept vertices are compacted afterwards
+		std::unordered_map<uint32_t, uint32_t, Hash, Equal> firstOf(mesh.positions.size(), Hash{ mesh }, Equal{ mesh });
+		std::vector<uint32_t> remap(mesh.positions.size());
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < mesh.positions.size(); ++i) {
+			auto inserted = firstOf.insert(std::make_pair(i, kept));
+			if (inserted.second) {
+				mesh.positions[kept] = mesh.positions[i];
+				mesh.normals[kept] = mesh.normals[i];
+				++kept;
+			}
+			remap[i] = inserted.first->second;
+		}
+		for (uint32_t &index : mesh.indices)
+			index = remap[index];
+		mesh.positions.resize(kept);
+		mesh.normals.resize(kept);
+	}
+
+	void ComputeNormals(MeshData &mesh, ThreadPool &pool)
+	{
+		mesh.normals.assign(mesh.positions.size(), vec3(0, 0, 0));
+		//The cross product is twice the area of the triangle, so larger triangles weigh more
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+			uint32_t a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+			vec3 n = cross(mesh.positions[b] - mesh.positions[a], mesh.positions[c] - mesh.positions[a]);
+			mesh.normals[a] += n;
+			mesh.normals[b] += n;
+			mesh.normals[c] += n;
+		}
+		pool.ParallelFor(mesh.normals.size(), Grain, [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; ++i) {
+				float len = length(mesh.normals[i]);
+				mesh.normals[i] = len > 0 ? mesh.normals[i] / len : vec3(0, 1, 0);
+			}
+		});
+	}
+
+	gl::VboMeshRef Upload(const MeshData &mesh, bool allow16Bit, const PackedVertices *packed, size_t chunkBytes)
+	{
+		auto uploadChunked = [chunkBytes](const gl::VboRef &vbo, const void *data, size_t bytes) {
+			for (size_t offset = 0; offset < bytes; offset += chunkBytes)
+				vbo->bufferSubData(offset, std::min(chunkBytes, bytes - offset), (const char*)data + offset);
+		};
+		auto createVbo = [&uploadChunked](const void *data, size_t bytes) {
+			auto vbo = gl::Vbo::create(GL_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+			uploadChunked(vbo, data, bytes);
+			return vbo;
+		};
+
+		gl::VboRef positionVbo, normalVbo;
+		geom::BufferLayout positionLayout, normalLayout;
+		if (packed) {
+			positionVbo = createVbo(packed->positions.data(), packed->positions.size() * sizeof(int32_t));
+			normalVbo = createVbo(packed->normals.data(), packed->normals.size() * sizeof(int32_t));
+			positionLayout.append(geom::Attrib::POSITION, geom::DataType::INTEGER, 2, 0, 0);
+			normalLayout.append(geom::Attrib::NORMAL, geom::DataType::INTEGER, 1, 0, 0);
+		}
+		else {
+			size_t vertexBytes = mesh.positions.size() * sizeof(vec3);
+			positionVbo = createVbo(mesh.positions.data(), vertexBytes);
+			normalVbo = createVbo(mesh.normals.data(), vertexBytes);
+			positionLayout.append(geom::Attrib::POSITION, 3, 0, 0);
+			normalLayout.append(geom::Attrib::NORMAL, 3, 0, 0);
+		}
+
+		gl::VboRef indexVbo;
+		GLenum indexType;
+		if (allow16Bit && mesh.Fits16BitIndices()) {
+			indexType = GL_UNSIGNED_SHORT;
+			indexVbo = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint16_t), nullptr, GL_STATIC_DRAW);
+			size_t perChunk = std::max<size_t>(1, chunkBytes / sizeof(uint16_t));
+			std::vector<uint16_t> shortIndices;
+			for (size_t first = 0; first < mesh.indices.size(); first += perChunk) {
+				size_t count = std::min(perChunk, mesh.indices.size() - first);
+				shortIndices.assign(mesh.indices.begin() + first, mesh.indices.begin() + first + count);
+				indexVbo->bufferSubData(first * sizeof(uint16_t), count * sizeof(uint16_t), shortIndices.data());
+			}
+		}
+		else {
+			indexType = GL_UNSIGNED_INT;
+			indexVbo = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+			uploadChunked(indexVbo, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		}
+
+		return gl::VboMesh::create((uint32_t)mesh.positions.size(), GL_TRIANGLES,
+								   { { positionLayout, positionVbo }, { normalLayout, normalVbo } },
+								   (uint32_t)mesh.indices.size(), indexType, indexVbo);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "cinder/gl/gl.h"
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+
+using namespace ci;
+
+//An indexed triangle mesh on the CPU, as it comes out of the importer and before it is uploaded
+struct MeshData {
+	std::vector<vec3> positions;
+	std::vector<vec3> normals;		//Same length as positions
+	std::vector<uint32_t> indices;	//Triangles
+
+	bool Fits16BitIndices() const { return positions.size() <= 0xFFFF; }
+};
+
+//Positions and normals of a MeshData in 12 instead of 24 bytes per vertex, see MeshOptimizer::Quantize.
+//Uploaded as integer attributes, the vertex shader unpacks them with Shaders::PackedInput
+struct PackedVertices {
+	std::vector<int32_t> positions;	//Two per vertex: x | y << 16 and z, each 16 bit unsigned over min + [0, extent]
+	std::vector<int32_t> normals;	//One per vertex: octahedral x | y << 16, each 16 bit signed
+	vec3 min;
+	vec3 extent;
+};
+
+//Loads OBJ and binary PLY files. Both are parsed on the ThreadPool, OBJ in line aligned chunks of the file,
+//PLY by splitting the fixed size vertex records. Vertices that are identical are merged, missing normals are computed
+namespace MeshImport {
+
+	//Picks the format by the extension, error receives a description if false is returned
+	bool Load(const fs::path &path, MeshData &out, std::string *error = nullptr, ThreadPool &pool = ThreadPool::Shared());
+	bool LoadObj(const fs::path &path, MeshData &out, std::string *error = nullptr, ThreadPool &pool = ThreadPool::Shared());
+	bool LoadPly(const fs::path &path, MeshData &out, std::string *error = nullptr, ThreadPool &pool = ThreadPool::Shared());
+
+	//Merges vertices with bit identical position and normal
+	void Deduplicate(MeshData &mesh);
+	//Area weighted vertex normals
+	void ComputeNormals(MeshData &mesh, ThreadPool &pool = ThreadPool::Shared());
+
+	//Uploads in pieces of chunkBytes so no second full copy of the data is needed (16 bit indices are converted per chunk).
+	//16 bit indices are used whenever allow16Bit is set and the mesh is small enough.
+	//With packed the vertices are taken from it instead of the float positions and normals of mesh
+	gl::VboMeshRef Upload(const MeshData &mesh, bool allow16Bit = true, const PackedVertices *packed = nullptr,
+						  size_t chunkBytes = 4 * 1024 * 1024);
+}
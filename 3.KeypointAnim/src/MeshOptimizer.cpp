@@ -0,0 +1,223 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+namespace {
+	//The cache the scores model, larger than the simulated one as in Forsyth's article
+	const int ScoreCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	float VertexScore(int cachePosition, uint32_t trianglesLeft)
+	{
+		if (trianglesLeft == 0)
+			return -1.f;
+		float score = 0.f;
+		if (cachePosition >= 0) {
+			//The three vertices of the last triangle get a fixed score, so the next one does not just reuse the same edge
+			if (cachePosition < 3)
+				score = LastTriangleScore;
+			else
+				score = std::pow(1.f - (cachePosition - 3) / float(ScoreCacheSize - 3), CacheDecayPower);
+		}
+		//Vertices with few triangles left are finished first, otherwise they stay behind as lone triangles
+		return score + ValenceBoostScale * std::pow((float)trianglesLeft, -ValenceBoostPower);
+	}
+}
+
+namespace MeshOptimizer {
+
+	float Acmr(const std::vector<uint32_t> &indices, size_t vertexCount, int cacheSize)
+	{
+		if (indices.empty())
+			return 0.f;
+		//The time stamp a vertex entered the cache, it is still inside while fewer than cacheSize misses came after it
+		std::vector<size_t> entered(vertexCount, 0);
+		size_t misses = 0;
+		for (uint32_t v : indices) {
+			if (entered[v] == 0 || misses - entered[v] >= (size_t)cacheSize) {
+				++misses;
+				entered[v] = misses;
+			}
+		}
+		return (float)misses / (indices.size() / 3);
+	}
+
+	void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		//The triangles of every vertex in one array, the ones still to be emitted at the front of each range
+		std::vector<uint32_t> trianglesLeft(vertexCount, 0);
+		for (uint32_t v : indices)
+			++trianglesLeft[v];
+		std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			firstTriangle[v + 1] = firstTriangle[v] + trianglesLeft[v];
+		std::vector<uint32_t> trianglesOf(indices.size());
+		std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			trianglesOf[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			vertexScore[v] = VertexScore(-1, trianglesLeft[v]);
+		std::vector<float> triangleScore(triangleCount);
+		for (size_t t = 0; t < triangleCount; ++t)
+			triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		std::vector<bool> emitted(triangleCount, false);
+
+		std::vector<uint32_t> cache, nextCache;
+		cache.reserve(ScoreCacheSize + 3);
+		nextCache.reserve(ScoreCacheSize + 3);
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+		size_t scan = 0;
+		while (result.size() < indices.size()) {
+			const uint32_t *tri = &indices[best * 3];
+			result.insert(result.end(), tri, tri + 3);
+			emitted[best] = true;
+
+			//Move the triangle behind the ones still left, the front of each vertex range stays the work list
+			for (int c = 0; c < 3; ++c) {
+				uint32_t v = tri[c];
+				uint32_t *begin = &trianglesOf[firstTriangle[v]];
+				uint32_t *end = begin + trianglesLeft[v];
+				std::iter_swap(std::find(begin, end, (uint32_t)best), end - 1);
+				--trianglesLeft[v];
+			}
+
+			//The new triangle goes to the front of the cache, the rest keeps its order and the oldest fall out
+			nextCache.assign(tri, tri + 3);
+			for (uint32_t v : cache)
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					nextCache.push_back(v);
+			for (size_t i = ScoreCacheSize; i < nextCache.size(); ++i) {
+				uint32_t v = nextCache[i];
+				cachePosition[v] = -1;
+				vertexScore[v] = VertexScore(-1, trianglesLeft[v]);
+			}
+			if (nextCache.size() > (size_t)ScoreCacheSize)
+				nextCache.resize(ScoreCacheSize);
+			cache.swap(nextCache);
+
+			//Only the triangles around the cached vertices change their score
+			float bestScore = -FLT_MAX;
+			best = SIZE_MAX;
+			for (size_t i = 0; i < cache.size(); ++i) {
+				uint32_t v = cache[i];
+				cachePosition[v] = (int)i;
+				vertexScore[v] = VertexScore((int)i, trianglesLeft[v]);
+			}
+			for (uint32_t v : cache) {
+				for (uint32_t k = 0; k < trianglesLeft[v]; ++k) {
+					uint32_t t = trianglesOf[firstTriangle[v] + k];
+					float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					triangleScore[t] = score;
+					if (score > bestScore) {
+						bestScore = score;
+						best = t;
+					}
+				}
+			}
+
+			//Nothing left around the cache, continue with the next triangle in input order
+			if (best == SIZE_MAX) {
+				while (scan < triangleCount && emitted[scan])
+					++scan;
+				best = scan;
+				if (scan == triangleCount)
+					break;
+			}
+		}
+		indices.swap(result);
+	}
+
+	void OptimizeVertexFetch(MeshData &mesh)
+	{
+		bool withNormals = mesh.normals.size() == mesh.positions.size();
+		std::vector<uint32_t> newIndex(mesh.positions.size(), UINT32_MAX);
+		std::vector<vec3> positions, normals;
+		positions.reserve(mesh.positions.size());
+		if (withNormals)
+			normals.reserve(mesh.normals.size());
+		for (uint32_t &index : mesh.indices) {
+			if (newIndex[index] == UINT32_MAX) {
+				newIndex[index] = (uint32_t)positions.size();
+				positions.push_back(mesh.positions[index]);
+				if (withNormals)
+					normals.push_back(mesh.normals[index]);
+			}
+			index = newIndex[index];
+		}
+		//Vertices no triangle uses are dropped
+		mesh.positions.swap(positions);
+		if (withNormals)
+			mesh.normals.swap(normals);
+	}
+
+	Report Optimize(MeshData &mesh)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		Report report;
+		report.acmrBefore = Acmr(mesh.indices, mesh.positions.size());
+		OptimizeVertexCache(mesh.indices, mesh.positions.size());
+		OptimizeVertexFetch(mesh);
+		report.acmrAfter = Acmr(mesh.indices, mesh.positions.size());
+		report.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return report;
+	}
+
+	PackedVertices Quantize(const MeshData &mesh)
+	{
+		PackedVertices packed;
+		vec3 min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const vec3 &p : mesh.positions) {
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		if (mesh.positions.empty())
+			min = max = vec3(0, 0, 0);
+		packed.min = min;
+		packed.extent = max - min;
+
+		auto toUnorm16 = [](float value, float lo, float extent) -> uint32_t {
+			return extent > 0 ? (uint32_t)std::lround((value - lo) / extent * 65535.f) : 0;
+		};
+		auto toSnorm16 = [](float value) -> uint32_t {
+			return (uint16_t)(int16_t)std::lround(glm::clamp(value, -1.f, 1.f) * 32767.f);
+		};
+
+		packed.positions.resize(mesh.positions.size() * 2);
+		for (size_t i = 0; i < mesh.positions.size(); ++i) {
+			const vec3 &p = mesh.positions[i];
+			uint32_t x = toUnorm16(p.x, min.x, packed.extent.x);
+			uint32_t y = toUnorm16(p.y, min.y, packed.extent.y);
+			uint32_t z = toUnorm16(p.z, min.z, packed.extent.z);
+			packed.positions[i * 2] = (int32_t)(x | y << 16);
+			packed.positions[i * 2 + 1] = (int32_t)z;
+		}
+
+		//Octahedral: project onto |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+		packed.normals.resize(mesh.normals.size());
+		for (size_t i = 0; i < mesh.normals.size(); ++i) {
+			vec3 n = mesh.normals[i];
+			float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+			n = sum > 0 ? n / sum : vec3(0, 0, 1);
+			vec2 e(n.x, n.y);
+			if (n.z < 0)
+				e = vec2((1 - std::abs(n.y)) * (n.x >= 0 ? 1.f : -1.f), (1 - std::abs(n.x)) * (n.y >= 0 ? 1.f : -1.f));
+			packed.normals[i] = (int32_t)(toSnorm16(e.x) | toSnorm16(e.y) << 16);
+		}
+		return packed;
+	}
+}
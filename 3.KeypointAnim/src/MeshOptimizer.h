@@ -0,0 +1,34 @@
+#pragma once
+#include "MeshImport.h"
+#include <vector>
+
+//Memory layout passes that run on a MeshData before it is uploaded.
+//The triangle order decides how often the GPU finds a vertex in its post transform cache, the vertex order how far apart
+//the fetches of a triangle are. Only plain data is touched, everything here may run on any thread
+namespace MeshOptimizer {
+
+	//Size of the simulated FIFO cache, about what current GPUs keep of transformed vertices
+	const int CacheSize = 16;
+
+	struct Report {
+		float acmrBefore;		//Average cache miss ratio: transformed vertices per triangle, 0.5 is the best possible, 3 the worst
+		float acmrAfter;
+		double ms;
+	};
+
+	//Transformed vertices per triangle when drawing indices through a FIFO cache of cacheSize entries
+	float Acmr(const std::vector<uint32_t> &indices, size_t vertexCount, int cacheSize = CacheSize);
+
+	//Reorders the triangles greedily for the post transform cache (Forsyth, "Linear-Speed Vertex Cache Optimisation"):
+	//the next triangle is the one whose vertices are most recently used and have the fewest triangles left
+	void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+	//Renumbers the vertices in the order the triangles first use them, so the fetches walk the buffers forward
+	void OptimizeVertexFetch(MeshData &mesh);
+
+	//Both of the above, cache order first because the fetch order follows it
+	Report Optimize(MeshData &mesh);
+
+	//Positions as 16 bit steps over the bounds, normals octahedral encoded in 2 x 16 bit
+	PackedVertices Quantize(const MeshData &mesh);
+}
@@ -0,0 +1,125 @@
+#include "PoseRecorder.h"
+#include <algorithm>
+
+void PoseRecorder::Start(const std::vector<vec3> &pose, float newRate, size_t frameCapacity, size_t entryCapacity)
+{
+	rate = newRate;
+	sinceCapture = 0.f;
+	base = pose;
+	last = pose;
+	playFrom = pose;
+	playTo = pose;
+	frames.assign(std::max<size_t>(frameCapacity, 2), Frame());
+	entries.assign(std::max(entryCapacity, pose.size()), Delta());
+	firstFrame = firstEntry = entryCount = 0;
+	frames[0] = { 0, 0 };
+	frameCount = 1;
+	playStarted = false;
+	recording = true;
+}
+
+void PoseRecorder::Clear()
+{
+	recording = false;
+	frameCount = 0;
+	entryCount = 0;
+	playStarted = false;
+}
+
+void PoseRecorder::Update(float dt, const std::vector<vec3> &pose)
+{
+	if (!recording || pose.size() != last.size())
+		return;
+	sinceCapture += dt;
+	//A slow frame captures the same pose more than once, so the frames stay 1 / rate apart
+	while (sinceCapture >= 1.f / rate) {
+		sinceCapture -= 1.f / rate;
+		Push(pose);
+	}
+}
+
+void PoseRecorder::Push(const std::vector<vec3> &pose)
+{
+	uint32_t changed = 0;
+	for (size_t i = 0; i < pose.size(); ++i)
+		if (pose[i] != last[i])
+			++changed;
+	while (frameCount == frames.size() || entryCount + changed > entries.size())
+		DropOldest();
+
+	Frame frame = { (firstEntry + entryCount) % entries.size(), changed };
+	for (uint32_t i = 0; i < (uint32_t)pose.size(); ++i) {
+		if (pose[i] == last[i])
+			continue;
+		entries[(firstEntry + entryCount) % entries.size()] = { i, pose[i] - last[i] };
+		++entryCount;
+		last[i] = pose[i];
+	}
+	frames[(firstFrame + frameCount) % frames.size()] = frame;
+	++frameCount;
+}
+
+//The second oldest frame becomes the base, its deltas are no longer needed after that
+void PoseRecorder::DropOldest()
+{
+	firstFrame = (firstFrame + 1) % frames.size();
+	--frameCount;
+	Frame &oldest = frames[firstFrame];
+	ApplyFrame(0, base);
+	firstEntry = (firstEntry + oldest.count) % entries.size();
+	entryCount -= oldest.count;
+	oldest.count = 0;
+	//Playback holds poses relative to the frames it started from
+	playStarted = false;
+}
+
+void PoseRecorder::ApplyFrame(size_t frame, std::vector<vec3> &pose) const
+{
+	const Frame &f = FrameAt(frame);
+	for (uint32_t k = 0; k < f.count; ++k) {
+		const Delta &d = entries[(f.first + k) % entries.size()];
+		pose[d.point] += d.offset;
+	}
+}
+
+void PoseRecorder::Rewind()
+{
+	std::copy(base.begin(), base.end(), playFrom.begin());
+	std::copy(base.begin(), base.end(), playTo.begin());
+	if (frameCount > 1)
+		ApplyFrame(1, playTo);
+	playFrame = 0;
+	playTime = 0.f;
+	playStarted = true;
+}
+
+bool PoseRecorder::Play(float dt, std::vector<vec3> &pose)
+{
+	if (recording || frameCount < 2 || pose.size() != base.size())
+		return false;
+	if (!playStarted)
+		Rewind();
+
+	playTime += dt;
+	while (playTime >= 1.f / rate) {
+		playTime -= 1.f / rate;
+		if (playFrame + 2 >= frameCount) {
+			Rewind();
+			continue;
+		}
+		++playFrame;
+		std::copy(playTo.begin(), playTo.end(), playFrom.begin());
+		ApplyFrame(playFrame + 1, playTo);
+	}
+
+	float s = playTime * rate;
+	for (size_t i = 0; i < pose.size(); ++i)
+		pose[i] = playFrom[i] + s * (playTo[i] - playFrom[i]);
+	return true;
+}
+
+size_t PoseRecorder::Bytes() const
+{
+	return (base.size() + last.size() + playFrom.size() + playTo.size()) * sizeof(vec3)
+		 + frames.size() * sizeof(Frame) + entries.size() * sizeof(Delta);
+}
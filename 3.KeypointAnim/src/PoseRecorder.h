@@ -0,0 +1,61 @@
+#pragma once
+#include "cinder/gl/gl.h"
+#include <vector>
+
+using namespace ci;
+
+//Records the control points of the lattice at a fixed rate and plays them back in a loop.
+//A frame only stores the points that moved since the frame before, as (point, offset) pairs. Frames and pairs live in two
+//rings that are allocated once by Start(). When either ring is full the oldest frame is folded into the base pose and
+//its room reused, so a long session keeps the latest part of the recording instead of growing.
+//Playback walks the same rings and keeps the two poses it interpolates between, nothing is allocated per frame
+class PoseRecorder {
+public:
+	//Begins a recording at pose. entryCapacity is the number of moved points all frames together can hold,
+	//at least one full pose is always reserved
+	void Start(const std::vector<vec3> &pose, float rate = 30.f, size_t frameCapacity = 1800, size_t entryCapacity = 65536);
+	void Stop() { recording = false; }
+	void Clear();
+	//Captures pose every 1 / rate seconds, dt is the time since the last call
+	void Update(float dt, const std::vector<vec3> &pose);
+	//Writes the recorded pose at the playback time into pose, false if there is nothing to play
+	bool Play(float dt, std::vector<vec3> &pose);
+	void Rewind();
+
+	bool recording = false;
+	size_t FrameCount() const { return frameCount; }
+	float Duration() const { return frameCount > 1 ? (frameCount - 1) / rate : 0.f; }
+	size_t Bytes() const;			//Allocated by Start(), does not change while recording
+
+private:
+	struct Delta {
+		uint32_t point;
+		vec3 offset;
+	};
+	struct Frame {
+		size_t first;				//Position of the first Delta in the entry ring
+		uint32_t count;
+	};
+
+	void Push(const std::vector<vec3> &pose);
+	void DropOldest();
+	void ApplyFrame(size_t frame, std::vector<vec3> &pose) const;	//frame counts from the oldest one
+	const Frame& FrameAt(size_t frame) const { return frames[(firstFrame + frame) % frames.size()]; }
+
+	float rate = 30.f;
+	float sinceCapture = 0.f;
+	std::vector<vec3> base;			//The pose of the oldest frame, its own deltas are already applied
+	std::vector<vec3> last;			//The pose of the newest frame, the next one is encoded against it
+	std::vector<Frame> frames;
+	size_t firstFrame = 0;
+	size_t frameCount = 0;
+	std::vector<Delta> entries;
+	size_t firstEntry = 0;
+	size_t entryCount = 0;
+
+	std::vector<vec3> playFrom;		//The poses of the frames playFrame and playFrame + 1
+	std::vector<vec3> playTo;
+	size_t playFrame = 0;
+	float playTime = 0.f;
+	bool playStarted = false;
+};
@@ -0,0 +1,147 @@
+#include "Shaders.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+//Cinder can only create a GlslProg from sources, not from a program binary, and the macOS drivers offer no binary formats anyway.
+//So the disk cache keeps the sources of every permutation that was used, and they are compiled at startup instead of on first use.
+namespace Shaders {
+
+	namespace {
+		struct CacheEntry {
+			std::string key;		//The full sources, to tell hash collisions apart
+			gl::GlslProgRef prog;
+		};
+
+		std::map<uint64_t, CacheEntry> programs;
+		CacheStats stats;
+		fs::path diskCacheDir;
+		const char* const FragmentSeparator = "\n//fragment\n";
+
+		//FNV-1a, unlike std::hash it is the same on every run, so it can name the files of the disk cache
+		uint64_t Hash(const std::string &s)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (unsigned char c : s) {
+				hash ^= c;
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		std::string Key(const std::string &vertex, const std::string &fragment, bool feedback)
+		{
+			return (feedback ? "feedback\n" : "plain\n") + vertex + FragmentSeparator + fragment;
+		}
+
+		gl::GlslProgRef Compile(const std::string &vertex, const std::string &fragment, bool feedback)
+		{
+			auto format = gl::GlslProg::Format().vertex(vertex).fragment(fragment);
+			if (feedback)
+				format.feedbackFormat(GL_INTERLEAVED_ATTRIBS).feedbackVaryings({ "position", "normal" });
+
+			auto start = std::chrono::high_resolution_clock::now();
+			auto prog = gl::GlslProg::create(format);
+			stats.compileMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			stats.compiles++;
+			return prog;
+		}
+
+		void Store(uint64_t hash, const std::string &key)
+		{
+			if (diskCacheDir.empty())
+				return;
+			std::ostringstream name;
+			name << std::hex << hash << ".glsl";
+			fs::path path = diskCacheDir / name.str();
+			if (fs::exists(path))
+				return;
+			std::ofstream file(path.string(), std::ios::binary);
+			file << key;
+		}
+
+		//hit is set if no compile was needed
+		gl::GlslProgRef Lookup(const std::string &vertex, const std::string &fragment, bool feedback, bool &hit)
+		{
+			std::string key = Key(vertex, fragment, feedback);
+			uint64_t hash = Hash(key);
+			auto it = programs.find(hash);
+			hit = it != programs.end() && it->second.key == key;
+			if (hit)
+				return it->second.prog;
+
+			auto prog = Compile(vertex, fragment, feedback);
+			if (it == programs.end()) {
+				programs[hash] = { key, prog };
+				Store(hash, key);
+			}
+			return prog;
+		}
+	}
+
+	gl::GlslProgRef GetProgram(const std::string &vertex, const std::string &fragment, bool feedback)
+	{
+		bool hit;
+		auto prog = Lookup(vertex, fragment, feedback, hit);
+		if (hit)
+			stats.hits++;
+		return prog;
+	}
+
+	void WarmUp(const std::vector<std::string> &vertexSources)
+	{
+		for (const std::string &vertex : vertexSources) {
+			bool hit;
+			Lookup(vertex, ShadedFragment, true, hit);
+			if (!hit)
+				stats.warmedUp++;
+		}
+	}
+
+	void EnableDiskCache(const fs::path &dir)
+	{
+		diskCacheDir = dir;
+		if (!fs::exists(dir) && !fs::create_directories(dir)) {
+			diskCacheDir.clear();
+			return;
+		}
+
+		std::vector<fs::path> files;
+		for (fs::directory_iterator it(dir), end; it != end; ++it)
+			if (it->path().extension() == ".glsl")
+				files.push_back(it->path());
+
+		for (const fs::path &path : files) {
+			std::ifstream file(path.string(), std::ios::binary);
+			std::string key((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			size_t header = key.find('\n');
+			size_t separator = key.find(FragmentSeparator);
+			if (header == std::string::npos || separator == std::string::npos)
+				continue;
+			bool feedback = key.compare(0, header, "feedback") == 0;
+			std::string vertex = key.substr(header + 1, separator - header - 1);
+			std::string fragment = key.substr(separator + strlen(FragmentSeparator));
+
+			//A permutation that no longer compiles (e.g. after a change to the libraries) is dropped from the cache
+			try {
+				bool hit;
+				Lookup(vertex, fragment, feedback, hit);
+				if (!hit)
+					stats.warmedUp++;
+			}
+			catch (const gl::GlslProgExc &) {
+				file.close();
+				fs::remove(path);
+			}
+		}
+	}
+
+	CacheStats& Stats()
+	{
+		return stats;
+	}
+}
@@ -4,200 +4,377 @@
 #include "cinder/params/Params.h"
 #include "Mesh.h"
 #include "CamControl.h"
+#include <string>
+#include <vector>
+
+//Like CI_GLSL but without the #version line, so the pieces below can be combined into one shader
+#define GLSL_SNIPPET(CODE) #CODE
 
 namespace Shaders {
 
-	gl::GlslProgRef static GetDeformationShader() {
-		return gl::GlslProg::create(gl::GlslProg::Format()
-			.vertex(CI_GLSL(150,
-				uniform mat4	ciModelViewProjection;
-		uniform int		deformMode;
-		uniform float	t;   //time, varies between 0..1
-		uniform vec3    min; //vector containing the minima of the object
-		uniform vec3	max; //contains the maximal values of the object
-		const float M_PI = 3.14159;
+	//Every program is shared through a cache keyed by a hash of its sources, see Shaders.cpp
+	struct CacheStats {
+		int compiles = 0;			//Programs compiled and linked
+		int hits = 0;				//Requests served from the cache, each one a compile avoided
+		int warmedUp = 0;			//Compiled ahead of time by WarmUp or from the disk cache
+		float compileMs = 0;		//Total time spent compiling
+	};
+
+	gl::GlslProgRef GetProgram(const std::string &vertex, const std::string &fragment, bool feedback);
+	//Compiles the deforming programs of these vertex shaders now instead of on first use
+	void WarmUp(const std::vector<std::string> &vertexSources);
+	//Remembers every compiled permutation in dir and compiles the ones found there right away
+	void EnableDiskCache(const fs::path &dir);
+	CacheStats& Stats();
+
+	//Bounds of the undeformed mesh, used by the built in deformations and alongCurve
+	static const char* const BoundsLibrary = GLSL_SNIPPET(
+		uniform vec3    meshMin; //vector containing the minima of the object
+		uniform vec3	meshMax; //contains the maximal values of the object
+	);
 
-		in vec3			ciPosition;			//The vertices of the mesh
-		out vec4		worldPosition;		//The modified output vertice you must set
+	//The deformations, every one comes with its Jacobian (column a is the derivative along axis a)
+	static const char* const DeformationLibrary = GLSL_SNIPPET(
+		const float M_PI = 3.14159;
 
-		vec4 taper(vec4 pos, float k)
+		vec3 taper(vec3 pos, float k)
 		{
-			vec4 taperedPos = pos;
-            
-            float s = (max.y - pos.y)/(max.y - min.y);
-                        
-            taperedPos.x = k * s * taperedPos.x + (1-k) * taperedPos.x;
-            taperedPos.z = k * s * taperedPos.z + (1-k) * taperedPos.z;
-            
+			vec3 taperedPos = pos;
+			float s = (meshMax.y - pos.y) / (meshMax.y - meshMin.y);
+			taperedPos.x = k * s * taperedPos.x + (1 - k) * taperedPos.x;
+			taperedPos.z = k * s * taperedPos.z + (1 - k) * taperedPos.z;
 			return taperedPos;
 		}
 
-		vec4 twist(vec4 pos, float k)
+		mat3 taperJacobian(vec3 pos, float k)
 		{
-			vec4 twistedPos = pos;
-            
-            float cosTerm = cos(k * pos.y * M_PI);
-            float sinTerm = sin(k * pos.y * M_PI);
-            
-            twistedPos.x = pos.x * cosTerm - pos.z * sinTerm;
-            twistedPos.z = pos.x * sinTerm + pos.z * cosTerm;
-			
-			return twistedPos;
+			float f = k * (meshMax.y - pos.y) / (meshMax.y - meshMin.y) + (1 - k);
+			float dfdy = -k / (meshMax.y - meshMin.y);
+			return mat3(vec3(f, 0, 0), vec3(pos.x * dfdy, 1, pos.z * dfdy), vec3(0, 0, f));
 		}
 
+		vec3 twist(vec3 pos, float k)
+		{
+			vec3 twistedPos = pos;
+			float cosTerm = cos(k * pos.y * M_PI);
+			float sinTerm = sin(k * pos.y * M_PI);
+			twistedPos.x = pos.x * cosTerm - pos.z * sinTerm;
+			twistedPos.z = pos.x * sinTerm + pos.z * cosTerm;
+			return twistedPos;
+		}
 
-		float calcTheta(float y, float ymin, float ymax)
+		mat3 twistJacobian(vec3 pos, float k)
 		{
-			if (y < ymin) return 0.0;
-			if (y > ymax) return ymax - ymin;
-			return y - ymin;
+			float cosTerm = cos(k * pos.y * M_PI);
+			float sinTerm = sin(k * pos.y * M_PI);
+			float dtdy = k * M_PI;
+			return mat3(vec3(cosTerm, 0, sinTerm),
+						vec3(dtdy * (-pos.x * sinTerm - pos.z * cosTerm), 1, dtdy * (pos.x * cosTerm - pos.z * sinTerm)),
+						vec3(-sinTerm, 0, cosTerm));
 		}
 
-		vec4 bend(vec4 pos, float k)
+		vec3 bend(vec3 pos, float k)
 		{
 			float z0 = -1;			// The z coordinate of the "bend point"
 			float ymin = (1-k)*2-0.75;	// = zmin in the book
 			float ymax = 1;			// = zmax in the book
-            float teta = pos.y - ymin;
-            float r = z0 - pos.z;
-			vec4 bentPos = pos;
-			//todo: Task3 begin
-            
-            if (pos.y > ymax) {
-                teta = ymax - ymin;
-                bentPos.y = ymin - (r * sin(teta)) + (pos.y - ymax) * cos(teta);
-                bentPos.z = z0 - (r * cos(teta)) + (pos.y - ymax) * sin(teta);
-            }
-            else if (pos.y >= ymin) {
-                bentPos.y = ymin - (r * sin(teta));
-                bentPos.z = z0 - (r * cos(teta));
-            }
-
+			float teta = pos.y - ymin;
+			float r = z0 - pos.z;
+			vec3 bentPos = pos;
+			if (pos.y > ymax) {
+				teta = ymax - ymin;
+				bentPos.y = ymin - (r * sin(teta)) + (pos.y - ymax) * cos(teta);
+				bentPos.z = z0 - (r * cos(teta)) + (pos.y - ymax) * sin(teta);
+			}
+			else if (pos.y >= ymin) {
+				bentPos.y = ymin - (r * sin(teta));
+				bentPos.z = z0 - (r * cos(teta));
+			}
 			return bentPos;
-			//Task 3 end
-		}
-                            
-        vec4 otherDeformation(vec4 pos, float k)
-        {
-            vec4 transformedPos = pos;
-            
-            float cosTerm = cos(k * pos.y * M_PI);
-            float sinTerm = sin(k * pos.y * M_PI);
-            
-            transformedPos.x = pos.x * log(1 + pos.y) * k + pos.x * (1 -k);
-//            transformedPos.z = pos.x * log(1 + k * pos.y);
-        
-            
-            return transformedPos;
-        }
+		}
 
-		void main(void) {
-			
-			if (deformMode == 0)
-				worldPosition = taper(vec4(ciPosition, 1), t);
-			else if (deformMode == 1)
-				worldPosition = twist(vec4(ciPosition, 1), t);
-			else if (deformMode == 2)
-				worldPosition = bend(vec4(ciPosition,1),t);
-            else if (deformMode == 3)
-                worldPosition = otherDeformation(vec4(ciPosition,1),t);
-			gl_Position = ciModelViewProjection * worldPosition;
-		}
-		))
-			.geometry(CI_GLSL(150,
-				layout(triangles) in;
-		layout(triangle_strip, max_vertices = 3)out;
-
-		in vec4 worldPosition[];
-		out vec3 normal;
-
-		void main() {
-			normal = normalize(cross(worldPosition[1].xyz - worldPosition[0].xyz, worldPosition[2].xyz - worldPosition[0].xyz));
-			gl_Position = gl_in[0].gl_Position;
-			EmitVertex();
-			gl_Position = gl_in[1].gl_Position;
-			EmitVertex();
-			gl_Position = gl_in[2].gl_Position;
-			EmitVertex();
-			EndPrimitive();
-		}
-		))
-			.fragment(CI_GLSL(150,
-				out vec4			oColor;
-		in vec3		normal;
-		uniform vec3	    lightDir;
+		mat3 bendJacobian(vec3 pos, float k)
+		{
+			float z0 = -1;
+			float ymin = (1-k)*2-0.75;
+			float ymax = 1;
+			float r = z0 - pos.z;
+			if (pos.y > ymax) {
+				float teta = ymax - ymin;
+				return mat3(vec3(1, 0, 0), vec3(0, cos(teta), sin(teta)), vec3(0, sin(teta), cos(teta)));
+			}
+			if (pos.y >= ymin) {
+				float teta = pos.y - ymin;
+				return mat3(vec3(1, 0, 0), vec3(0, -r * cos(teta), r * sin(teta)), vec3(0, sin(teta), cos(teta)));
+			}
+			return mat3(1.0);
+		}
 
-		void main(void) {
-			oColor = vec4(vec3(1, 0.5, 0.25) * (max(dot(lightDir, normal), 0) + 0.2), 1);
+		vec3 otherDeformation(vec3 pos, float k)
+		{
+			vec3 transformedPos = pos;
+			transformedPos.x = pos.x * log(1 + pos.y) * k + pos.x * (1 - k);
+			return transformedPos;
 		}
-		)));
-	}
 
-	gl::GlslProgRef static GetFFDShader() {
-		return gl::GlslProg::create(gl::GlslProg::Format()
-			.vertex(CI_GLSL(150,
-		uniform mat4	ciModelViewProjection;
-		//The Control points describe the corners of a cube
-		uniform vec3 controlPointsOrig[8];  //This array holds the corners of the cube and does not change (it is always (-1,-1,-1), (-1,1,-1)....)
-		uniform vec3 controlPoints[8];      //This array holds the current position of the control points and will change every frame
+		mat3 otherDeformationJacobian(vec3 pos, float k)
+		{
+			float f = log(1 + pos.y) * k + (1 - k);
+			return mat3(vec3(f, 0, 0), vec3(pos.x * k / (1 + pos.y), 1, 0), vec3(0, 0, 1));
+		}
+	);
+
+	//The FFD lattice: all positions are absolute, no need for any model->world transformations
+	static const char* const FFDLibrary = GLSL_SNIPPET(
+		//The control points form a l x m x n lattice spanning the box boxMin..boxMax (-1..1 unless refitted)
+		uniform samplerBuffer controlPoints;	//Current positions of the lattice points, stored as i + l*(j + m*k)
+		uniform ivec3 latticeRes;				//Number of points on each axis
+		uniform int   basis;					//0: bernstein (2x2x2 is the trilinear cube), 1: cubic b-spline
+		uniform vec3  boxMin;
+		uniform vec3  boxMax;
 		uniform mat4 mv;					//This matrix is only used to center the teapot
+		uniform int   useBinding;			//1: the weights of every vertex were precomputed by Volume::Bind
+		uniform samplerBuffer bindingWeights;	//bindingStride (lattice index, weight) pairs per vertex
+		uniform samplerBuffer bindingGradients;	//The gradient of every weight, for the normals
+		uniform int   bindingStride;
+		const int MAX_RES = 16;
+
+		//Weights of all points on one axis that influence x and their derivatives, returns the index of the first of them
+		int axisWeights(float x, float lo, float hi, int res, out float w[MAX_RES], out float dw[MAX_RES])
+		{
+			float s = (x - lo) / (hi - lo);
+			if (basis == 1) {
+				float c = s * float(res - 3);
+				int cell = clamp(int(floor(c)), 0, res - 4);
+				float u = c - float(cell);
+				float u2 = u * u;
+				float u3 = u2 * u;
+				float dudx = float(res - 3) / (hi - lo);
+				w[0] = (1 - u) * (1 - u) * (1 - u) / 6.0;
+				w[1] = (3 * u3 - 6 * u2 + 4) / 6.0;
+				w[2] = (-3 * u3 + 3 * u2 + 3 * u + 1) / 6.0;
+				w[3] = u3 / 6.0;
+				dw[0] = -(1 - u) * (1 - u) / 2.0 * dudx;
+				dw[1] = (3 * u2 - 4 * u) / 2.0 * dudx;
+				dw[2] = (-3 * u2 + 2 * u + 1) / 2.0 * dudx;
+				dw[3] = u2 / 2.0 * dudx;
+				return cell;
+			}
+			w[0] = 1.0;
+			for (int d = 1; d < res; d++) {
+				if (d == res - 1) {
+					for (int i = 0; i < res; i++) {
+						float lower = i > 0 ? w[i - 1] : 0.0;
+						float upper = i < d ? w[i] : 0.0;
+						dw[i] = float(d) * (lower - upper) / (hi - lo);
+					}
+				}
+				w[d] = w[d - 1] * s;
+				for (int i = d - 1; i > 0; i--)
+					w[i] = w[i] * (1 - s) + w[i - 1] * s;
+				w[0] *= 1 - s;
+			}
+			return 0;
+		}
 
-		//All positions are absolute, no need for any model->world transformations
-		in vec3			ciPosition;			//The vertices of the mesh
-		out vec4		worldPosition;		//The modified output vertice you must set
+		vec3 transformPoint(vec3 p, out mat3 J)
+		{
+			float wx[MAX_RES];
+			float wy[MAX_RES];
+			float wz[MAX_RES];
+			float dx[MAX_RES];
+			float dy[MAX_RES];
+			float dz[MAX_RES];
+			int fx = axisWeights(p.x, boxMin.x, boxMax.x, latticeRes.x, wx, dx);
+			int fy = axisWeights(p.y, boxMin.y, boxMax.y, latticeRes.y, wy, dy);
+			int fz = axisWeights(p.z, boxMin.z, boxMax.z, latticeRes.z, wz, dz);
+			ivec3 support = basis == 1 ? ivec3(4, 4, 4) : latticeRes;
+
+			vec3 transformedPos = vec3(0, 0, 0);
+			J = mat3(0.0);
+			for (int k = 0; k < support.z; k++) {
+				for (int j = 0; j < support.y; j++) {
+					int row = fx + latticeRes.x * (fy + j + latticeRes.y * (fz + k));
+					for (int i = 0; i < support.x; i++) {
+						vec3 cp = texelFetch(controlPoints, row + i).xyz;
+						transformedPos += wx[i] * wy[j] * wz[k] * cp;
+						J[0] += dx[i] * wy[j] * wz[k] * cp;
+						J[1] += wx[i] * dy[j] * wz[k] * cp;
+						J[2] += wx[i] * wy[j] * dz[k] * cp;
+					}
+				}
+			}
+			return transformedPos;
+		}
 
-		
-		vec3 transformPoint(vec3 p)
+		//Weighted sum over the precomputed pairs, no basis evaluation needed
+		vec3 boundPoint(out mat3 J)
 		{
-			//todo: Task4
-			//Assume that the Source cube always is -1..1 on each axis
-			//Have a look at controlPointsOrig and controlPoints
-			float dep[8];
 			vec3 transformedPos = vec3(0, 0, 0);
-                        
-            for (int i = 0; i < 8; i++) {
-                vec3 distance = - abs(p - controlPointsOrig[i]) / 2 + 1;
-                dep[i] = distance.x * distance.y * distance.z;
-                transformedPos += dep[i] * controlPoints[i];
-            }
-            
+			J = mat3(0.0);
+			int first = gl_VertexID * bindingStride;
+			for (int s = 0; s < bindingStride; s++) {
+				vec2 pair = texelFetch(bindingWeights, first + s).xy;
+				vec3 gradient = texelFetch(bindingGradients, first + s).xyz;
+				vec3 cp = texelFetch(controlPoints, int(pair.x)).xyz;
+				transformedPos += pair.y * cp;
+				J[0] += gradient.x * cp;
+				J[1] += gradient.y * cp;
+				J[2] += gradient.z * cp;
+			}
 			return transformedPos;
-			//Task4 end
 		}
+	);
 
-		void main(void) {
-			vec3 pos = transformPoint((mv * vec4(ciPosition,1)).xyz);
-			worldPosition = vec4(pos,1);
-			gl_Position = ciModelViewProjection * worldPosition;
-		}
-
-		))
-			.geometry(CI_GLSL(150,
-				layout(triangles) in;
-		layout(triangle_strip, max_vertices = 3)out;
-
-		in vec4 worldPosition[];
-		out vec3 normal;
-
-		void main() {
-			normal = normalize(cross(worldPosition[1].xyz - worldPosition[0].xyz, worldPosition[2].xyz - worldPosition[0].xyz));
-			gl_Position = gl_in[0].gl_Position;
-			EmitVertex();
-			gl_Position = gl_in[1].gl_Position;
-			EmitVertex();
-			gl_Position = gl_in[2].gl_Position;
-			EmitVertex();
-			EndPrimitive();
-		}
-		))
-			.fragment(CI_GLSL(150,
-				out vec4			oColor;
+	//Lays the mesh along a curve, the GLSL side of CurveDeformer
+	static const char* const CurveLibrary = GLSL_SNIPPET(
+		uniform samplerBuffer curveTable;	//position, normal and binormal of every entry, the entries are equal arc lengths apart
+		uniform int   curveEntries;			//Less than 2: no curve, the mesh stays where it is
+		uniform int   curveAxis;			//Axis of the mesh along the curve, the next two follow normal and binormal
+
+		//Position on the mesh axis in entries of the table, i is the entry before it and f the fraction towards the next
+		float curveCoordinate(vec3 pos, out int i, out float f)
+		{
+			float extent = meshMax[curveAxis] - meshMin[curveAxis];
+			float scale = extent > 0 ? float(curveEntries - 1) / extent : 0.0;
+			float x = clamp((pos[curveAxis] - meshMin[curveAxis]) * scale, 0.0, float(curveEntries - 1));
+			i = min(int(x), curveEntries - 2);
+			f = x - float(i);
+			return scale;
+		}
+
+		vec3 alongCurve(vec3 pos, float k)
+		{
+			if (curveEntries < 2)
+				return pos;
+			int i;
+			float f;
+			curveCoordinate(pos, i, f);
+			vec3 center = (meshMin + meshMax) * 0.5;
+			float u = pos[(curveAxis + 1) % 3] - center[(curveAxis + 1) % 3];
+			float v = pos[(curveAxis + 2) % 3] - center[(curveAxis + 2) % 3];
+			vec3 position = mix(texelFetch(curveTable, 3 * i).xyz, texelFetch(curveTable, 3 * i + 3).xyz, f);
+			vec3 normal = mix(texelFetch(curveTable, 3 * i + 1).xyz, texelFetch(curveTable, 3 * i + 4).xyz, f);
+			vec3 binormal = mix(texelFetch(curveTable, 3 * i + 2).xyz, texelFetch(curveTable, 3 * i + 5).xyz, f);
+			return mix(pos, position + u * normal + v * binormal, k);
+		}
+
+		mat3 alongCurveJacobian(vec3 pos, float k)
+		{
+			if (curveEntries < 2)
+				return mat3(1.0);
+			int i;
+			float f;
+			float scale = curveCoordinate(pos, i, f);
+			vec3 center = (meshMin + meshMax) * 0.5;
+			float u = pos[(curveAxis + 1) % 3] - center[(curveAxis + 1) % 3];
+			float v = pos[(curveAxis + 2) % 3] - center[(curveAxis + 2) % 3];
+			vec3 p0 = texelFetch(curveTable, 3 * i).xyz;
+			vec3 n0 = texelFetch(curveTable, 3 * i + 1).xyz;
+			vec3 b0 = texelFetch(curveTable, 3 * i + 2).xyz;
+			vec3 p1 = texelFetch(curveTable, 3 * i + 3).xyz;
+			vec3 n1 = texelFetch(curveTable, 3 * i + 4).xyz;
+			vec3 b1 = texelFetch(curveTable, 3 * i + 5).xyz;
+			mat3 J;
+			J[curveAxis] = scale * (p1 - p0 + u * (n1 - n0) + v * (b1 - b0));
+			J[(curveAxis + 1) % 3] = mix(n0, n1, f);
+			J[(curveAxis + 2) % 3] = mix(b0, b1, f);
+			return (1 - k) * mat3(1.0) + k * J;
+		}
+	);
+
+	static const char* const NormalLibrary = GLSL_SNIPPET(
+		//Cofactor matrix of J, that is det(J) * transpose(inverse(J)) without computing an inverse
+		vec3 transformNormal(mat3 J, vec3 n)
+		{
+			return normalize(mat3(cross(J[1], J[2]), cross(J[2], J[0]), cross(J[0], J[1])) * n);
+		}
+	);
+
+	//The vertex inputs of the deforming programs, restPosition() and restNormal() hide how the mesh stores them
+	static const char* const FloatInput = GLSL_SNIPPET(
+		in vec3			ciPosition;
+		in vec3			ciNormal;
+
+		vec3 restPosition() { return ciPosition; }
+		vec3 restNormal() { return ciNormal; }
+	);
+
+	//PackedVertices: 16 bit positions over the bounds of the mesh and octahedral 16 bit normals
+	static const char* const PackedInput = GLSL_SNIPPET(
+		uniform vec3	quantMin;
+		uniform vec3	quantExtent;
+		in ivec2		ciPosition;
+		in int			ciNormal;
+
+		vec3 restPosition()
+		{
+			vec3 q = vec3(ciPosition.x & 0xFFFF, (ciPosition.x >> 16) & 0xFFFF, ciPosition.y & 0xFFFF);
+			return quantMin + q / 65535.0 * quantExtent;
+		}
+
+		float snorm16(int bits)
+		{
+			return clamp(float(bits >= 32768 ? bits - 65536 : bits) / 32767.0, -1.0, 1.0);
+		}
+
+		vec3 restNormal()
+		{
+			vec2 e = vec2(snorm16(ciNormal & 0xFFFF), snorm16((ciNormal >> 16) & 0xFFFF));
+			vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+			if (n.z < 0)
+				n.xy = (1.0 - abs(e.yx)) * sign(e);
+			return normalize(n);
+		}
+	);
+
+	static const char* VertexInput(bool packed) { return packed ? PackedInput : FloatInput; }
+
+	static const char* const ShadedFragment = CI_GLSL(150,
+		out vec4			oColor;
 		in vec3		normal;
 		uniform vec3	    lightDir;
 
 		void main(void) {
-			oColor = vec4(vec3(1, 0.5, 0.25) * (max(dot(lightDir, normal), 0) + 0.2), 1);
+			oColor = vec4(vec3(1, 0.5, 0.25) * (max(dot(lightDir, normalize(normal)), 0) + 0.2), 1);
+		}
+	);
+
+	//A deforming program: the vertex stage writes position and normal, which a DeformPass can capture
+	gl::GlslProgRef static GetDeformingShader(const std::string &vertexSource) {
+		return GetProgram(vertexSource, ShadedFragment, true);
+	}
+
+	gl::GlslProgRef static GetFFDShader(bool packed = false) {
+		return GetDeformingShader(std::string("#version 150\n") + FFDLibrary + NormalLibrary + VertexInput(packed) + GLSL_SNIPPET(
+		uniform mat4	ciModelViewProjection;
+		out vec3		position;			//The deformed vertex, also captured by a DeformPass
+		out vec3		normal;				//Rest normal mapped through the Jacobian of the FFD
+
+		void main(void) {
+			mat3 J;
+			if (useBinding == 1)
+				position = boundPoint(J);
+			else
+				position = transformPoint((mv * vec4(restPosition(),1)).xyz, J);
+			normal = transformNormal(J * mat3(mv), restNormal());
+			gl_Position = ciModelViewProjection * vec4(position, 1);
+		}
+		));
+	}
+
+	//Draws the positions and normals written by a DeformPass, no deformation needed
+	gl::GlslProgRef static GetShadedShader() {
+		return GetProgram(CI_GLSL(150,
+				uniform mat4	ciModelViewProjection;
+		in vec3			ciPosition;
+		in vec3			ciNormal;
+		out vec3		normal;
+
+		void main(void) {
+			normal = ciNormal;
+			gl_Position = ciModelViewProjection * vec4(ciPosition, 1);
 		}
-		)));
+		), ShadedFragment, false);
 	}
 };
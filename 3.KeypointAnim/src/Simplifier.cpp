@@ -0,0 +1,319 @@
+#include "Simplifier.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+
+namespace {
+	//Symmetric 4x4 matrix of the summed squared plane distances, stored as its upper triangle:
+	//xx xy xz xd yy yz yd zz zd dd
+	struct Quadric {
+		double a[10] = {};
+
+		Quadric() {}
+		Quadric(vec3 n, float d, double weight)
+		{
+			double v[4] = { n.x, n.y, n.z, d };
+			int i = 0;
+			for (int r = 0; r < 4; ++r)
+				for (int c = r; c < 4; ++c)
+					a[i++] = v[r] * v[c] * weight;
+		}
+
+		Quadric& operator+=(const Quadric &o)
+		{
+			for (int i = 0; i < 10; ++i)
+				a[i] += o.a[i];
+			return *this;
+		}
+
+		double Error(vec3 p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+				 + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+				 + a[7] * z * z + 2 * a[8] * z
+				 + a[9];
+		}
+
+		//The position with the smallest error, false if the matrix is close to singular (flat or straight regions)
+		bool Optimum(vec3 &p) const
+		{
+			double m00 = a[0], m01 = a[1], m02 = a[2], m11 = a[4], m12 = a[5], m22 = a[7];
+			double b0 = -a[3], b1 = -a[6], b2 = -a[8];
+			double c00 = m11 * m22 - m12 * m12, c01 = m02 * m12 - m01 * m22, c02 = m01 * m12 - m02 * m11;
+			double det = m00 * c00 + m01 * c01 + m02 * c02;
+			double scale = std::abs(m00) + std::abs(m11) + std::abs(m22);
+			if (std::abs(det) <= 1e-12 * scale * scale * scale || scale == 0)
+				return false;
+			double c11 = m00 * m22 - m02 * m02, c12 = m01 * m02 - m00 * m12, c22 = m00 * m11 - m01 * m01;
+			p.x = (float)((c00 * b0 + c01 * b1 + c02 * b2) / det);
+			p.y = (float)((c01 * b0 + c11 * b1 + c12 * b2) / det);
+			p.z = (float)((c02 * b0 + c12 * b1 + c22 * b2) / det);
+			return true;
+		}
+	};
+
+	struct Candidate {
+		double cost;
+		uint32_t a, b;
+		uint32_t versionA, versionB;
+
+		bool operator<(const Candidate &o) const { return cost > o.cost; }	//priority_queue puts the cheapest on top
+	};
+
+	class Collapser {
+	public:
+		Collapser(const MeshData &mesh)
+			: positions(mesh.positions), tris(mesh.indices), quadrics(mesh.positions.size()),
+			  trisOf(mesh.positions.size()), version(mesh.positions.size(), 0),
+			  removed(mesh.positions.size(), false), border(mesh.positions.size(), false),
+			  triRemoved(mesh.indices.size() / 3, false), triangleCount(mesh.indices.size() / 3)
+		{
+			for (uint32_t t = 0; t < triangleCount; ++t) {
+				vec3 p0 = positions[tris[t * 3]], p1 = positions[tris[t * 3 + 1]], p2 = positions[tris[t * 3 + 2]];
+				vec3 n = cross(p1 - p0, p2 - p0);
+				float len = length(n);
+				if (len > 0) {
+					n /= len;
+					Quadric q(n, -dot(n, p0), len * 0.5);
+					for (int c = 0; c < 3; ++c)
+						quadrics[tris[t * 3 + c]] += q;
+				}
+				for (int c = 0; c < 3; ++c)
+					trisOf[tris[t * 3 + c]].push_back(t);
+			}
+
+			//Every edge once, edges used by a single triangle lie on a border
+			std::vector<std::pair<uint32_t, uint32_t>> edges;
+			edges.reserve(tris.size());
+			for (uint32_t t = 0; t < triangleCount; ++t)
+				for (int c = 0; c < 3; ++c) {
+					uint32_t a = tris[t * 3 + c], b = tris[t * 3 + (c + 1) % 3];
+					edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+				}
+			std::sort(edges.begin(), edges.end());
+			for (size_t i = 0; i < edges.size();) {
+				size_t j = i + 1;
+				while (j < edges.size() && edges[j] == edges[i])
+					++j;
+				if (j - i == 1)
+					border[edges[i].first] = border[edges[i].second] = true;
+				Push(edges[i].first, edges[i].second);
+				i = j;
+			}
+		}
+
+		void Run(size_t targetTriangles)
+		{
+			while (triangleCount > targetTriangles && !heap.empty()) {
+				Candidate c = heap.top();
+				heap.pop();
+				if (removed[c.a] || removed[c.b] || version[c.a] != c.versionA || version[c.b] != c.versionB)
+					continue;
+				uint32_t keep, drop;
+				vec3 target;
+				if (Evaluate(c.a, c.b, keep, drop, target) == Invalid)
+					continue;
+				if (Flips(keep, drop, target) || Flips(drop, keep, target))
+					continue;
+				Collapse(keep, drop, target);
+			}
+		}
+
+		MeshData Result(const MeshData &source) const
+		{
+			MeshData out;
+			bool withNormals = source.normals.size() == source.positions.size();
+			std::vector<uint32_t> newIndex(positions.size(), UINT32_MAX);
+			out.indices.reserve(triangleCount * 3);
+			for (uint32_t t = 0; t < triRemoved.size(); ++t) {
+				if (triRemoved[t])
+					continue;
+				for (int c = 0; c < 3; ++c) {
+					uint32_t v = tris[t * 3 + c];
+					if (newIndex[v] == UINT32_MAX) {
+						newIndex[v] = (uint32_t)out.positions.size();
+						out.positions.push_back(positions[v]);
+						if (withNormals)
+							out.normals.push_back(source.normals[v]);
+					}
+					out.indices.push_back(newIndex[v]);
+				}
+			}
+			if (!withNormals)
+				MeshImport::ComputeNormals(out);
+			return out;
+		}
+
+	private:
+		static constexpr double Invalid = std::numeric_limits<double>::infinity();
+
+		//Cost of collapsing the edge a-b, which vertex survives and where it goes
+		double Evaluate(uint32_t a, uint32_t b, uint32_t &keep, uint32_t &drop, vec3 &target) const
+		{
+			if (border[a] && border[b])
+				return Invalid;
+			keep = border[b] ? b : a;
+			drop = keep == a ? b : a;
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+			if (border[keep]) {
+				target = positions[keep];
+				return q.Error(target);
+			}
+			if (q.Optimum(target))
+				return q.Error(target);
+
+			vec3 options[3] = { positions[a], positions[b], (positions[a] + positions[b]) * 0.5f };
+			double best = Invalid;
+			for (vec3 option : options) {
+				double error = q.Error(option);
+				if (error < best) {
+					best = error;
+					target = option;
+				}
+			}
+			return best;
+		}
+
+		void Push(uint32_t a, uint32_t b)
+		{
+			uint32_t keep, drop;
+			vec3 target;
+			double cost = Evaluate(a, b, keep, drop, target);
+			if (cost != Invalid)
+				heap.push({ cost, a, b, version[a], version[b] });
+		}
+
+		//Would moving v to target turn over one of its triangles that does not also contain other?
+		bool Flips(uint32_t v, uint32_t other, vec3 target) const
+		{
+			for (uint32_t t : trisOf[v]) {
+				if (triRemoved[t])
+					continue;
+				const uint32_t *tri = &tris[t * 3];
+				if (tri[0] == other || tri[1] == other || tri[2] == other)
+					continue;
+				vec3 p[3], q[3];
+				for (int c = 0; c < 3; ++c) {
+					p[c] = positions[tri[c]];
+					q[c] = tri[c] == v ? target : p[c];
+				}
+				vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+				vec3 after = cross(q[1] - q[0], q[2] - q[0]);
+				float lenBefore = length(before), lenAfter = length(after);
+				if (lenAfter <= 1e-12f || (lenBefore > 0 && dot(before, after) <= 0.2f * lenBefore * lenAfter))
+					return true;
+			}
+			return false;
+		}
+
+		void Collapse(uint32_t keep, uint32_t drop, vec3 target)
+		{
+			positions[keep] = target;
+			quadrics[keep] += quadrics[drop];
+			for (uint32_t t : trisOf[drop]) {
+				if (triRemoved[t])
+					continue;
+				uint32_t *tri = &tris[t * 3];
+				if (tri[0] == keep || tri[1] == keep || tri[2] == keep) {
+					triRemoved[t] = true;
+					--triangleCount;
+					continue;
+				}
+				for (int c = 0; c < 3; ++c)
+					if (tri[c] == drop)
+						tri[c] = keep;
+				trisOf[keep].push_back(t);
+			}
+			removed[drop] = true;
+			std::vector<uint32_t>().swap(trisOf[drop]);
+			++version[keep];
+
+			//Only the edges around keep changed their cost
+			auto &own = trisOf[keep];
+			own.erase(std::remove_if(own.begin(), own.end(), [&](uint32_t t) { return triRemoved[t]; }), own.end());
+			neighbors.clear();
+			for (uint32_t t : own)
+				for (int c = 0; c < 3; ++c)
+					if (tris[t * 3 + c] != keep)
+						neighbors.push_back(tris[t * 3 + c]);
+			std::sort(neighbors.begin(), neighbors.end());
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+			for (uint32_t n : neighbors)
+				Push(keep, n);
+		}
+
+		std::vector<vec3> positions;
+		std::vector<uint32_t> tris;
+		std::vector<Quadric> quadrics;
+		std::vector<std::vector<uint32_t>> trisOf;
+		std::vector<uint32_t> version;
+		std::vector<bool> removed;
+		std::vector<bool> border;
+		std::vector<bool> triRemoved;
+		std::vector<uint32_t> neighbors;
+		size_t triangleCount;
+		std::priority_queue<Candidate> heap;
+	};
+}
+
+MeshData Simplifier::Simplify(const MeshData &mesh, size_t targetTriangles)
+{
+	Collapser collapser(mesh);
+	collapser.Run(targetTriangles);
+	return collapser.Result(mesh);
+}
+
+std::vector<MeshData> Simplifier::BuildLodChain(const MeshData &mesh, int levels, float ratio)
+{
+	std::vector<MeshData> chain;
+	const MeshData *previous = &mesh;
+	for (int level = 0; level < levels; ++level) {
+		size_t triangles = previous->indices.size() / 3;
+		MeshData lod = Simplify(*previous, (size_t)(triangles * ratio));
+		//Stop once the borders keep the mesh from getting noticeably smaller
+		if (lod.indices.size() / 3 > triangles * (1 + ratio) / 2)
+			break;
+		chain.push_back(std::move(lod));
+		previous = &chain.back();
+	}
+	return chain;
+}
+
+Simplifier::BenchmarkResult Simplifier::Benchmark(size_t triangleCount)
+{
+	//A wavy n x n height field has 2 (n-1)^2 triangles
+	uint32_t n = (uint32_t)std::sqrt(triangleCount / 2.0) + 1;
+	MeshData mesh;
+	mesh.positions.reserve(n * n);
+	for (uint32_t j = 0; j < n; ++j)
+		for (uint32_t i = 0; i < n; ++i) {
+			float x = 2.f * i / (n - 1) - 1, z = 2.f * j / (n - 1) - 1;
+			mesh.positions.push_back(vec3(x, 0.2f * std::sin(6 * x) * std::cos(4 * z), z));
+		}
+	for (uint32_t j = 0; j + 1 < n; ++j)
+		for (uint32_t i = 0; i + 1 < n; ++i) {
+			uint32_t v = j * n + i;
+			uint32_t quad[6] = { v, v + n, v + 1, v + 1, v + n, v + n + 1 };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	MeshImport::ComputeNormals(mesh);
+
+	typedef std::chrono::high_resolution_clock clock;
+	BenchmarkResult result;
+	result.inputTriangles = mesh.indices.size() / 3;
+
+	auto start = clock::now();
+	MeshData simplified = Simplify(mesh, result.inputTriangles / 10);
+	result.simplifyMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	result.outputTriangles = simplified.indices.size() / 3;
+
+	start = clock::now();
+	BuildLodChain(mesh, 4);
+	result.chainMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	return result;
+}
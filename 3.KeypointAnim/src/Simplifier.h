@@ -0,0 +1,27 @@
+#pragma once
+#include "MeshImport.h"
+#include <vector>
+
+//Quadric error metric simplification (Garland & Heckbert).
+//Edges are collapsed cheapest first into the position that minimizes the summed plane distances of both vertices.
+//Vertices on open borders (also the normal seams of the generated shapes) never move, so no cracks open up.
+//Only plain data is touched, everything here may run on any thread
+class Simplifier {
+public:
+	struct BenchmarkResult {
+		size_t inputTriangles;
+		size_t outputTriangles;
+		double simplifyMs;		//Down to 10% in one go
+		double chainMs;			//BuildLodChain with 4 levels
+	};
+
+	//Collapses edges until at most targetTriangles are left or no valid collapse remains.
+	//The surviving vertex of a collapse keeps its normal
+	static MeshData Simplify(const MeshData &mesh, size_t targetTriangles);
+
+	//levels meshes, each with ratio times the triangles of the one before, every level is simplified from the previous one
+	static std::vector<MeshData> BuildLodChain(const MeshData &mesh, int levels, float ratio = 0.5f);
+
+	//Simplifies a height field of about triangleCount triangles
+	static BenchmarkResult Benchmark(size_t triangleCount = 1000000);
+};
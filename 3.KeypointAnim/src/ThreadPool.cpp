@@ -0,0 +1,85 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+	: nextChunk(0)
+{
+	for (unsigned i = 1; i < std::max(threadCount, 1u); ++i)
+		workers.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers)
+		worker.join();
+}
+
+unsigned ThreadPool::Size() const
+{
+	return (unsigned)workers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn)
+{
+	grain = std::max(grain, (size_t)1);
+	if (workers.empty() || count <= grain) {
+		if (count > 0)
+			fn(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submitLock(submitMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		jobCount = count;
+		jobGrain = grain;
+		nextChunk = 0;
+		busyWorkers = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	RunChunks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busyWorkers == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::RunChunks()
+{
+	for (size_t chunk = nextChunk++; chunk * jobGrain < jobCount; chunk = nextChunk++)
+		(*job)(chunk * jobGrain, std::min(jobCount, (chunk + 1) * jobGrain));
+}
+
+void ThreadPool::Work()
+{
+	unsigned seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+			if (quit)
+				return;
+			seenGeneration = generation;
+		}
+		RunChunks();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0)
+				done.notify_all();
+		}
+	}
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
@@ -3,18 +3,16 @@
 #include <algorithm>
 
 
-Volume::Volume(Mesh mesh)
+Volume::Volume(const Mesh &mesh)
 {
-	MakeCube();
 	ffdProgRef = Shaders::GetFFDShader();
+	ffdPackedProgRef = Shaders::GetFFDShader(true);
 	ffdProgRef->bind();
-	ffdProgRef->uniform("lightDir", normalize(vec3(2, 10, 0)));
-	for (size_t i = 0; i < controlPoints.size(); ++i) {
-		std::string loc = "controlPointsOrig[" + std::to_string(i) + "]";
-		ffdProgRef->uniform(loc, controlPointsOrig[i]);
-	}
-	for (size_t i = 0; i < controlPoints.size(); ++i)
-		UpdateControlPoint(i, controlPoints[i]);
+	SetUniform("lightDir", normalize(vec3(2, 10, 0)));
+	SetUniform("controlPoints", 0);
+	SetUniform("bindingWeights", 1);
+	SetUniform("bindingGradients", 2);
+	SetLattice(Lattice());
 	Transform(vec3(0, 0, 0),vec3(1,1,1));
 }
 
@@ -28,65 +26,231 @@ void Volume::draw()
 //Draw a Mesh transformed by the volume
 void Volume::draw(Mesh* mesh)
 {
-	mesh->batchRef->replaceGlslProg(ffdProgRef);
-	mesh->batchRef->getVao()->bind();
-	mesh->batchRef->draw();
-	mesh->batchRef->replaceGlslProg(mesh->progRef);
-	mesh->batchRef->getVao()->bind();
+	const gl::BatchRef &batch = mesh->BatchFor(ProgramFor(mesh));
+	batch->getVao()->bind();
+	BindInputs(mesh);
+	batch->draw();
+	UnbindInputs();
 }
 
-//Change the position of a control point inside the shader
+//Deform a Mesh into its DeformPass instead of drawing it
+void Volume::Capture(Mesh* mesh)
+{
+	BindInputs(mesh);
+	mesh->deformPass->Run(mesh->BatchFor(ProgramFor(mesh)));
+	UnbindInputs();
+}
+
+//The FFD program that reads the vertices the way mesh stores them
+const gl::GlslProgRef& Volume::ProgramFor(const Mesh* mesh) const
+{
+	return mesh->options.packed ? ffdPackedProgRef : ffdProgRef;
+}
+
+//Binds the lattice (and the precomputed weights if enabled) for the FFD shader
+void Volume::BindInputs(Mesh* mesh)
+{
+	if (bindWeights && (!bindingValid || boundMesh != mesh))
+		Bind(mesh);
+	bound = bindWeights && bindingValid;
+	SetUniform("useBinding", bound ? 1 : 0);
+	if (mesh->options.packed) {
+		ffdPackedProgRef->uniform("quantMin", mesh->quantMin);
+		ffdPackedProgRef->uniform("quantExtent", mesh->quantExtent);
+	}
+
+	controlPointsTexRef->bindTexture(0);
+	if (bound) {
+		bindingTexRef->bindTexture(1);
+		bindingGradientsTexRef->bindTexture(2);
+	}
+}
+
+void Volume::UnbindInputs()
+{
+	if (bound) {
+		bindingGradientsTexRef->unbindTexture(2);
+		bindingTexRef->unbindTexture(1);
+	}
+	controlPointsTexRef->unbindTexture(0);
+}
+
+//Replace the lattice, all control points are reset to their rest positions
+void Volume::SetLattice(const Lattice &newLattice)
+{
+	lattice = newLattice;
+	MakeCube();
+
+	latticeData.assign(lattice.Size(), vec4(0, 0, 0, 1));
+	controlPointsBufRef = gl::BufferObj::create(GL_TEXTURE_BUFFER, latticeData.size() * sizeof(vec4), nullptr, GL_DYNAMIC_DRAW);
+	controlPointsTexRef = gl::BufferTexture::create(controlPointsBufRef, GL_RGBA32F);
+	SetUniform("latticeRes", lattice.resolution);
+	SetUniform("basis", (int)lattice.basis);
+	SetUniform("boxMin", lattice.boxMin);
+	SetUniform("boxMax", lattice.boxMax);
+
+	uploadedControlPoints.assign(controlPoints.size(), vec3(FLT_MAX, FLT_MAX, FLT_MAX));
+	RebufferCPs();
+	InvalidateBinding();
+}
+
+//Moves one control point, only its texel and its outline vertex are re-uploaded
 void Volume::UpdateControlPoint(int i, vec3 pos)
 {
-	ffdProgRef->bind();
-	std::string loc = "controlPoints["  + std::to_string(i) + "]";
-	ffdProgRef->uniform(loc, pos);
+	controlPoints[i] = pos;
+	int index = latticeIndices[i];
+	latticeData[index] = vec4(pos, 1);
+	controlPointsBufRef->bufferSubData(index * sizeof(vec4), sizeof(vec4), &latticeData[index]);
+	vboMeshRef->findAttrib(geom::POSITION)->second->bufferSubData(i * sizeof(vec3), sizeof(vec3), &pos);
+	uploadedControlPoints[i] = pos;
+	if (pickerValid)
+		picker.Move(i, pos);
+}
+
+//The control point under the ray, -1 if there is none. The pick structure is only rebuilt after all points moved
+int Volume::Pick(const Ray &ray)
+{
+	if (!pickerValid) {
+		picker.Build(controlPoints, pickRadius);
+		pickerValid = true;
+	}
+	return picker.Pick(ray);
 }
 
 //Load the current position of all control points into the shader
+//Skipped entirely if nothing moved since the last upload, otherwise a single buffer upload without allocations
 void Volume::RebufferCPs()
 {
-	vboMeshRef->bufferAttrib(geom::POSITION, sizeof(float) * 8 * 3, controlPoints.data());
-	ffdProgRef->bind();
-	for (int i = 0; i < 8; i++) {
-		std::string loc = "controlPoints[" + std::to_string(i) + "]";
-		ffdProgRef->uniform(loc, controlPoints[i]);
-	}
-		
+	if (std::equal(controlPoints.begin(), controlPoints.end(), uploadedControlPoints.begin()))
+		return;
+	vboMeshRef->bufferAttrib(geom::POSITION, sizeof(vec3) * controlPoints.size(), controlPoints.data());
+	for (size_t i = 0; i < controlPoints.size(); ++i)
+		latticeData[latticeIndices[i]] = vec4(controlPoints[i], 1);
+	controlPointsBufRef->bufferSubData(0, latticeData.size() * sizeof(vec4), latticeData.data());
+	std::copy(controlPoints.begin(), controlPoints.end(), uploadedControlPoints.begin());
+	pickerValid = false;
 }
 
-//Unfortunately the geometry for the teapot is not generated around (0,0,0) but from 0 to 1, so this was needed to move it into the center of the box
+//Maps mesh coordinates into the lattice: scaled by scale, then moved by offset
 void Volume::Transform(vec3 offset, vec3 scale)
 {
-	mat4 transformMat = glm::translate(offset);
+	transformMat = glm::translate(offset);
 	transformMat = glm::scale(transformMat, scale);
-	ffdProgRef->uniform("mv", transformMat);
+	SetUniform("mv", transformMat);
+	InvalidateBinding();
+}
+
+//Moves the center of the bounds onto the center of the lattice box.
+//Meshes that are larger than the box are scaled down until they fit, smaller ones keep their size
+void Volume::FitToBounds(vec3 min, vec3 max)
+{
+	vec3 extent = max - min;
+	vec3 box = lattice.boxMax - lattice.boxMin;
+	float scale = 1.f;
+	for (int a = 0; a < 3; ++a)
+		if (extent[a] > box[a])
+			scale = std::min(scale, box[a] / extent[a]);
+	vec3 offset = (lattice.boxMin + lattice.boxMax) * 0.5f - (min + max) * 0.5f * scale;
+	Transform(offset, vec3(scale, scale, scale));
+}
+
+//Computes the (lattice index, weight) pairs of every vertex of the mesh once and hands them to the shader
+void Volume::Bind(Mesh* mesh)
+{
+	FFDDeformer deformer;
+	deformer.Bind(lattice, transformMat, mesh->positions.data(), mesh->positions.size(), binding);
+
+	std::vector<vec2> pairs(binding.weights.size());
+	for (size_t i = 0; i < pairs.size(); ++i)
+		pairs[i] = vec2((float)binding.indices[i], binding.weights[i]);
+	auto bufRef = gl::BufferObj::create(GL_TEXTURE_BUFFER, pairs.size() * sizeof(vec2), pairs.data(), GL_STATIC_DRAW);
+	bindingTexRef = gl::BufferTexture::create(bufRef, GL_RG32F);
+
+	std::vector<vec4> gradients(binding.gradients.size());
+	for (size_t i = 0; i < gradients.size(); ++i)
+		gradients[i] = vec4(binding.gradients[i], 0);
+	auto gradientsBufRef = gl::BufferObj::create(GL_TEXTURE_BUFFER, gradients.size() * sizeof(vec4), gradients.data(), GL_STATIC_DRAW);
+	bindingGradientsTexRef = gl::BufferTexture::create(gradientsBufRef, GL_RGBA32F);
+	SetUniform("bindingStride", binding.stride);
+	bindingValid = true;
+	boundMesh = mesh;
+}
+
+//The weights depend on the lattice, the transform and the mesh, call this whenever one of them changes
+void Volume::InvalidateBinding()
+{
+	bindingValid = false;
+}
+
+//The current control points in lattice order, as the CPU deformer expects them
+void Volume::GetLatticePoints(std::vector<vec3> &points) const
+{
+	points.resize(controlPoints.size());
+	for (size_t i = 0; i < controlPoints.size(); ++i)
+		points[latticeIndices[i]] = controlPoints[i];
+}
+
+//Hands the lattice to another program that contains the FFD, like a DeformerStack with an ffd step.
+//The mesh is taken as it comes out of the previous deformers, so neither mv nor a weight binding apply
+void Volume::BindLattice(const gl::GlslProgRef &prog)
+{
+	prog->uniform("latticeRes", lattice.resolution);
+	prog->uniform("basis", (int)lattice.basis);
+	prog->uniform("boxMin", lattice.boxMin);
+	prog->uniform("boxMax", lattice.boxMax);
+	controlPointsTexRef->bindTexture(0);
 }
 
+void Volume::UnbindLattice()
+{
+	controlPointsTexRef->unbindTexture(0);
+}
 
+//Creates the control points and the outline of the lattice.
+//The 2x2x2 cube keeps its original corner order, the scripted key points rely on it
 void Volume::MakeCube()
 {
 	controlPoints.clear();
-	controlPoints.push_back(vec3(1, -1, -1));
-	controlPoints.push_back(vec3(1, 1, -1));
-	controlPoints.push_back(vec3(-1, 1, -1));
-	controlPoints.push_back(vec3(-1, -1, -1));
-	controlPoints.push_back(vec3(1, -1, 1));
-	controlPoints.push_back(vec3(1, 1, 1));
-	controlPoints.push_back(vec3(-1, 1, 1));
-	controlPoints.push_back(vec3(-1, -1, 1));
+	if (lattice.resolution == ivec3(2, 2, 2) && lattice.basis == Lattice::bernstein) {
+		controlPoints.push_back(vec3(1, -1, -1));
+		controlPoints.push_back(vec3(1, 1, -1));
+		controlPoints.push_back(vec3(-1, 1, -1));
+		controlPoints.push_back(vec3(-1, -1, -1));
+		controlPoints.push_back(vec3(1, -1, 1));
+		controlPoints.push_back(vec3(1, 1, 1));
+		controlPoints.push_back(vec3(-1, 1, 1));
+		controlPoints.push_back(vec3(-1, -1, 1));
+	}
+	else
+		controlPoints = lattice.RestPositions();
 	controlPointsOrig = std::vector<vec3>(controlPoints.begin(), controlPoints.end());
 
+	latticeIndices.resize(controlPoints.size());
+	std::vector<int> pointOfIndex(controlPoints.size());
+	for (size_t i = 0; i < controlPoints.size(); ++i) {
+		latticeIndices[i] = lattice.IndexOf(controlPointsOrig[i]);
+		pointOfIndex[latticeIndices[i]] = (int)i;
+	}
 
-	std::vector<uint16_t> indices{ 0,1,1,2,2,3,3,0,0,4,1,5,2,6,3,7,4,5,5,6,6,7,7,4};
-	
+	//Connect every lattice point with its successor on each axis
+	ivec3 res = lattice.resolution;
+	edges.clear();
+	for (int k = 0; k < res.z; ++k)
+		for (int j = 0; j < res.y; ++j)
+			for (int i = 0; i < res.x; ++i) {
+				int p = pointOfIndex[lattice.Index(i, j, k)];
+				if (i + 1 < res.x) { edges.push_back(p); edges.push_back(pointOfIndex[lattice.Index(i + 1, j, k)]); }
+				if (j + 1 < res.y) { edges.push_back(p); edges.push_back(pointOfIndex[lattice.Index(i, j + 1, k)]); }
+				if (k + 1 < res.z) { edges.push_back(p); edges.push_back(pointOfIndex[lattice.Index(i, j, k + 1)]); }
+			}
+	std::vector<uint16_t> indices(edges.begin(), edges.end());
 
 	auto layout = gl::VboMesh::Layout().usage(GL_DYNAMIC_DRAW).attrib(geom::Attrib::POSITION,3);
 	std::vector<gl::VboMesh::Layout> layouts = { layout };
 	auto iBuf = gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER,indices.size()*sizeof(uint16_t),indices.data());
 
-	vboMeshRef = gl::VboMesh::create(8, GL_LINES, layouts,indices.size(), GL_UNSIGNED_SHORT,iBuf);
-	vboMeshRef->bufferAttrib(geom::POSITION,sizeof(float)*8*3,controlPoints.data());
+	vboMeshRef = gl::VboMesh::create(controlPoints.size(), GL_LINES, layouts,indices.size(), GL_UNSIGNED_SHORT,iBuf);
+	vboMeshRef->bufferAttrib(geom::POSITION,sizeof(vec3)*controlPoints.size(),controlPoints.data());
 	auto glslprog = gl::getStockShader(gl::ShaderDef().color());
 	outlineBatchRef = gl::Batch::create(vboMeshRef, glslprog);
 }
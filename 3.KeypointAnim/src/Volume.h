@@ -2,7 +2,11 @@
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
 #include "cinder/gl/gl.h"
+#include "cinder/gl/BufferTexture.h"
 #include "Mesh.h"
+#include "Lattice.h"
+#include "FFDDeformer.h"
+#include "LatticePicker.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -10,24 +14,61 @@ using namespace ci::app;
 class Volume 
 {
 public:
-	Volume(Mesh mesh);
+	Volume(const Mesh &mesh);
 
 	gl::VboMeshRef vboMeshRef;
 	gl::BatchRef outlineBatchRef;
 	gl::BatchRef meshBatchRef;
 	gl::GlslProgRef ffdProgRef;
+	gl::GlslProgRef ffdPackedProgRef;			//The same for meshes uploaded as PackedVertices
+	gl::BufferTextureRef controlPointsTexRef;	//The lattice as seen by the FFD shader
 
-
+	Lattice lattice;
 	std::vector<vec3> controlPointsOrig;
 	std::vector<vec3> controlPoints;
+	std::vector<int> latticeIndices;			//Index of controlPoints[i] inside the lattice (see Lattice::Index)
 	std::vector<int> edges;
+	mat4 transformMat;							//Applied to the mesh before the lattice, see Transform() and FitToBounds()
+	bool bindWeights = false;					//Precompute the lattice weights of the drawn mesh instead of evaluating them per frame
+	FFDDeformer::Binding binding;
+	float pickRadius = 0.06f;					//Size of the control points for Pick()
 
 	void draw();
 	void draw(Mesh* mesh);
+	void Capture(Mesh* mesh);
+	void SetLattice(const Lattice &newLattice);
 	void UpdateControlPoint(int i, vec3 pos);
+	int Pick(const Ray &ray);
 	void RebufferCPs();
 	void Transform(vec3 offset, vec3 scale);
+	void FitToBounds(vec3 min, vec3 max);
+	void GetLatticePoints(std::vector<vec3> &points) const;
+	void Bind(Mesh* mesh);
+	void InvalidateBinding();
+	void BindLattice(const gl::GlslProgRef &prog);
+	void UnbindLattice();
 
 private:
 	void MakeCube();
-};
\ No newline at end of file
+	const gl::GlslProgRef& ProgramFor(const Mesh* mesh) const;
+	void BindInputs(Mesh* mesh);
+	void UnbindInputs();
+
+	//The lattice uniforms are shared by both FFD programs
+	template<typename T> void SetUniform(const std::string &name, const T &value)
+	{
+		ffdProgRef->uniform(name, value);
+		ffdPackedProgRef->uniform(name, value);
+	}
+
+	gl::BufferObjRef controlPointsBufRef;
+	std::vector<vec4> latticeData;				//controlPoints in lattice order, padded to vec4 for the RGBA32F buffer texture
+	std::vector<vec3> uploadedControlPoints;	//The positions the shader and the outline currently hold
+	gl::BufferTextureRef bindingTexRef;			//binding packed as (index, weight) pairs for the shader
+	gl::BufferTextureRef bindingGradientsTexRef;
+	bool bindingValid = false;
+	const Mesh *boundMesh = nullptr;			//The mesh the binding was made for, LODs switch it
+	bool bound = false;
+	LatticePicker picker;
+	bool pickerValid = false;					//The picker holds the current controlPoints
+};
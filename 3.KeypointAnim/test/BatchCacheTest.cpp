@@ -0,0 +1,59 @@
+#include "BatchCache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+//Mesh::BatchFor hands out the batches of a BatchCache. A mesh drawn with the program of its stack and, with FFD on,
+//the lattice program of the Volume asks for both every frame, only the first frame may build them
+namespace {
+	struct Program {};
+	struct Batch {
+		std::shared_ptr<Program> prog;
+	};
+	typedef std::shared_ptr<Program> ProgramRef;
+	typedef std::shared_ptr<Batch> BatchRef;
+
+	const int Frames = 100;
+	int failures = 0;
+
+	void Report(const char *name, bool passed)
+	{
+		failures += !passed;
+		std::printf("%-40s %s\n", name, passed ? "passed" : "FAILED");
+	}
+}
+
+int main()
+{
+	BatchCache<ProgramRef, BatchRef> batches;
+	int built = 0;
+	auto create = [&](const ProgramRef &prog) {
+		++built;
+		return BatchRef(new Batch{ prog });
+	};
+
+	ProgramRef stackProg = std::make_shared<Program>();
+	ProgramRef ffdProg = std::make_shared<Program>();
+	const Batch *stackBatch = batches.For(stackProg, create).get();
+	const Batch *ffdBatch = batches.For(ffdProg, create).get();
+	Report("Every program gets its own batch", stackBatch != ffdBatch && stackBatch->prog == stackProg && ffdBatch->prog == ffdProg);
+
+	bool same = true;
+	for (int frame = 0; frame < Frames; ++frame) {
+		//FFD switched on and off every few frames, the Volume asks for its batch only while it is on
+		if (frame % 7 < 3)
+			same = same && batches.For(ffdProg, create).get() == ffdBatch;
+		same = same && batches.For(stackProg, create).get() == stackBatch;
+	}
+	Report("Same batches in every frame", same);
+	Report("Built once per program", built == 2 && batches.Size() == 2);
+
+	//A mode change brings a new program, the batches of the old ones stay for switching back
+	ProgramRef modeProg = std::make_shared<Program>();
+	const Batch *modeBatch = batches.For(modeProg, create).get();
+	bool kept = batches.For(stackProg, create).get() == stackBatch && batches.For(modeProg, create).get() == modeBatch;
+	Report("Mode change builds one batch", kept && built == 3);
+
+	std::printf(failures ? "BatchCacheTest: %d failed\n" : "BatchCacheTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
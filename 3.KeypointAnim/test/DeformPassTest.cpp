@@ -0,0 +1,96 @@
+#include "DeformPass.h"
+#include "Deformations.h"
+#include "Lattice.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//DeformPass::Emulate has to write position and normal interleaved like the transform feedback buffer,
+//each vertex deformed exactly like the stack's own functions do it
+namespace {
+	const float Tolerance = 1e-5f;
+	const size_t VertexCount = 1000;
+	int failures = 0;
+
+	float Difference(vec3 a, vec3 b)
+	{
+		vec3 d = a - b;
+		return std::max(std::max(std::abs(d.x), std::abs(d.y)), std::abs(d.z));
+	}
+
+	//expected maps a rest position to the deformed one and the Jacobian of the whole stack
+	void Check(const char *name, const DeformerStack &stack, const DeformerStack::Context &context,
+			   const std::vector<vec3> &positions, const std::vector<vec3> &normals,
+			   const std::function<vec3(vec3, mat3&)> &expected)
+	{
+		std::vector<vec3> out;
+		DeformPass::Emulate(stack, context, positions.data(), normals.data(), positions.size(), out);
+		bool passed = out.size() == positions.size() * 2;
+		float worst = 0.f;
+		for (size_t i = 0; passed && i < positions.size(); ++i) {
+			mat3 J;
+			vec3 p = expected(positions[i], J);
+			worst = std::max(worst, Difference(out[i * 2], p));
+			worst = std::max(worst, Difference(out[i * 2 + 1], Deformations::TransformNormal(J, normals[i])));
+		}
+		passed = passed && worst <= Tolerance;
+		failures += !passed;
+		std::printf("%-16s %zu entries  max error %.2e %s\n", name, out.size(), worst, passed ? "" : "FAILED");
+	}
+}
+
+int main()
+{
+	using namespace Deformations;
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> box(-0.99f, 0.99f);
+	std::vector<vec3> positions(VertexCount), normals(VertexCount);
+	for (size_t i = 0; i < VertexCount; ++i) {
+		positions[i] = vec3(box(rng), box(rng), box(rng));
+		normals[i] = normalize(vec3(box(rng), box(rng), box(rng)) + vec3(0, 0, 0.01f));
+	}
+
+	DeformerStack::Context context;
+	context.meshMin = vec3(-1, -1, -1);
+	context.meshMax = vec3(1, 1, 1);
+	vec3 min = context.meshMin, max = context.meshMax;
+
+	Check("Taper", { Deformer(Deformer::taper, 0.7f) }, context, positions, normals, [=](vec3 p, mat3 &J) {
+		J = TaperJacobian(p, 0.7f, min, max);
+		return Taper(p, 0.7f, min, max);
+	});
+	Check("Twist, twist", { Deformer(Deformer::twist, 0.5f), Deformer(Deformer::twist, 0.25f) }, context, positions, normals,
+		  [](vec3 p, mat3 &J) {
+		J = TwistJacobian(Twist(p, 0.5f), 0.25f) * TwistJacobian(p, 0.5f);
+		return Twist(Twist(p, 0.5f), 0.25f);
+	});
+
+	std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+	for (Lattice::basisType basis : { Lattice::bernstein, Lattice::bspline }) {
+		Lattice lattice(ivec3(4, 5, 6), basis);
+		std::vector<vec3> controlPoints = lattice.RestPositions();
+		for (vec3 &c : controlPoints)
+			c += vec3(jitter(rng), jitter(rng), jitter(rng));
+		context.lattice = &lattice;
+		context.latticePoints = controlPoints.data();
+		Check(basis == Lattice::bernstein ? "Bend, Bernstein" : "Bend, B-spline", { Deformer(Deformer::bend, 0.3f), Deformer(Deformer::ffd) },
+			  context, positions, normals, [&](vec3 p, mat3 &J) {
+			mat3 Jl;
+			vec3 bent = Bend(p, 0.3f);
+			vec3 q = lattice.Evaluate(bent, controlPoints.data(), Jl);
+			J = Jl * BendJacobian(p, 0.3f);
+			return q;
+		});
+	}
+
+	std::vector<vec3> out;
+	DeformPass::Emulate(DeformerStack(), context, positions.data(), normals.data(), 0, out);
+	bool passed = out.empty();
+	failures += !passed;
+	std::printf("%-16s %zu entries %s\n", "No vertices", out.size(), passed ? "" : "FAILED");
+
+	std::printf(failures ? "DeformPassTest: %d failed\n" : "DeformPassTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
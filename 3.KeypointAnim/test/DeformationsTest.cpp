@@ -0,0 +1,138 @@
+#include "CurveDeformer.h"
+#include "Deformations.h"
+#include "Lattice.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//Compares the analytic Jacobians against central differences at sampled points of the -1..1 box the meshes live in,
+//and the lane code of CurveDeformer against its scalar Deform
+namespace {
+	const float Tolerance = 2e-3f;	//Central differences in float with h = 1e-3 are good to about 1e-3
+	int failures = 0;
+
+	void Check(const char *name, float k, const std::function<vec3(vec3)> &deform, const std::function<mat3(vec3)> &jacobian,
+			   const std::function<bool(vec3)> &inside)
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> box(-1.f, 1.f);
+		float worst = 0.f;
+		int tested = 0;
+		while (tested < 1000) {
+			vec3 p(box(rng), box(rng), box(rng));
+			if (!inside(p))
+				continue;
+			worst = std::max(worst, Deformations::MaxJacobianError(deform, jacobian, p));
+			++tested;
+		}
+		bool passed = worst <= Tolerance;
+		failures += !passed;
+		std::printf("%-24s k = %.2f  max error %.2e %s\n", name, k, worst, passed ? "" : "FAILED");
+	}
+
+	float Difference(vec3 a, vec3 b)
+	{
+		vec3 d = a - b;
+		return std::max(std::max(std::abs(d.x), std::abs(d.y)), std::abs(d.z));
+	}
+
+	void Report(const char *name, float k, float error, float tolerance)
+	{
+		bool passed = error <= tolerance;
+		failures += !passed;
+		std::printf("%-24s k = %.2f  max error %.2e %s\n", name, k, error, passed ? "" : "FAILED");
+	}
+
+	void CheckCurve(const CurveDeformer &curve, const std::vector<vec3> &samples, float k)
+	{
+		vec3 min(-1, -1, -1), max(1, 1, 1);
+		//The table is linear between entries, so the differences must not straddle one
+		float scale = (curve.tableSize - 1) / (max.y - min.y);
+		Check("Curve", k, [&](vec3 p) { return curve.Deform(p, k, min, max); },
+			  [&](vec3 p) { mat3 jacobian; curve.Deform(p, k, min, max, &jacobian); return jacobian; },
+			  [&](vec3 p) { return std::floor((p.y - 2e-3f - min.y) * scale) == std::floor((p.y + 2e-3f - min.y) * scale); });
+
+		//Blocks of Lanes with a partial block at both ends of the range
+		std::mt19937 rng(13);
+		std::uniform_real_distribution<float> box(-1.f, 1.f);
+		const size_t Count = CurveDeformer::Lanes * 5 + 3;
+		std::vector<vec3> positions(Count), normals(Count), out(Count), outNormals(Count);
+		for (size_t i = 0; i < Count; ++i) {
+			positions[i] = vec3(box(rng), box(rng), box(rng));
+			normals[i] = normalize(vec3(box(rng), box(rng), 1.f));
+		}
+		size_t begin = 3, end = Count - 2;
+		curve.DeformRange(positions.data(), k, min, max, out.data(), normals.data(), outNormals.data(), begin, end);
+		float worst = 0.f;
+		for (size_t i = begin; i < end; ++i) {
+			mat3 jacobian;
+			worst = std::max(worst, Difference(out[i], curve.Deform(positions[i], k, min, max, &jacobian)));
+			worst = std::max(worst, Difference(outNormals[i], Deformations::TransformNormal(jacobian, normals[i])));
+		}
+		Report("Curve, lanes = scalar", k, worst, 1e-5f);
+
+		//The middle of the cross section runs along the curve from its first to its last sample
+		float ends = std::max(Difference(curve.Deform(vec3(0, min.y, 0), 1.f, min, max), samples.front()),
+							  Difference(curve.Deform(vec3(0, max.y, 0), 1.f, min, max), samples.back()));
+		if (k == 0.f) {
+			mat3 jacobian;
+			vec3 p(0.3f, -0.2f, 0.7f);
+			vec3 q = curve.Deform(p, 0.f, min, max, &jacobian);
+			float identity = Difference(q, p);
+			for (int c = 0; c < 3; ++c)
+				identity = std::max(identity, Difference(jacobian[c], mat3(1.f)[c]));
+			Report("Curve, k = 0 is identity", k, identity, 0.f);
+			Report("Curve, ends of the mesh", 1.f, ends, 1e-4f);
+		}
+	}
+}
+
+int main()
+{
+	using namespace Deformations;
+	auto anywhere = [](vec3) { return true; };
+	vec3 min(-1, -1, -1), max(1, 1, 1);
+
+	for (float k : { 0.f, 0.4f, 1.f }) {
+		Check("Taper", k, [=](vec3 p) { return Taper(p, k, min, max); }, [=](vec3 p) { return TaperJacobian(p, k, min, max); }, anywhere);
+		Check("Twist", k, [=](vec3 p) { return Twist(p, k); }, [=](vec3 p) { return TwistJacobian(p, k); }, anywhere);
+		//log(1 + y) is singular at the bottom of the box
+		Check("Other", k, [=](vec3 p) { return Other(p, k); }, [=](vec3 p) { return OtherJacobian(p, k); }, [](vec3 p) { return p.y > -0.9f; });
+
+		//Bend is straight below ymin, bent between ymin and 1 and continues straight above 1
+		float ymin = (1 - k) * 2 - 0.75f;
+		auto bend = [=](vec3 p) { return Bend(p, k); };
+		auto bendJacobian = [=](vec3 p) { return BendJacobian(p, k); };
+		if (ymin < 0.9f)
+			Check("Bend, ymin <= y <= 1", k, bend, bendJacobian, [=](vec3 p) { return p.y > ymin + 0.01f && p.y < 0.99f; });
+		Check("Bend, y > 1", k, [=](vec3 p) { return Bend(p + vec3(0, 1.5f, 0), k); },
+			  [=](vec3 p) { return BendJacobian(p + vec3(0, 1.5f, 0), k); }, [](vec3 p) { return p.y > -0.49f; });
+		if (ymin > -0.9f)
+			Check("Bend, y < ymin", k, bend, bendJacobian, [=](vec3 p) { return p.y < std::min(ymin, 1.f) - 0.01f; });
+	}
+
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+	for (Lattice::basisType basis : { Lattice::bernstein, Lattice::bspline }) {
+		Lattice lattice(ivec3(4, 5, 6), basis);
+		std::vector<vec3> controlPoints = lattice.RestPositions();
+		for (vec3 &c : controlPoints)
+			c += vec3(jitter(rng), jitter(rng), jitter(rng));
+		Check(basis == Lattice::bernstein ? "FFD, Bernstein" : "FFD, B-spline", 1.f,
+			  [&](vec3 p) { return lattice.Evaluate(p, controlPoints.data()); },
+			  [&](vec3 p) { mat3 jacobian; lattice.Evaluate(p, controlPoints.data(), jacobian); return jacobian; },
+			  [](vec3 p) { return std::max(std::max(std::abs(p.x), std::abs(p.y)), std::abs(p.z)) < 0.99f; });
+	}
+
+	CurveDeformer curve;
+	curve.tableSize = 64;
+	std::vector<vec3> samples = CurveDeformer::SampleCurve(200);
+	curve.SetCurve(samples);
+	for (float k : { 0.f, 0.4f, 1.f })
+		CheckCurve(curve, samples, k);
+
+	std::printf(failures ? "DeformationsTest: %d failed\n" : "DeformationsTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
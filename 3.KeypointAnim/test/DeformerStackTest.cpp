@@ -0,0 +1,196 @@
+#include "AllocationCounter.h"
+#include "Deformations.h"
+#include "DeformerStack.h"
+#include "Lattice.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+//Apply is the CPU reference of the generated shader, it has to chain the same functions the steps stand for.
+//SetUniforms runs for every draw and must upload the strength of every step without touching the heap
+namespace {
+	const float Tolerance = 1e-5f;
+	const int PointCount = 1000;
+	int failures = 0;
+
+	float Difference(vec3 a, vec3 b)
+	{
+		vec3 d = a - b;
+		return std::max(std::max(std::abs(d.x), std::abs(d.y)), std::abs(d.z));
+	}
+
+	float Difference(const mat3 &a, const mat3 &b)
+	{
+		return std::max(std::max(Difference(a[0], b[0]), Difference(a[1], b[1])), Difference(a[2], b[2]));
+	}
+
+	//expected maps a rest position to the deformed one and the product of the Jacobians. The array version of Apply
+	//has to agree with the scalar one, normals included
+	void CheckApply(const char *name, const DeformerStack &stack, const DeformerStack::Context &context,
+					const std::function<vec3(vec3, mat3&)> &expected)
+	{
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> box(-0.99f, 0.99f);
+		std::vector<vec3> positions(PointCount), normals(PointCount), outPositions(PointCount), outNormals(PointCount);
+		for (int i = 0; i < PointCount; ++i) {
+			positions[i] = vec3(box(rng), box(rng), box(rng));
+			normals[i] = normalize(vec3(box(rng), box(rng), 1.f));
+		}
+		stack.Apply(positions.data(), normals.data(), PointCount, context, outPositions.data(), outNormals.data());
+
+		float worst = 0.f;
+		for (int i = 0; i < PointCount; ++i) {
+			mat3 expectedJ, J;
+			vec3 p = expected(positions[i], expectedJ);
+			worst = std::max(worst, Difference(stack.Apply(positions[i], context, &J), p));
+			worst = std::max(worst, Difference(J, expectedJ));
+			worst = std::max(worst, Difference(stack.Apply(positions[i], context), p));
+			worst = std::max(worst, Difference(outPositions[i], p));
+			worst = std::max(worst, Difference(outNormals[i], Deformations::TransformNormal(expectedJ, normals[i])));
+		}
+		bool passed = worst <= Tolerance;
+		failures += !passed;
+		std::printf("%-36s max error %.2e %s\n", name, worst, passed ? "" : "FAILED");
+	}
+
+	//Keeps the last upload in fixed arrays, so recording does not allocate either
+	class RecordingUniforms : public DeformerUniforms {
+	public:
+		void Uniform(const char *name, const float *values, int count) override
+		{
+			if (std::strcmp(name, "deformK") != 0 || count > DeformerStack::MaxDeformers) {
+				++unexpected;
+				return;
+			}
+			std::memcpy(k, values, count * sizeof(float));
+			kCount = count;
+		}
+		void Uniform(const char *name, vec3 value) override
+		{
+			if (std::strcmp(name, "meshMin") == 0)
+				meshMin = value;
+			else if (std::strcmp(name, "meshMax") == 0)
+				meshMax = value;
+			else
+				++unexpected;
+		}
+
+		float k[DeformerStack::MaxDeformers];
+		int kCount = 0;
+		vec3 meshMin, meshMax;
+		int unexpected = 0;
+	};
+
+	void Report(const char *name, bool passed)
+	{
+		failures += !passed;
+		std::printf("%-36s %s\n", name, passed ? "passed" : "FAILED");
+	}
+
+	void CheckSetUniforms(const char *name, const DeformerStack &stack, bool bounds)
+	{
+		RecordingUniforms target;
+		vec3 min(-1, -2, -3), max(1, 2, 3);
+		size_t before = AllocationCounter::Count();
+		stack.SetUniforms(target, min, max);
+		size_t allocations = AllocationCounter::Count() - before;
+
+		bool passed = allocations == 0 && target.unexpected == 0 && target.kCount == (int)stack.deformers.size();
+		for (int i = 0; passed && i < target.kCount; ++i)
+			passed = target.k[i] == stack.deformers[i].k;
+		if (bounds)
+			passed = passed && target.meshMin == min && target.meshMax == max;
+		failures += !passed;
+		std::printf("%-36s %zu allocations %s\n", name, allocations, passed ? "" : "FAILED");
+	}
+}
+
+int main()
+{
+	using namespace Deformations;
+	DeformerStack::Context context;
+	context.meshMin = vec3(-1, -1, -1);
+	context.meshMax = vec3(1, 1, 1);
+	vec3 min = context.meshMin, max = context.meshMax;
+
+	CheckApply("Apply, empty stack", DeformerStack(), context, [](vec3 p, mat3 &J) { J = mat3(1.f); return p; });
+	CheckApply("Apply, taper + twist", { Deformer(Deformer::taper, 0.6f), Deformer(Deformer::twist, 0.8f) }, context,
+			   [=](vec3 p, mat3 &J) {
+		vec3 q = Taper(p, 0.6f, min, max);
+		J = TwistJacobian(q, 0.8f) * TaperJacobian(p, 0.6f, min, max);
+		return Twist(q, 0.8f);
+	});
+	CheckApply("Apply, bend + other", { Deformer(Deformer::bend, 0.4f), Deformer(Deformer::other, 0.3f) }, context,
+			   [](vec3 p, mat3 &J) {
+		vec3 q = Bend(p, 0.4f);
+		J = OtherJacobian(q, 0.3f) * BendJacobian(p, 0.4f);
+		return Other(q, 0.3f);
+	});
+
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+	Lattice lattice(ivec3(4, 4, 4), Lattice::bspline);
+	std::vector<vec3> controlPoints = lattice.RestPositions();
+	for (vec3 &c : controlPoints)
+		c += vec3(jitter(rng), jitter(rng), jitter(rng));
+	context.lattice = &lattice;
+	context.latticePoints = controlPoints.data();
+	CheckApply("Apply, twist + FFD", { Deformer(Deformer::twist, 0.5f), Deformer(Deformer::ffd) }, context,
+			   [&](vec3 p, mat3 &J) {
+		mat3 Jl;
+		vec3 q = lattice.Evaluate(Twist(p, 0.5f), controlPoints.data(), Jl);
+		J = Jl * TwistJacobian(p, 0.5f);
+		return q;
+	});
+
+	//The curve step only deforms when the context brings a curve
+	CurveDeformer curve;
+	curve.SetCurve(CurveDeformer::SampleCurve(200));
+	CheckApply("Apply, curve without a curve", { Deformer(Deformer::curve, 0.8f) }, context,
+			   [](vec3 p, mat3 &J) { J = mat3(1.f); return p; });
+	context.curve = &curve;
+	CheckApply("Apply, twist + curve", { Deformer(Deformer::twist, 0.5f), Deformer(Deformer::curve, 0.8f) }, context,
+			   [&](vec3 p, mat3 &J) {
+		mat3 Jc;
+		vec3 q = curve.Deform(Twist(p, 0.5f), 0.8f, min, max, &Jc);
+		J = Jc * TwistJacobian(p, 0.5f);
+		return q;
+	});
+
+	//Shears y by k x^2
+	Deformer shear = Deformer::Custom("shear", "",
+		[](vec3 p, float k) { return p + vec3(0, k * p.x * p.x, 0); },
+		[](vec3 p, float k) { mat3 J(1.f); J[0][1] = 2 * k * p.x; return J; }, 0.7f);
+	CheckApply("Apply, custom + taper", { shear, Deformer(Deformer::taper, 0.5f) }, context, [=](vec3 p, mat3 &J) {
+		mat3 Js(1.f);
+		Js[0][1] = 2 * 0.7f * p.x;
+		vec3 q = p + vec3(0, 0.7f * p.x * p.x, 0);
+		J = TaperJacobian(q, 0.5f, min, max) * Js;
+		return Taper(q, 0.5f, min, max);
+	});
+
+	CheckSetUniforms("SetUniforms, twist", { Deformer(Deformer::twist, 0.3f) }, true);
+	CheckSetUniforms("SetUniforms, taper + twist", { Deformer(Deformer::taper, 0.2f), Deformer(Deformer::twist, 0.7f) }, true);
+	CheckSetUniforms("SetUniforms, bend + FFD", { Deformer(Deformer::bend, 0.5f), Deformer(Deformer::ffd) }, true);
+	CheckSetUniforms("SetUniforms, FFD", { Deformer(Deformer::ffd) }, false);
+	DeformerStack full;
+	for (int i = 0; i < DeformerStack::MaxDeformers; ++i)
+		full.deformers.push_back(Deformer((Deformer::deformerType)(i % 4), i * 0.05f));
+	CheckSetUniforms("SetUniforms, MaxDeformers steps", full, true);
+	bool valid = full.Valid();
+	full.deformers.push_back(Deformer(Deformer::twist, 1.f));
+	Report("Valid up to MaxDeformers steps", valid && !full.Valid());
+
+	//The counter has to see allocations at all for the checks above to mean something
+	size_t before = AllocationCounter::Count();
+	std::vector<float> *allocated = new std::vector<float>(100);
+	delete allocated;
+	Report("AllocationCounter counts new", AllocationCounter::Count() - before == 2);
+
+	std::printf(failures ? "DeformerStackTest: %d failed\n" : "DeformerStackTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
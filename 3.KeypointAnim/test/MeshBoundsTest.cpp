@@ -0,0 +1,35 @@
+#include "MeshBounds.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+//Bounds of point sets that lie entirely below zero. The counts are not multiples of the 8 vertex blocks the loop works
+//in, and x and y take their extremes at the last point, which always falls in the partial block at the end
+int main()
+{
+	struct Case {
+		size_t count;
+		vec3 min, max;
+	};
+	const Case cases[] = {
+		{ 1, vec3(-1, -100, -2), vec3(-1, -100, -2) },
+		{ 7, vec3(-7, -100, -4), vec3(-1, -97, -2) },
+		{ 13, vec3(-13, -100, -4), vec3(-1, -94, -2) },
+		{ 29, vec3(-29, -100, -4), vec3(-1, -86, -2) },
+	};
+
+	int failures = 0;
+	for (const Case &c : cases) {
+		std::vector<vec3> points(c.count);
+		for (size_t i = 0; i < c.count; ++i)
+			points[i] = vec3(-1.f - i, -100.f + 0.5f * i, -2.f - (i % 3));
+		vec3 min, max;
+		MeshBounds::Compute(points.data(), c.count, min, max);
+		bool passed = min == c.min && max == c.max;
+		failures += !passed;
+		std::printf("%2zu points  min (%g, %g, %g)  max (%g, %g, %g) %s\n", c.count, min.x, min.y, min.z, max.x, max.y, max.z,
+					passed ? "" : "FAILED");
+	}
+	std::printf(failures ? "MeshBoundsTest: %d failed\n" : "MeshBoundsTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
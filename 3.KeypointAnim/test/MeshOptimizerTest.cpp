@@ -0,0 +1,204 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <tuple>
+
+//The layout passes may change the order of triangles and vertices but never what is drawn, and the cache order must
+//pay off on a grid. Quantize is checked by unpacking the way Shaders::PackedInput does it
+namespace {
+	const int GridSize = 64;	//Quads per side
+	int failures = 0;
+
+	void Report(const char *name, bool passed)
+	{
+		failures += !passed;
+		std::printf("%-50s %s\n", name, passed ? "passed" : "FAILED");
+	}
+
+	void Report(const char *name, bool passed, float value)
+	{
+		failures += !passed;
+		std::printf("%-50s %.3g %s\n", name, value, passed ? "" : "FAILED");
+	}
+
+	//Unit square in xy, the rows of quads in order, z and the normals vary so every vertex is unique
+	MeshData Grid()
+	{
+		MeshData mesh;
+		for (int y = 0; y <= GridSize; ++y) {
+			for (int x = 0; x <= GridSize; ++x) {
+				vec3 p(x / (float)GridSize, y / (float)GridSize, 0.f);
+				p.z = 0.1f * std::sin(6 * p.x) * std::cos(4 * p.y);
+				mesh.positions.push_back(p);
+				mesh.normals.push_back(normalize(vec3(-0.6f * std::cos(6 * p.x) * std::cos(4 * p.y),
+													  0.4f * std::sin(6 * p.x) * std::sin(4 * p.y), 1.f)));
+			}
+		}
+		for (int y = 0; y < GridSize; ++y) {
+			for (int x = 0; x < GridSize; ++x) {
+				uint32_t v = y * (GridSize + 1) + x;
+				uint32_t quad[6] = { v, v + 1, v + GridSize + 2, v, v + GridSize + 2, v + GridSize + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	typedef std::tuple<float, float, float> Key;
+	typedef std::tuple<Key, Key, Key> Triangle;
+
+	Key KeyOf(vec3 p) { return Key(p.x, p.y, p.z); }
+
+	//The triangles by the positions of their corners, each rotated to start at its smallest corner so the winding is
+	//kept, and sorted
+	std::vector<Triangle> Triangles(const MeshData &mesh)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			Key a = KeyOf(mesh.positions[mesh.indices[i]]);
+			Key b = KeyOf(mesh.positions[mesh.indices[i + 1]]);
+			Key c = KeyOf(mesh.positions[mesh.indices[i + 2]]);
+			if (b < a && b < c)
+				triangles.push_back(Triangle(b, c, a));
+			else if (c < a && c < b)
+				triangles.push_back(Triangle(c, a, b));
+			else
+				triangles.push_back(Triangle(a, b, c));
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	//Every position keeps its normal
+	bool SameNormals(const MeshData &before, const MeshData &after)
+	{
+		std::vector<std::pair<Key, Key>> a, b;
+		for (size_t i = 0; i < before.positions.size(); ++i)
+			a.push_back(std::make_pair(KeyOf(before.positions[i]), KeyOf(before.normals[i])));
+		for (size_t i = 0; i < after.positions.size(); ++i)
+			b.push_back(std::make_pair(KeyOf(after.positions[i]), KeyOf(after.normals[i])));
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		return a == b;
+	}
+
+	void CheckOptimize(const char *name, MeshData mesh)
+	{
+		MeshData before = mesh;
+		std::vector<uint32_t> cacheOrder = mesh.indices;
+		MeshOptimizer::OptimizeVertexCache(cacheOrder, mesh.positions.size());
+		float acmr = MeshOptimizer::Acmr(cacheOrder, mesh.positions.size());
+		MeshData reordered = before;
+		reordered.indices = cacheOrder;
+
+		MeshOptimizer::Report report = MeshOptimizer::Optimize(mesh);
+		char line[96];
+		std::snprintf(line, sizeof(line), "%s: triangle order is a permutation", name);
+		Report(line, cacheOrder.size() == before.indices.size() && Triangles(reordered) == Triangles(before));
+		std::snprintf(line, sizeof(line), "%s: remapped vertices, same triangles", name);
+		Report(line, mesh.positions.size() == before.positions.size() && Triangles(mesh) == Triangles(before) &&
+					 SameNormals(before, mesh));
+
+		//The vertices are numbered in the order the triangles first use them
+		uint32_t next = 0;
+		bool firstUse = true;
+		for (uint32_t v : mesh.indices) {
+			firstUse = firstUse && v <= next;
+			if (v == next)
+				++next;
+		}
+		std::snprintf(line, sizeof(line), "%s: vertices in order of first use", name);
+		Report(line, firstUse && next == mesh.positions.size());
+
+		std::snprintf(line, sizeof(line), "%s: ACMR %.3f ->", name, report.acmrBefore);
+		Report(line, report.acmrAfter <= report.acmrBefore && report.acmrAfter == acmr &&
+					 report.acmrBefore == MeshOptimizer::Acmr(before.indices, before.positions.size()), report.acmrAfter);
+	}
+
+	//Shaders::PackedInput on the CPU
+	float Snorm16(uint32_t bits)
+	{
+		return glm::clamp((bits >= 32768 ? (float)bits - 65536 : (float)bits) / 32767.f, -1.f, 1.f);
+	}
+
+	vec3 UnpackPosition(const PackedVertices &packed, size_t i)
+	{
+		uint32_t xy = (uint32_t)packed.positions[i * 2], z = (uint32_t)packed.positions[i * 2 + 1];
+		vec3 q((float)(xy & 0xFFFF), (float)(xy >> 16 & 0xFFFF), (float)(z & 0xFFFF));
+		return packed.min + q / 65535.f * packed.extent;
+	}
+
+	vec3 UnpackNormal(const PackedVertices &packed, size_t i)
+	{
+		uint32_t bits = (uint32_t)packed.normals[i];
+		vec2 e(Snorm16(bits & 0xFFFF), Snorm16(bits >> 16 & 0xFFFF));
+		vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+		if (n.z < 0)
+			n = vec3((1.f - std::abs(e.y)) * (e.x >= 0 ? 1.f : -1.f), (1.f - std::abs(e.x)) * (e.y >= 0 ? 1.f : -1.f), n.z);
+		return normalize(n);
+	}
+
+	void CheckQuantize(std::mt19937 &rng)
+	{
+		std::uniform_real_distribution<float> box(-5.f, 20.f);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		MeshData mesh;
+		for (int i = 0; i < 10000; ++i) {
+			//z flat, where the extent is 0
+			mesh.positions.push_back(vec3(box(rng), 0.1f * box(rng), 3.f));
+			vec3 n(unit(rng), unit(rng), unit(rng));
+			mesh.normals.push_back(length(n) > 1e-3f ? normalize(n) : vec3(1, 0, 0));
+		}
+		//The poles and the folded edges of the octahedron
+		const vec3 Special[] = { vec3(0, 0, 1), vec3(0, 0, -1), vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0),
+								 vec3(0, -1, 0), normalize(vec3(1, 1, -1)), normalize(vec3(-1, 1, -1e-4f)) };
+		for (vec3 n : Special) {
+			mesh.positions.push_back(vec3(0, 0, 3));
+			mesh.normals.push_back(n);
+		}
+		PackedVertices packed = MeshOptimizer::Quantize(mesh);
+
+		//Half a step of 16 bits over the extent
+		vec3 step = packed.extent / 65535.f * 0.5f;
+		bool positions = packed.positions.size() == mesh.positions.size() * 2;
+		float worst = 0.f;
+		for (size_t i = 0; positions && i < mesh.positions.size(); ++i) {
+			vec3 error = glm::abs(UnpackPosition(packed, i) - mesh.positions[i]);
+			positions = error.x <= step.x + 1e-5f && error.y <= step.y + 1e-5f && error.z <= 1e-5f;
+			worst = std::max(worst, std::max(error.x, error.y));
+		}
+		Report("Quantize positions within half a step", positions, worst);
+
+		//16 bit octahedral normals are good to about 1e-4 radians
+		bool normals = packed.normals.size() == mesh.normals.size();
+		float angle = 0.f;
+		for (size_t i = 0; normals && i < mesh.normals.size(); ++i) {
+			vec3 unpacked = UnpackNormal(packed, i);
+			//acos of the dot product is too coarse in float for angles this small
+			angle = std::max(angle, std::atan2(length(cross(unpacked, mesh.normals[i])), dot(unpacked, mesh.normals[i])));
+		}
+		Report("Quantize normals within 2e-4 radians", normals && angle <= 2e-4f, angle);
+	}
+}
+
+int main()
+{
+	MeshData grid = Grid();
+	CheckOptimize("Grid in rows", grid);
+	std::mt19937 rng(11);
+	MeshData shuffled = grid;
+	std::vector<size_t> order(shuffled.indices.size() / 3);
+	for (size_t t = 0; t < order.size(); ++t)
+		order[t] = t;
+	std::shuffle(order.begin(), order.end(), rng);
+	for (size_t t = 0; t < order.size(); ++t)
+		std::copy(&grid.indices[order[t] * 3], &grid.indices[order[t] * 3] + 3, &shuffled.indices[t * 3]);
+	CheckOptimize("Grid shuffled", shuffled);
+	CheckQuantize(rng);
+
+	std::printf(failures ? "MeshOptimizerTest: %d failed\n" : "MeshOptimizerTest: passed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}